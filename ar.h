@@ -0,0 +1,71 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org).
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+/* archives (.a files) are in the traditional 'ar' format: the magic
+   string, followed by members, each of which is a fixed-size header
+   of ASCII fields followed by the member's data, padded to an even
+   number of bytes. fields are padded on the right with spaces. */
+
+#define ARMAG       "!<arch>\n"
+#define SARMAG      8
+
+#define ARFMAG      "`\n"
+
+struct ar_hdr
+{
+    char    ar_name[16];        /* terminated by space or '/' */
+    char    ar_date[12];        /* decimal */
+    char    ar_uid[6];          /* decimal */
+    char    ar_gid[6];          /* decimal */
+    char    ar_mode[8];         /* octal */
+    char    ar_size[10];        /* decimal, excludes this header */
+    char    ar_fmag[2];         /* ARFMAG */
+};
+
+/* member names longer than 15 characters are stored either BSD-style,
+   as "#1/<length>" with the name at the start of the data (and counted
+   in ar_size), or GNU-style, as "/<offset>" into the data of a member
+   named "//". a GNU symbol table, named "/", is ignored. */
+
+#define AR_EFMT1    "#1/"
+#define AR_STRTAB   "//"
+
+/* the linker needs a symbol directory, so it can link just the members
+   it needs without reading them all. this is the first member of the
+   archive, named RANLIBMAG, and is built by nranlib. its data is:
+
+   int            number of bytes of ranlib structs that follow
+   struct ranlib  one per defined global symbol
+   int            number of bytes of strings that follow
+   char           NUL-terminated names of the symbols
+
+   when more than one member defines a symbol, the first one counts. */
+
+#define RANLIBMAG   "__.SYMDEF"
+
+struct ranlib
+{
+    int     ran_strx;           /* offset of name in string table */
+    int     ran_off;            /* offset of member header in archive */
+};
@@ -0,0 +1,36 @@
+# shared by the benchmark scripts, which are run as "sh bench/name [tree ...]".
+# each times the tools of the given trees (built tops of ncc source trees,
+# e.g. a checkout of an older revision to compare with) or of this one.
+
+top=`cd \`dirname $0\`/.. && pwd`
+work=${TMPDIR:-/tmp}/ncc-bench.$$
+trees=${*:-$top}
+
+trap 'rm -rf $work' 0
+mkdir -p $work
+
+# run a command three times and print its best wall-clock time in seconds
+
+best()
+{
+    b=
+
+    for i in 1 2 3
+    do
+        s=`date +%s.%N`
+        "$@" > /dev/null || exit 1
+        e=`date +%s.%N`
+        b=`echo $s $e $b | awk '{ t = $2 - $1; if (NF == 3 && $3 < t) t = $3; printf "%.3f", t }'`
+    done
+
+    echo $b
+}
+
+# print the heading of a table with a column for each tree
+
+heading()
+{
+    printf "%10s" "$1"
+    for tree in $trees; do printf "  %12s" `basename $tree`; done
+    echo
+}
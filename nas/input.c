@@ -72,17 +72,15 @@ bytes(n, idx)
     }
 }
 
-/* the first thing next_line() does is invoke list_line() after every line 
-   processed (actually, right before reading any new line, except the first).
-   provided it's the final pass and we're generating a listing, that is. */
+/* list_line() is called by assemble() after every line is processed
+   on the final pass, provided we're generating a listing, that is. */
 
-static 
 list_line()
 {
     int i = 0;
 
-    if (input_paths[input_index] != list_name) {
-        list_name = input_paths[input_index];
+    if (input_name() != list_name) {
+        list_name = input_name();
         fprintf(list_file, "\n%s\n\n", list_name);
     }
 
@@ -108,91 +106,257 @@ list_line()
     list_address = NO_ADDRESS;
 }
 
-/* return the next line of input, or return zero if there isn't another. */
+/* the input files are read into memory whole, so an input can be a
+   pipe. the path "-" means the standard input. the text is kept for
+   the life of the assembler: STRING lexemes and fragments point into it. */
 
-static
-next_line()
+static char *
+slurp(path)
+    char * path;
 {
-    static FILE * file;
+    FILE * file;
+    char * text = NULL;
+    int    cap = 0;
+    int    len = 0;
+    int    n;
+
+    if (strcmp(path, "-") == 0)
+        file = stdin;
+    else if ((file = fopen(path, "r")) == NULL)
+        error("can't open input file");
+
+    do {
+        if (len == cap) {
+            cap = cap ? (cap * 2) : INPUT_CHUNK;
+            text = realloc(text, cap + 1);
+            if (text == NULL) error("out of memory");
+        }
 
-    if ((input_index >= 0) && list_file && (pass == FINAL_PASS)) list_line();
+        n = fread(text + len, 1, cap - len, file);
+        len += n;
+    } while (n > 0);
 
-    for (;;) {
-        if (file == NULL) {
-            input_index++;
-            if (input_paths[input_index] != NULL) {
-                file = fopen(input_paths[input_index], "r");
-                if (file == NULL) error("can't open input file");
-            } else
-                return 0;
-        }
+    if (ferror(file)) error("can't read input file");
+    if (file != stdin) fclose(file);
 
-        if (fgets(input_line, MAX_INPUT_LINE, file) == NULL)  {
-            fclose(file);
-            file = NULL;
-            line_number = 0;
-        } else {
-            if (strchr(input_line, '\n') == NULL) error("line unterminated or too long");
-            line_number++;
-            input_pos = input_line;
-            return 1;
-        }
+    text[len] = 0;
+    return text;
+}
+
+/* the lexeme and fragment arrays (see nas.h) are built by load_input()
+   and grow as needed. 'next_lexeme' is the cursor used by scan(). */
+
+static struct lexeme  * lexemes;
+static int              nr_lexemes;
+static int              max_lexemes;
+static int              max_fragments;
+static int              next_lexeme;
+
+static struct lexeme *
+new_lexeme(token)
+{
+    struct lexeme * lexeme;
+
+    if (nr_lexemes == max_lexemes) {
+        max_lexemes = max_lexemes ? (max_lexemes * 2) : MIN_LEXEMES;
+        lexemes = (struct lexeme *) realloc(lexemes, max_lexemes * sizeof(struct lexeme));
+        if (lexemes == NULL) error("out of memory");
     }
+
+    lexeme = &lexemes[nr_lexemes++];
+    lexeme->token = token;
+    lexeme->name = NULL;
+    lexeme->number = 0;
+    lexeme->string = NULL;
+
+    return lexeme;
 }
 
-/* return the next token from the input stream, or NONE if no more. also
-   sets the global variables 'token', 'name_token' and 'number_token' as applicable. */
+static struct fragment *
+new_fragment()
+{
+    struct fragment * fragment;
+
+    if (nr_fragments == max_fragments) {
+        max_fragments = max_fragments ? (max_fragments * 2) : MIN_FRAGMENTS;
+        fragments = (struct fragment *) realloc(fragments, max_fragments * sizeof(struct fragment));
+        if (fragments == NULL) error("out of memory");
+    }
+
+    fragment = &fragments[nr_fragments++];
+    fragment->lexeme = nr_lexemes;
+    fragment->input = input_index;
+    fragment->line = line_number;
+    fragment->text = NULL;
+    fragment->label = NULL;
+    fragment->equate = 0;
+    fragment->address = 0;
+    fragment->fixed = 0;
+    fragment->bytes = 0;
+    fragment->relocs = 0;
+
+    return fragment;
+}
+
+/* break the line at 'pos' into lexemes for 'fragment'. the line always ends
+   with a newline, which is the last lexeme. a NAME at the start of a line
+   followed immediately by a colon is a label, which goes in the fragment.
+   one followed immediately by an equal sign marks an equate. */
 
 #define ISALPHA(x)  (isalpha(x) || ((x) == '_') || ((x) == '$'))
 
-scan()
+static
+lex(fragment, pos)
+    struct fragment * fragment;
+    char            * pos;
 {
-    char * start;
-    char * end;
+    struct lexeme * lexeme;
+    char          * start;
+    char          * end;
+    int             delimiter;
 
-    if ((*input_pos == 0) && (next_line() == 0)) 
-        return token = NONE;
+    for (;;) {
+        while (isspace(*pos) && (*pos != '\n'))
+            pos++;
+
+        if (*pos == ';')
+            while (*pos != '\n') pos++;
 
-    while (isspace(*input_pos) && (*input_pos != '\n')) 
-        input_pos++;
+        start = pos;
 
-    if (*input_pos == ';')                              
-        while (*input_pos != '\n') input_pos++;
+        if ((*pos == '.') && ISALPHA(pos[1])) pos++;
 
-    start = input_pos;
+        if (isdigit(*pos) || ISALPHA(*pos)) {
+            while (ISALPHA(*pos) || isdigit(*pos)) pos++;
 
-    if ((*input_pos == '.') && ISALPHA(input_pos[1])) input_pos++;
+            if (isdigit(*start)) {
+                lexeme = new_lexeme(NUMBER);
+                errno = 0;
+                lexeme->number = strtoul(start, &end, 0);
+                if (errno || (end != pos)) {
+                    *pos = 0;
+                    error("malformed number '%s'", start);
+                }
+                continue;
+            }
 
-    if (isdigit(*input_pos) || ISALPHA(*input_pos)) {
-        while (ISALPHA(*input_pos) || isdigit(*input_pos)) input_pos++;
+            lexeme = new_lexeme((*start == '.') ? PSEUDO : NAME);
+            if (*start == '.') start++;
+            lexeme->name = lookup_name(start, pos - start);
+            if ((lexeme->token == NAME) && lexeme->name->token) lexeme->token = lexeme->name->token;
 
-        if (isdigit(*start)) {
-            errno = 0;
-            number_token = strtoul(start, &end, 0);
-            if (errno || (end != input_pos)) {
-                *input_pos = 0;
-                error("malformed number '%s'", start);
+            if (    (lexeme->token == NAME)
+                &&  (fragment->lexeme == nr_lexemes - 1)
+                &&  (fragment->label == NULL) )
+            {
+                if (*pos == ':') {
+                    fragment->label = lexeme->name;
+                    nr_lexemes--;
+                    pos++;
+                } else if (*pos == '=')
+                    fragment->equate = 1;
             }
-            return token = NUMBER;
+
+            continue;
         }
 
-        if (*start == '.') {
-            start++;
-            token = PSEUDO;
-        } else
-            token = NAME;
+        /* the contents of a string are taken verbatim, so
+           STRINGs are pointers into the input text. */
+
+        if ((*pos == '\'') || (*pos == '\"')) {
+            delimiter = *pos++;
+            lexeme = new_lexeme(STRING);
+            lexeme->string = pos;
+            while ((*pos != '\n') && (*pos != delimiter)) pos++;
+            if (*pos != delimiter) error("missing closing delimiter");
+            lexeme->number = pos - lexeme->string;
+            pos++;
+            continue;
+        }
 
-        name_token = lookup_name(start, input_pos - start);
-        if ((token == NAME) && (name_token->token)) token = name_token->token;
-        return token;
+        new_lexeme(*pos);
+        if (*pos == '\n') return 0;
+        pos++;
+    }
+}
+
+/* read and tokenize all the input files. this is done once, before
+   the first pass. afterwards, the text itself is only needed for listings. */
+
+load_input()
+{
+    struct fragment * fragment;
+    char            * text;
+    char            * end;
+
+    for (input_index = 0; input_paths[input_index]; input_index++) {
+        text = slurp(input_paths[input_index]);
+
+        for (line_number = 1; *text; line_number++) {
+            end = strchr(text, '\n');
+            if ((end == NULL) || ((end - text + 1) >= MAX_INPUT_LINE)) error("line unterminated or too long");
+            fragment = new_fragment();
+            fragment->text = text;
+            lex(fragment, text);
+            text = end + 1;
+        }
+    }
+
+    input_index = -1;
+}
+
+/* make 'fragment' the current one: position scan() at its first lexeme,
+   and set up the line information for error messages and listings. */
+
+begin_fragment(fragment)
+    struct fragment * fragment;
+{
+    int n;
+
+    input_index = fragment->input;
+    line_number = fragment->line;
+    next_lexeme = fragment->lexeme;
+
+    if (list_file && (pass == FINAL_PASS)) {
+        n = strchr(fragment->text, '\n') - fragment->text + 1;
+        memcpy(input_line, fragment->text, n);
+        input_line[n] = 0;
     }
-    
-    return token = *input_pos++;
+}
+
+/* return the next token from the current fragment. also sets the global
+   variables 'token', 'name_token', 'number_token' and 'string_token' as
+   applicable. the scan never advances past the newline at the end. */
+
+scan()
+{
+    struct lexeme * lexeme = &lexemes[next_lexeme];
+
+    token = lexeme->token;
+    if (token == '\n') return token;
+    next_lexeme++;
+
+    switch (token)
+    {
+    case STRING:
+        string_token = lexeme->string;
+    case NUMBER:
+        number_token = lexeme->number;
+        break;
+    default:
+        if (lexeme->name) name_token = lexeme->name;
+    }
+
+    return token;
 }
 
 /* parse an expression into the 'symbol' and 'offset' fields of
    operands[n]. only supports +/- for now, but can (and will) be 
-   expanded with a few primitive operators later. */
+   expanded with a few primitive operators later.
+
+   the result of folding symbols into the offset can change from pass
+   to pass, as can anything that refers to a symbol which isn't defined
+   yet, so the current fragment is marked unstable in those cases. */
 
 static
 expression(n)
@@ -210,21 +374,38 @@ expression(n)
         case NAME:
             reference(name_token);
 
+            if (!(name_token->symbol->flags & OBJ_SYMBOL_DEFINED) && (pass == FIRST_PASS))
+                unstable++;
+
             if (    (name_token->symbol->flags & OBJ_SYMBOL_DEFINED) 
                 &&  (OBJ_SYMBOL_GET_SEG(*(name_token->symbol)) == OBJ_SYMBOL_SEG_ABS) ) 
             {
                 number_token = name_token->symbol->value; 
+                unstable++;
                 /* and fall through to NUMBER */
             } else if ( operands[n].symbol
                     &&  (sign == -1)
                     &&  (operands[n].symbol->flags & OBJ_SYMBOL_DEFINED)
                     &&  (name_token->symbol->flags & OBJ_SYMBOL_DEFINED)
-                    &&  (OBJ_SYMBOL_GET_SEG(*(name_token->symbol)) == OBJ_SYMBOL_GET_SEG(*(operands[n].symbol))) ) 
+                    &&  (OBJ_SYMBOL_GET_SEG(*(name_token->symbol)) == OBJ_SYMBOL_GET_SEG(*(operands[n].symbol)))
+                    &&  (OBJ_SYMBOL_GET_SECTION(*(name_token->symbol)) == OBJ_SYMBOL_GET_SECTION(*(operands[n].symbol))) )
             {
-                /* difference of symbols in the same segment */
+                /* difference of symbols in the same section */
                 number_token = operands[n].symbol->value - name_token->symbol->value;
                 operands[n].symbol = NULL;
                 sign = 1;
+                unstable++;
+                /* and fall through to NUMBER */
+            } else if ( operands[n].symbol
+                    &&  (sign == -1)
+                    &&  (pass == FIRST_PASS) )
+            {
+                /* a difference with a forward reference: the symbols
+                   aren't known yet, so it's zero until the next pass */
+                number_token = 0;
+                operands[n].symbol = NULL;
+                sign = 1;
+                unstable++;
                 /* and fall through to NUMBER */
             } else {
                 if ((operands[n].symbol) || (sign == -1)) error("not relocatable");
@@ -443,10 +624,24 @@ imm_operand(n)
     if (operands[n].symbol && (bits > 16)) operands[n].flags &= ~O_IMM_16;
 
     /* this is a roundabout way of determining if the operand describes a 
-       known target that can be reached by a short (8-bit relative) jump. */
+       known target that can be reached by a short (8-bit relative) jump.
+       if the target is known at all, the answer depends on its location.
+
+       a target ahead of us hasn't been seen yet this pass, so its value is
+       from the last one: assume it has moved as far as we have since then. */
 
     memcpy(&saved_operand, &operands[n], sizeof(struct operand));
+
+    if (    operands[n].symbol
+        &&  (operands[n].symbol->flags & OBJ_SYMBOL_DEFINED)
+        &&  (OBJ_SYMBOL_GET_SEG(*operands[n].symbol) == segment)
+        &&  (operands[n].symbol->value > ((segment == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes) + slip) )
+    {
+        operands[n].offset -= slip;
+    }
+
     resolve(n, O_IMM_64, 2); 
+    if (operands[n].symbol == NULL) saved_operand.located = 1;
     if ((operands[n].symbol == NULL) && (operands[n].offset >= SCHAR_MIN) && (operands[n].offset <= SCHAR_MAX)) rel8++;
     memcpy(&operands[n], &saved_operand, sizeof(struct operand));
     if (rel8) operands[n].flags |= O_REL_8;
@@ -461,6 +656,7 @@ operand(n)
     operands[n].symbol = NULL;
     operands[n].offset = 0;
     operands[n].flags = 0;
+    operands[n].located = 0;
 
     if (token & REG) 
         reg_operand(n);
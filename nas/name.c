@@ -39,10 +39,37 @@ allocate(bytes)
     return p;
 }
 
-static struct name * buckets[NR_NAME_BUCKETS];
+static struct name ** buckets;
+static int            nr_buckets;
+static int            nr_names;
+
+static
+grow_names()
+{
+    struct name ** old_buckets = buckets;
+    int            nr_old_buckets = nr_buckets;
+    struct name  * name;
+    int            i, j;
+
+    nr_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_NAME_BUCKETS;
+    buckets = (struct name **) allocate(nr_buckets * sizeof(struct name *));
+    memset(buckets, 0, nr_buckets * sizeof(struct name *));
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (name = old_buckets[i]) {
+            old_buckets[i] = name->link;
+            j = name->hash & (nr_buckets - 1);
+            name->link = buckets[j];
+            buckets[j] = name;
+        }
+    }
+
+    if (old_buckets) free(old_buckets);
+}
 
 /* return the name entry for the string given, creating one if necessary.
-   this is basically a copy of stringize() from symbol.c in the C compiler. */
+   this is basically a copy of stringize() from symbol.c in the C compiler,
+   hash (FNV-1a) and all. */
 
 struct name *
 lookup_name(data, length)
@@ -54,12 +81,14 @@ lookup_name(data, length)
     unsigned       hash;
     int            i; 
 
-    for (i = 0, hash = 0; i < length; i++) {
-        hash <<= 4;
+    for (i = 0, hash = 0x811C9DC5; i < length; i++) {
         hash ^= (data[i] & 0xFF);
+        hash *= 16777619;
     }
 
-    i = hash % NR_NAME_BUCKETS;
+    if (nr_names == nr_buckets) grow_names();
+
+    i = hash & (nr_buckets - 1);
     for (namep = &(buckets[i]); (name = *namep); namep = &((*namep)->link)) {
         if (name->length != length) continue;
         if (name->hash != hash) continue;
@@ -75,10 +104,12 @@ lookup_name(data, length)
     name = (struct name *) allocate(sizeof(struct name));
     name->link = buckets[i];
     buckets[i] = name;
+    nr_names++;
     name->hash = hash;
     name->length = length;
     name->symbol = NULL;
     name->insn_entries = NULL;
+    name->rel8_operands = 0;
     name->pseudo = NULL;
     name->token = 0;
     name->data = allocate(length + 1);
@@ -109,7 +140,11 @@ reference(name)
             name->symbol->value = 0;
         }
     } else if (pass == FINAL_PASS) {
-        /* on first encounter, write the symbol and its name to the output file */
+        /* catch undefined symbols, and on first encounter,
+           write the symbol and its name to the output file */
+
+        if (!(name->symbol->flags & (OBJ_SYMBOL_GLOBAL | OBJ_SYMBOL_DEFINED)))
+            error("undefined symbol");
 
         if (name->symbol->index == nr_symbols) {
             position = OBJ_SYMBOLS_OFFSET(header);
@@ -123,17 +158,14 @@ reference(name)
             output(position, name->data, name->length + 1);
             name_bytes += name->length + 1;
         }
-    } else { 
-        /* the first intermediate pass catch undefined symbols */
-
-        if (!(name->symbol->flags & (OBJ_SYMBOL_GLOBAL | OBJ_SYMBOL_DEFINED)))
-            error("undefined symbol");
     }
 
-    /* regardless of which pass, bump the symbol counter after the
-       first appearance of any symbol. */
+    /* bump the symbol counter after the first appearance of any symbol.
+       the intermediate passes skip fixed fragments, so they don't count:
+       only the first and final passes see every reference. */
 
-    if (name->symbol->index == nr_symbols) nr_symbols++;
+    if ((pass == FIRST_PASS) || (pass == FINAL_PASS))
+        if (name->symbol->index == nr_symbols) nr_symbols++;
 }
 
 /* assign the given symbol the specified value, and mark it defined. 
@@ -220,7 +252,8 @@ struct {
     { "data", pseudo_data },
     { "bss", pseudo_bss },
     { "org", pseudo_org },
-    { "bits", pseudo_bits }
+    { "bits", pseudo_bits },
+    { "section", pseudo_section }
 };
 
 #define NR_PSEUDOS (sizeof(pseudos)/sizeof(*pseudos))
@@ -228,7 +261,7 @@ struct {
 load_names()
 {
     struct name * name;
-    int           i;
+    int           i, j;
 
     for (i = 0; i < NR_TOKENS; i++) {
         name = lookup_name(tokens[i].text, strlen(tokens[i].text));
@@ -239,6 +272,9 @@ load_names()
         name = lookup_name(insns[i].mnemonic, strlen(insns[i].mnemonic));
         if (!name->insn_entries) name->insn_entries = &insns[i];
         insns[i].name = name;
+
+        for (j = 0; j < insns[i].nr_operands; j++)
+            if (insns[i].operand_flags[j] & O_REL_8) name->rel8_operands |= 1 << j;
     }
 
     for (i = 0; i < NR_PSEUDOS; i++) {
@@ -246,3 +282,25 @@ load_names()
         name->pseudo = pseudos[i].handler;
     }
 }
+
+/* print statistics about the name table to stderr */
+
+name_stats()
+{
+    struct name * name;
+    int           longest = 0;
+    int           used = 0;
+    int           length;
+    int           i;
+
+    for (i = 0; i < nr_buckets; i++) {
+        for (length = 0, name = buckets[i]; name; name = name->link) ++length;
+        if (length) ++used;
+        if (length > longest) longest = length;
+    }
+
+    fprintf(stderr, "names: %d entries, %d buckets, load %d.%02d, "
+                    "%d buckets used, longest chain %d\n",
+                    nr_names, nr_buckets, nr_names / nr_buckets, 
+                    (nr_names * 100 / nr_buckets) % 100, used, longest);
+}
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <string.h>
 #include <unistd.h>
 #include "nas.h"
 
@@ -32,16 +33,23 @@ int                 bits = 64;                          /* .bits <x> */
 int                 segment = OBJ_SYMBOL_SEG_TEXT;      /* .text or .data? */
 int                 text_bytes;                         /* current text segment position */
 int                 data_bytes;                         /* current data segment position */
+struct obj_section * sections;                          /* .section table (this pass) */
+int                 nr_sections;
+int                 text_section;                       /* current text section number */
+int                 data_section;                       /* current data section number */
 int                 name_bytes;                         /* current name bytes (last pass only) */
 int                 nr_relocs;                          /* number of relocations */
 int                 nr_symbols;                         /* number of symbols */
 int                 pass;                               /* between FIRST_PASS .. FINAL_PASS */
 char             ** input_paths;                        /* array of input path names */
 int                 input_index = -1;                   /* current index, -1 means "the beginning" */
-FILE              * input_file;                         /* current input file */
-char                input_line[MAX_INPUT_LINE];         /* current input line */
-char              * input_pos = input_line;             /* position on that line */
+char              * stdin_name;                         /* -n: what to call the standard input */
+char                input_line[MAX_INPUT_LINE];         /* current input line (listing only) */
 int                 line_number;                        /* which line number input_line is */
+struct fragment   * fragments;                          /* one per input line */
+int                 nr_fragments;
+int                 unstable;                           /* current fragment's size may change */
+int                 slip;                               /* how far it's moved since the last pass */
 char              * output_path;                        /* output path ... */
 FILE              * output_file;                        /* ... and file */
 char              * list_path;                          /* these are NULL unless the ... */
@@ -49,11 +57,26 @@ FILE              * list_file;                          /* ... user requested a
 int                 token;                              /* current token */
 struct name       * name_token;                         /* name of most recent NAME or PSEUDO */
 long                number_token;                       /* value of most recent numeric token */
+char              * string_token;                       /* text of most recent STRING (not terminated) */
 int                 nr_symbol_changes;                  /* symbols defined/changed this pass */
 struct obj_header   header;                             /* header to use for final pass output */
 struct insn       * insn;                               /* instruction being encoded */
 int                 nr_operands;                        /* number of operands to current instruction */
 struct operand      operands[MAX_OPERANDS];             /* the operands themselves */
+int                 H_flag;                             /* -H: print name table statistics */
+
+/* the name of the current input, for diagnostics and listings. when the
+   input is the standard input ("-"), the driver names it after the file
+   it came from with -n: otherwise every error would be blamed on '-'. */
+
+char *
+input_name()
+{
+    char * path = input_paths[input_index];
+
+    if (stdin_name && (strcmp(path, "-") == 0)) return stdin_name;
+    return path;
+}
 
 /* report an error, clean up the output(s), and exit */
 
@@ -70,7 +93,7 @@ error(fmt)
     fprintf(stderr, "as: ");
 
     if (input_index >= 0) {
-        fprintf(stderr, "'%s' ", input_paths[input_index]);
+        fprintf(stderr, "'%s' ", input_name());
         if (line_number) fprintf(stderr, "(%d) ", line_number);
     }
     
@@ -93,25 +116,184 @@ error(fmt)
     exit(1);
 }
 
+/* the template chosen for an instruction depends only on its mnemonic,
+   the flags of its operands, and the mode. so rather than search through
+   the mnemonic's entries in insns[] every time, match() remembers each
+   result in a hash table keyed on those. there are few distinct keys:
+   a few hundred cover the output of the compiler. */
 
-assemble()
+static struct match ** match_buckets;
+static int             nr_match_buckets;
+static int             nr_matches;
+static int             nr_match_lookups;
+
+static unsigned
+match_hash(name, nr, mode, flags)
+    struct name * name;
+    long        * flags;
 {
+    unsigned hash = name->hash;
+    int      i;
+
+    hash = (hash ^ nr) * 16777619;
+    hash = (hash ^ mode) * 16777619;
+
+    for (i = 0; i < nr; i++) {
+        hash = (hash ^ (unsigned) flags[i]) * 16777619;
+        hash = (hash ^ (unsigned) (flags[i] >> 32)) * 16777619;
+    }
+
+    return hash;
+}
+
+static
+grow_matches()
+{
+    struct match ** old_buckets = match_buckets;
+    int             nr_old_buckets = nr_match_buckets;
+    struct match  * match;
+    int             i, j;
+
+    nr_match_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_MATCH_BUCKETS;
+    match_buckets = (struct match **) calloc(nr_match_buckets, sizeof(struct match *));
+    if (match_buckets == NULL) error("out of memory");
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (match = old_buckets[i]) {
+            old_buckets[i] = match->link;
+            j = match_hash(match->name, match->nr_operands, match->bits, match->flags) & (nr_match_buckets - 1);
+            match->link = match_buckets[j];
+            match_buckets[j] = match;
+        }
+    }
+
+    if (old_buckets) free(old_buckets);
+}
+
+/* return the template for the instruction 'name' with the current
+   operands[], or NULL if there isn't one. */
+
+static struct insn *
+match(name)
     struct name * name;
-    int           i;
+{
+    struct match * match;
+    long           flags[MAX_OPERANDS];
+    int            i, j;
+
+    nr_match_lookups++;
+    for (i = 0; i < nr_operands; i++) flags[i] = operands[i].flags;
+    if (nr_matches == nr_match_buckets) grow_matches();
+    j = match_hash(name, nr_operands, bits, flags) & (nr_match_buckets - 1);
+
+    for (match = match_buckets[j]; match; match = match->link) {
+        if (match->name != name) continue;
+        if (match->nr_operands != nr_operands) continue;
+        if (match->bits != bits) continue;
+        if (memcmp(match->flags, flags, nr_operands * sizeof(long))) continue;
+
+        return match->insn;
+    }
+
+    match = (struct match *) malloc(sizeof(struct match));
+    if (match == NULL) error("out of memory");
+    match->name = name;
+    match->nr_operands = nr_operands;
+    match->bits = bits;
+    memcpy(match->flags, flags, nr_operands * sizeof(long));
+    match->insn = NULL;
+    match->link = match_buckets[j];
+    match_buckets[j] = match;
+    nr_matches++;
+
+    for (insn = name->insn_entries; insn->name == name; insn++) {
+        if (insn->nr_operands != nr_operands) goto mismatch;
+        if ((bits == 16) && (insn->insn_flags & I_NO_BITS_16)) goto mismatch;
+        if ((bits == 32) && (insn->insn_flags & I_NO_BITS_32)) goto mismatch;
+        if ((bits == 64) && (insn->insn_flags & I_NO_BITS_64)) goto mismatch;
+
+        for (i = 0; i < insn->nr_operands; i++) 
+            if (!(insn->operand_flags[i] & operands[i].flags)) goto mismatch;
+
+        match->insn = insn;
+        break;
+
+      mismatch: ;
+    }
+
+    return match->insn;
+}
+
+/* print statistics about the match table to stderr */
+
+match_stats()
+{
+    fprintf(stderr, "matches: %d lookups, %d entries, %d buckets\n",
+                    nr_match_lookups, nr_matches, nr_match_buckets);
+}
+
+/* make one pass over the fragments. on the intermediate passes, the fixed
+   fragments are skipped; since those never change segments, the combined
+   byte count measures a fragment regardless of which segment it's in. */
+
+assemble()
+{
+    struct fragment * fragment;
+    struct name     * name;
+    int               here;
+    int               bytes;
+    int               relocs;
+    int               i;
 
-    input_index = -1;      
     nr_symbol_changes = 0;
-    nr_symbols = 0;
+    if ((pass == FIRST_PASS) || (pass == FINAL_PASS)) nr_symbols = 0;
     nr_relocs = 0;
     text_bytes = 0;
     data_bytes = 0;
+    nr_sections = 0;
+    text_section = 0;
+    data_section = 0;
     segment = OBJ_SYMBOL_SEG_TEXT;
+    bits = 64;                      /* don't carry .bits between passes */
+
+    for (fragment = fragments; fragment < fragments + nr_fragments; fragment++) {
+        begin_fragment(fragment);
+
+        if (fragment->label) {
+            define(fragment->label, (segment == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes);
+            OBJ_SYMBOL_SET_SEG(*(fragment->label->symbol), segment);
+            OBJ_SYMBOL_SET_SECTION(*(fragment->label->symbol), CURRENT_SECTION);
+        }
+
+        if (fragment->fixed && (pass != FINAL_PASS)) {
+            if (segment == OBJ_SYMBOL_SEG_TEXT) {
+                text_bytes += fragment->bytes;
+                if (text_bytes > MAX_BYTES) error("text segment overflow");
+            } else {
+                data_bytes += fragment->bytes;
+                if (data_bytes > MAX_BYTES) error("data segment overflow");
+            }
+
+            nr_relocs += fragment->relocs;
+            continue;
+        }
+
+        /* a fragment that moves counts as a change, like a symbol would,
+           so there's no slip left by the time the final pass comes around. */
 
-    scan();
-    while (token != NONE) {
+        here = (segment == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes;
+        slip = (pass == FIRST_PASS) ? 0 : (fragment->address - here);
+        if (slip && (pass != FINAL_PASS)) nr_symbol_changes++;
+        fragment->address = here;
+
+        bytes = text_bytes + data_bytes;
+        relocs = nr_relocs;
+        unstable = 0;
+
+        scan();
         if (token == '\n') goto end_of_line;
 
-        if (token == NAME && (*input_pos == '=')) {
+        if (fragment->equate) {
             name = name_token;
             scan();
             scan();
@@ -120,15 +302,6 @@ assemble()
             goto end_of_line;
         }
 
-        if (token == NAME && (*input_pos == ':')) {
-            name = name_token;
-            scan();
-            scan();
-            define(name, (segment == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes);
-            OBJ_SYMBOL_SET_SEG(*(name->symbol), segment);
-            if (token == '\n') goto end_of_line;
-        }
-
         if (token == PSEUDO) {
             name = name_token;
             scan();
@@ -159,29 +332,28 @@ assemble()
             }
         }
 
-        for (insn = name->insn_entries; insn->name == name; insn++) {
-            if (insn->nr_operands != nr_operands) goto mismatch;
-            if ((bits == 16) && (insn->insn_flags & I_NO_BITS_16)) goto mismatch;
-            if ((bits == 32) && (insn->insn_flags & I_NO_BITS_32)) goto mismatch;
-            if ((bits == 64) && (insn->insn_flags & I_NO_BITS_64)) goto mismatch;
-
-            for (i = 0; i < insn->nr_operands; i++) 
-                if (!(insn->operand_flags[i] & operands[i].flags)) goto mismatch;
-
-            break;
-
-          mismatch: ;
-        }
-
-        if (insn->name == name) 
+        if (insn = match(name))
             encode(insn);
         else
             error("invalid instruction/operand combination");
 
+        /* if an operand's eligibility for O_REL_8 depends on its location,
+           the choice of template might change, if any of them care. */
+
+        for (i = 0; i < nr_operands; i++)
+            if (operands[i].located && (name->rel8_operands & (1 << i))) unstable++;
+
       end_of_line:
         if (token != '\n') error("trailing garbage - end of line expected");
-        scan();
+
+        fragment->fixed = !unstable;
+        fragment->bytes = text_bytes + data_bytes - bytes;
+        fragment->relocs = nr_relocs - relocs;
+
+        if (list_file && (pass == FINAL_PASS)) list_line();
     }
+
+    input_index = -1;
 }
 
 main(argc, argv)
@@ -189,9 +361,13 @@ main(argc, argv)
 {
     int opt;
 
-    while ((opt = getopt(argc, argv, "o:l:")) != -1) {
+    while ((opt = getopt(argc, argv, "o:l:n:H")) != -1) {
         switch (opt)
         {
+        case 'n':
+            stdin_name = optarg;
+            break;
+
         case 'o':
             output_path = optarg;
             break;
@@ -200,6 +376,10 @@ main(argc, argv)
             list_path = optarg;
             break;
 
+        case 'H':
+            H_flag++;
+            break;
+
         default:
             exit(1);
         }
@@ -215,14 +395,16 @@ main(argc, argv)
     if (list_path) {
         list_file = fopen(list_path, "w");
         if (list_file == NULL) error("can't open list file '%s'", list_path);
+        setvbuf(list_file, NULL, _IOFBF, LIST_BUFFER);
     }
 
     /* assembly is in minimum three passes:
        FIRST_PASS:      collect symbol data
-       FIRST_PASS + n:  repeat until symbols stabilize
+       FIRST_PASS + n:  repeat until symbols stabilize, skipping fixed fragments
        FINAL_PASS:      assemble to output file */
 
     load_names();
+    load_input();
     pass = FIRST_PASS;
     assemble();
 
@@ -242,9 +424,15 @@ main(argc, argv)
     assemble();
 
     header.name_bytes = name_bytes;
+    output_sections();
     output(0, &header, sizeof(header));
+    flush_output();
 
     fclose(output_file);
     if (list_file) fclose(list_file);
+    if (H_flag) {
+        name_stats();
+        match_stats();
+    }
     return 0;
 }
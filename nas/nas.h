@@ -55,6 +55,23 @@
 
 #define MAX_INPUT_LINE      1024
 
+/* input files are read into memory in chunks of (at least) this many bytes */
+
+#define INPUT_CHUNK         65536
+
+/* size of the stdio buffer for the listing file */
+
+#define LIST_BUFFER         65536
+
+/* initial sizes of the lexeme and fragment arrays, which double as needed */
+
+#define MIN_LEXEMES         4096
+#define MIN_FRAGMENTS       1024
+
+/* initial size of the section table (see .section), which doubles as needed */
+
+#define MIN_SECTIONS        64
+
 /* no instructions with more than 3 operands (yet?) */
 
 #define MAX_OPERANDS        3
@@ -67,6 +84,7 @@
 #define NAME                128     /* classes */
 #define PSEUDO              129
 #define NUMBER              130
+#define STRING              131     /* quoted, for .ascii */
                                     
 #define BYTE                140     /* keywords */
 #define WORD                141
@@ -227,9 +245,16 @@
 #define REG_CR15            (REG | REG_CRH | REG_ENCODE(7) | 256)
 
 /* all identifiers end up in the name table: instruction mnemonics, pseudo
-   ops, symbol names, register names, etc. the more buckets, the better. */
+   ops, symbol names, register names, etc. the table starts with this many
+   buckets (a power of two) and doubles whenever it's full. */
+
+#define MIN_NAME_BUCKETS    1024
 
-#define NR_NAME_BUCKETS     32
+/* the results of matching instructions to templates are kept in a hash
+   table (see match() in nas.c), which starts with this many buckets and
+   doubles whenever it's full. */
+
+#define MIN_MATCH_BUCKETS   256
 
 struct name
 {
@@ -239,6 +264,7 @@ struct name
     struct name       * link;
     struct obj_symbol * symbol;
     struct insn       * insn_entries;
+    int                 rel8_operands;  /* bit n set if any entry has O_REL_8 at operand n */
     int             ( * pseudo )();
     int                 token;
 };
@@ -360,6 +386,37 @@ struct operand
     long                offset;
     long                flags;          /* O_* */
     long                disp;           /* O_IMM_* indicating displacement size */
+    int                 located;        /* O_REL_8 depends on where things are */
+};
+
+/* the input is scanned once, up front, into an array of lexemes, which
+   is divided into fragments: one per input line. each pass assembles the
+   fragments by replaying their lexemes through scan(). a fragment whose
+   size can't change (it doesn't depend on the value of any label or on
+   its own location) is marked 'fixed' after it's assembled, and the
+   intermediate passes skip it, just accounting for its bytes and relocs.
+   labels are kept out of the lexemes, so they're defined on every pass. */
+
+struct lexeme
+{
+    int                 token;
+    struct name       * name;           /* NAME, PSEUDO, keywords, registers */
+    long                number;         /* NUMBER, or length of STRING */
+    char              * string;         /* STRING */
+};
+
+struct fragment
+{
+    int                 lexeme;         /* index of first lexeme */
+    int                 input;          /* index into input_paths[] */
+    int                 line;           /* line number in that input */
+    char              * text;           /* the line itself, for listings */
+    struct name       * label;          /* defined at the start of the line */
+    int                 equate;         /* if NAME = ... */
+    int                 address;        /* where it started on the last pass */
+    int                 fixed;          /* non-zero if size can't change */
+    int                 bytes;          /* if fixed, bytes emitted */
+    int                 relocs;         /* .. and relocations issued */
 };
 
 /* the instruction table */
@@ -376,6 +433,19 @@ struct insn
     struct name * name;
 };
 
+/* a remembered match: the template chosen for the mnemonic 'name'
+   with 'nr_operands' operands with 'flags', in 'bits' mode. */
+
+struct match
+{
+    struct name       * name;
+    int                 nr_operands;
+    int                 bits;
+    long                flags[MAX_OPERANDS];
+    struct insn       * insn;           /* NULL if there isn't one */
+    struct match      * link;
+};
+
     /* instruction flags help with either matching or encoding */
 
 #define I_DATA_8        0x0000000000000001L     /* operand size */
@@ -392,21 +462,29 @@ struct insn
 #define I_NO_BITS_32    0x4000000000000000L     /* instruction not available in .bits 32 */
 #define I_NO_BITS_64    0x8000000000000000L     /* instruction not available in .bits 64 */
 
+/* the section the current segment is in (0 if it hasn't been divided) */
+
+#define CURRENT_SECTION     ((segment == OBJ_SYMBOL_SEG_TEXT) ? text_section : data_section)
+
 extern struct insn       insns[];
 extern int               pass;
 extern int               line_number;
 extern int               input_index;
 extern char           ** input_paths;
+extern char            * stdin_name;
 extern int               token;
 extern struct name     * name_token;
 extern long              number_token;
 extern char              input_line[];
-extern char            * input_pos;
 extern FILE            * list_file;
 extern FILE            * output_file;
 extern int               segment;
 extern int               text_bytes;
 extern int               data_bytes;
+extern struct obj_section * sections;
+extern int               nr_sections;
+extern int               text_section;
+extern int               data_section;
 extern int               nr_symbols;
 extern int               nr_symbol_changes;
 extern int               nr_relocs;
@@ -416,7 +494,13 @@ extern int               bits;
 extern struct insn     * insn;
 extern struct operand    operands[];
 extern int               nr_operands;
+extern int               unstable;
+extern int               slip;
+extern struct fragment * fragments;
+extern int               nr_fragments;
+extern char            * string_token;
 
+extern char            * input_name();
 extern struct name     * lookup_name();
 extern long              constant_expression();
 extern long              classify();
@@ -434,6 +518,7 @@ extern                   pseudo_data();
 extern                   pseudo_bss();
 extern                   pseudo_org();
 extern                   pseudo_bits();
+extern                   pseudo_section();
 extern struct obj_header header;
 
 #ifdef __STDC__
@@ -25,27 +25,69 @@
 #include <limits.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <string.h>
 #include "nas.h"
 
-/* write 'length' bytes from 'data' to the output file at 'position'.
-   this is here mainly to check for errors. */
+/* the object file is built in memory on the final pass, and written out
+   all at once by flush_output(). the last intermediate pass tells us the
+   size of everything but the names, so the image is started at that size
+   and only grows (by doubling) to fit the names. holes are left zeroed. */
+
+static char * image;
+static int    image_size;               /* bytes allocated */
+static int    image_bytes;              /* bytes used */
+
+/* write 'length' bytes from 'data' to the output image at 'position' */
 
 output(position, data, length)
     char * data;
 {
-    static int current_position = -1;
+    int size;
+
+    if ((position + length) > image_size) {
+        size = image_size ? image_size : OBJ_NAMES_OFFSET(header);
+        while (size < (position + length)) size *= 2;
+        image = realloc(image, size);
+        if (image == NULL) error("out of memory");
+        memset(image + image_size, 0, size - image_size);
+        image_size = size;
+    }
 
-    if (position != current_position) {
-        if (fseek(output_file, (long) position, SEEK_SET))
-            error("can't seek output file");
+    memcpy(image + position, data, length);
+    if ((position + length) > image_bytes) image_bytes = position + length;
+}
 
-        current_position = position;
-    }
+/* write the output image to the output file */
 
-    if (fwrite(data, sizeof(char), sizeof(char) * length, output_file) != (sizeof(char) * length))
+flush_output()
+{
+    if (fwrite(image, sizeof(char), image_bytes, output_file) != image_bytes)
         error("error writing output");
 
-    current_position += length;
+    if (fflush(output_file)) error("error writing output");
+}
+
+/* after the final pass, work out how big each section is (it extends to
+   the next section in its segment) and write the section table. */
+
+output_sections()
+{
+    int i, j;
+
+    for (i = 0; i < nr_sections; i++) {
+        sections[i].bytes = (sections[i].flags == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes;
+
+        for (j = i + 1; j < nr_sections; j++)
+            if (sections[j].flags == sections[i].flags) {
+                sections[i].bytes = sections[j].offset;
+                break;
+            }
+
+        sections[i].bytes -= sections[i].offset;
+    }
+
+    header.nr_sections = nr_sections;
+    if (nr_sections) output(OBJ_SECTIONS_OFFSET(header), sections, nr_sections * sizeof(struct obj_section));
 }
 
 /* emit 1, 2, 4, or 8 bytes to the current output segment (text or data).
@@ -114,7 +156,8 @@ resolve(n, flags, offset)
 
     if (    operands[n].symbol 
         && (operands[n].symbol->flags & OBJ_SYMBOL_DEFINED)
-        && (OBJ_SYMBOL_GET_SEG(*operands[n].symbol) == segment) )
+        && (OBJ_SYMBOL_GET_SEG(*operands[n].symbol) == segment)
+        && (OBJ_SYMBOL_GET_SECTION(*operands[n].symbol) == CURRENT_SECTION) )
     {
         operands[n].offset += operands[n].symbol->value;
         operands[n].symbol = NULL;
@@ -144,7 +187,7 @@ reloc(n, flags, rel)
     if (operands[n].symbol) {
         if (pass == FINAL_PASS) {
             reloc.flags = 0;
-            reloc.reserved = 0;
+            reloc.section = CURRENT_SECTION;
             reloc.index = operands[n].symbol->index;
             if (rel) reloc.flags |= OBJ_RELOC_REL;
 
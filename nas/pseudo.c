@@ -22,6 +22,7 @@
  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <stdlib.h>
 #include "nas.h"
 
 /* .byte <byte> [ , <byte> ...] 
@@ -71,6 +72,7 @@ pseudo_align()
         bytes = data_bytes;
 
     boundary = constant_expression();
+    unstable++;
 
     switch (boundary)
     {
@@ -121,6 +123,7 @@ pseudo_org()
     int  bytes;
 
     target = constant_expression();
+    unstable++;
 
     if (segment == OBJ_SYMBOL_SEG_TEXT) {
         fill = 0x90; /* NOP */
@@ -136,16 +139,51 @@ pseudo_org()
 /* .text
    .data
 
-   select output segment */
+   select output segment. these always mark the fragment unstable, so
+   the intermediate passes don't lose track of the segment. */
 
 pseudo_text()
 {
     segment = OBJ_SYMBOL_SEG_TEXT;
+    unstable++;
 }
 
 pseudo_data()
 {
     segment = OBJ_SYMBOL_SEG_DATA;
+    unstable++;
+}
+
+/* .section
+
+   start a new section of the current segment, which the linker may
+   leave out if nothing refers to it (see obj.h). the table is rebuilt
+   on every pass, and written out by output_sections() after the last. */
+
+pseudo_section()
+{
+    static int max_sections;
+
+    if (nr_sections == OBJ_MAX_SECTIONS) error("too many sections");
+
+    if (nr_sections == max_sections) {
+        max_sections = max_sections ? (max_sections * 2) : MIN_SECTIONS;
+        sections = (struct obj_section *) realloc(sections, max_sections * sizeof(struct obj_section));
+        if (sections == NULL) error("out of memory");
+    }
+
+    sections[nr_sections].flags = segment;
+    sections[nr_sections].offset = (segment == OBJ_SYMBOL_SEG_TEXT) ? text_bytes : data_bytes;
+    sections[nr_sections].bytes = 0;
+    sections[nr_sections].reserved = 0;
+    nr_sections++;
+
+    if (segment == OBJ_SYMBOL_SEG_TEXT)
+        text_section = nr_sections;
+    else
+        data_section = nr_sections;
+
+    unstable++;
 }
 
 /* .bss <symbol>, <size> [ , <align> ] */
@@ -185,31 +223,23 @@ pseudo_bss()
 /* .ascii <string>
 
    a string is any collection of characters (except newline) delimited 
-   by single or double quote. the scanner is bypassed since no other part
-   of the assembler cares about strings. */
+   by single or double quote. the scanner hands it over as a STRING. */
 
 pseudo_ascii()
 {
-    int delimiter;
+    long i;
 
     operands[0].kind == OPERAND_IMM;
     operands[0].symbol = NULL;
     operands[0].flags = O_IMM_8;
 
-    delimiter = token;
-    if ((delimiter != '\'') && (delimiter != '\"')) error("string expected");
+    if (token != STRING) error("string expected");
     
-    while ((*input_pos != '\n') && (*input_pos != delimiter)) {
-        operands[0].offset = *input_pos;
+    for (i = 0; i < number_token; i++) {
+        operands[0].offset = string_token[i];
         reloc(0, O_IMM_8, 0);
-        input_pos++;
     }
 
-    if (*input_pos == delimiter) 
-        input_pos++;
-    else
-        error("missing closing delimiter");
-
     scan();
 }
 
@@ -235,6 +265,7 @@ pseudo_bits()
     case 32:
     case 64:
         bits = number_token;
+        unstable++;
         break;
     default:
         error("must be 16, 32 or 64");
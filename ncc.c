@@ -29,9 +29,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <signal.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
-/* this list will shrink once we implement archive support in the linker .. */
+/* libraries linked with every program. these are archives, indexed
+   by nranlib, so the linker pulls in only the members that are used. */
 
 char * libs[] =
 {
@@ -69,6 +74,38 @@ struct list temps;          /* list of temporary files (delete before exit) */
 int    goal = EXEC_FILE;
 char * ld_out;
 
+/* each input file is a job, which runs the stages it needs (ncpp, ncc1,
+   nas) all at once, connected by pipes: only the output of the last stage
+   is written to a file. up to 'max_jobs' jobs are in flight at once. the
+   first job in flight runs on our own implicit token; when we're under 
+   the control of a make jobserver, each of the others must hold a token 
+   from it, which is returned when the job is done. */
+
+#define MAX_STAGES  3
+
+struct job
+{
+    char * src;             /* input file */
+    char * out;             /* output file, when running or done */
+    int    pids[MAX_STAGES];
+    int    nr_pids;         /* number of stages still running */
+    int    token;           /* jobserver token held, or -1 */
+};
+
+struct job * jobs;
+int          nr_jobs;
+int          nr_running;
+int          max_jobs;      /* 0 = not specified */
+
+int jobserver[2] = { -1, -1 };
+
+/* while we're waiting for a token, 'token_fd' is a duplicate of the
+   read end of the jobserver. the SIGCHLD handler closes it, so that a
+   child exiting can't go unnoticed while we're blocked in read(). */
+
+int token_fd = -1;
+int child_exited;
+
 /* print an error message and abort */
 
 #ifdef __STDC__
@@ -89,6 +126,7 @@ error(fmt)
         fputc('\n', stderr);
     }
 
+    abort_jobs();
     rmtemps();
     exit(1);
 }
@@ -202,6 +240,26 @@ morph(name, ext)
     return new;
 }
 
+/* start the program indicated by 'args' in the background and return
+   its pid. if 'in' or 'out' aren't -1, they become its stdin or stdout. */
+
+spawn(args, in, out)
+    struct list * args;
+{
+    pid_t pid;
+
+    if ((pid = fork()) == 0) {
+        if (in != -1) dup2(in, 0);
+        if (out != -1) dup2(out, 1);
+        execvp(args->s[0], args->s);
+        fprintf(stderr, "cc: can't exec '%s': %s\n", args->s[0], strerror(errno));
+        _exit(1);
+    }
+
+    if (pid == -1) error("can't fork: %s", strerror(errno));
+    return pid;
+}
+
 /* run the command indicated by 'args', which will
    output to 'out'. 'out' will be removed if the program
    returns an error. */
@@ -210,36 +268,272 @@ run(args, out)
     struct list * args;
     char        * out;
 {
-    pid_t pid;
+    int pid;
     int status;
 
-    if ((pid = fork()) == 0) {
-        execvp(args->s[0], args->s);
-        error("can't exec '%s': %s", args->s[0], strerror(errno));
-    } 
+    pid = spawn(args, -1, -1);
+    while (pid != wait(&status)) ;
 
-    if (pid == -1) error("can't fork: %s", strerror(errno));
+    if (status != 0) {
+        add(&temps, out, NULL);
+        error("compilation terminated abnormally");
+    }
+}
 
-    while (pid != wait(&status)) ;
+/* SIGCHLD handler: see token_fd */
+
+#ifdef __STDC__
+void
+reaped(int sig)
+#else
+reaped(sig)
+#endif
+{
+    child_exited = 1;
+
+    if (token_fd != -1) {
+        close(token_fd);
+        token_fd = -1;
+    }
+}
+
+/* if MAKEFLAGS advertises a jobserver, and it's actually available to
+   us, join it. make passes either a pair of pipe descriptors or the
+   name of a fifo, depending on its vintage. */
+
+join_jobserver()
+{
+    char * flags;
+    char * auth;
+    int    fd;
+
+    flags = getenv("MAKEFLAGS");
+    if (flags == NULL) return 0;
+
+    if (auth = strstr(flags, "--jobserver-auth="))
+        auth += strlen("--jobserver-auth=");
+    else if (auth = strstr(flags, "--jobserver-fds="))
+        auth += strlen("--jobserver-fds=");
+    else
+        return 0;
+
+    if (strncmp(auth, "fifo:", 5) == 0) {
+        auth = strcpy(mem(strlen(auth) + 1), auth + 5);
+        auth[strcspn(auth, " ")] = 0;
+        if ((fd = open(auth, O_RDWR)) == -1) return 0;
+        jobserver[0] = fd;
+        jobserver[1] = fd;
+    } else {
+        if (sscanf(auth, "%d,%d", &jobserver[0], &jobserver[1]) != 2) return 0;
+
+        if ((fcntl(jobserver[0], F_GETFD) == -1) || (fcntl(jobserver[1], F_GETFD) == -1)) {
+            jobserver[0] = -1;
+            jobserver[1] = -1;
+            return 0;
+        }
+    }
+
+    signal(SIGCHLD, reaped);
+}
+
+/* get permission to start 'job'. returns 0 if a child exited
+   while we were waiting, so the caller can deal with it first. */
+
+acquire(job)
+    struct job * job;
+{
+    char token;
+    int  n;
+
+    job->token = -1;
+    if ((nr_running == 0) || (jobserver[0] == -1)) return 1;
+
+    token_fd = dup(jobserver[0]);
+    if (child_exited) n = -1; else n = read(token_fd, &token, 1);
+    if (token_fd != -1) close(token_fd);
+    token_fd = -1;
+
+    if (n == 1) {
+        job->token = token & 255;
+        return 1;
+    }
+
+    if (n == 0) {           /* make is gone */
+        jobserver[0] = -1;
+        jobserver[1] = -1;
+    }
+
+    return 0;
+}
+
+/* return the token, if any, held by 'job' */
+
+release(job)
+    struct job * job;
+{
+    char token;
+
+    if (job->token != -1) {
+        token = job->token;
+        write(jobserver[1], &token, 1);
+        job->token = -1;
+    }
+}
+
+/* start the pipeline for 'job'. it runs from the stage that takes the
+   input file through to the one that produces the goal (or an object).
+   the stages in between exchange data over pipes, which are close-on-exec
+   so that each one is only held open by the two stages it connects. */
+
+start(job)
+    struct job * job;
+{
+    int    src_type;
+    int    out_type;
+    int    in = -1;
+    int    fds[2];
+
+    src_type = type(job->src);
+    job->nr_pids = 0;
+
+    do {
+        switch (src_type) {
+            case C_FILE:
+                out_type = CC1_FILE;
+                copy(&args, &cpp);
+                break;
+
+            case CC1_FILE:
+                out_type = ASM_FILE;
+                copy(&args, &cc1);
+                break;
+
+            case ASM_FILE:
+                out_type = OBJ_FILE;
+                copy(&args, &as);
+        }
+
+        if ((out_type == goal) || (out_type == OBJ_FILE)) {
+            job->out = morph(job->src, out_type);
+            fds[1] = -1;
+        } else {
+            if (pipe(fds) == -1) error("can't create pipe: %s", strerror(errno));
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+            fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        }
+
+        if (src_type == ASM_FILE) {
+            add(&args, job->out, NULL);
+
+            if (in == -1)
+                add(&args, job->src, NULL);
+            else
+                add(&args, "-n", job->src, "-", NULL);
+        } else
+            add(&args, (in == -1) ? job->src : "-", (fds[1] == -1) ? job->out : "-", NULL);
+
+        job->pids[job->nr_pids++] = spawn(&args, in, fds[1]);
+
+        if (in != -1) close(in);
+        if (fds[1] != -1) close(fds[1]);
+        in = fds[0];
+        src_type = out_type;
+    } while (fds[1] != -1);
+}
+
+/* the process 'pid' exited with 'status'. if it's a stage of
+   a job, and the last one of the job to finish, retire the job. */
+
+finish(pid, status)
+{
+    struct job * job;
+    int          i;
+
+    for (job = jobs; job < jobs + nr_jobs; ++job)
+        for (i = 0; i < job->nr_pids; ++i)
+            if (job->pids[i] == pid) goto found;
+
+    return 0;
+
+found:
+    job->pids[i] = job->pids[--job->nr_pids];
 
     if (status != 0) {
+        add(&temps, job->out, NULL);
         error("compilation terminated abnormally");
-        add(&temps, out, NULL);
-        error(NULL);
+    }
+
+    if (job->nr_pids == 0) {
+        if (goal == EXEC_FILE) add(&temps, job->out, NULL);
+        release(job);
+        --nr_running;
+    }
+}
+
+/* run all the jobs to completion */
+
+run_jobs()
+{
+    int next = 0;
+    int pid;
+    int status;
+
+    if (max_jobs == 0) max_jobs = (jobserver[0] == -1) ? 1 : nr_jobs;
+
+    for (;;) {
+        child_exited = 0;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) finish(pid, status);
+
+        if ((next < nr_jobs) && (type(jobs[next].src) == OBJ_FILE)) {
+            ++next;
+            continue;
+        }
+
+        if ((next < nr_jobs) && (nr_running < max_jobs) && acquire(&jobs[next])) {
+            start(&jobs[next++]);
+            ++nr_running;
+            continue;
+        }
+
+        if (nr_running == 0) break;
+        if ((pid = wait(&status)) != -1) finish(pid, status);
+    }
+}
+
+/* something went wrong: stop the jobs in flight, discarding their output */
+
+abort_jobs()
+{
+    struct job * job;
+    int          n;
+    int          i;
+    int          status;
+
+    n = nr_jobs;
+    nr_jobs = 0;    /* in case we're called again */
+
+    for (job = jobs; job < jobs + n; ++job) {
+        if (job->nr_pids) {
+            for (i = 0; i < job->nr_pids; ++i) kill(job->pids[i], SIGTERM);
+            for (i = 0; i < job->nr_pids; ++i) waitpid(job->pids[i], &status, 0);
+            add(&temps, job->out, NULL);
+            job->nr_pids = 0;
+        }
+
+        release(job);
     }
 }
 
 main(argc, argv)
     char * argv[];
 {
-    char * new;
-    char * src;
-    int    i; 
+    char * jobs_arg;
+    int    i;
 
     add(&cpp, "ncpp", NULL); 
     add(&cc1, "ncc1", NULL);
     add(&as, "nas", "-o", NULL);
-    add(&ld, "nld", "-b", "0xFFFFFF8000000000", "-e", "cstart", "-o", NULL);
+    add(&ld, "nld", "-b", "0xFFFFFF8000000000", "-e", "cstart", NULL);
 
     ++argv;
 
@@ -252,9 +546,16 @@ main(argc, argv)
         
             case 'g':
             case 'O':
+            case 'm':
+            case 'f':
                 add(&cc1, *argv, NULL);
                 break;
 
+            case 'G':
+                if ((*argv)[2]) error("malformed gc option");
+                add(&ld, *argv, NULL);
+                break;
+
             case 'S':
             case 'P':
             case 'c':
@@ -274,6 +575,18 @@ main(argc, argv)
                 ld_out = *argv;
                 break;
 
+            case 'j':
+                if ((*argv)[2])
+                    jobs_arg = *argv + 2;
+                else if (argv[1])
+                    jobs_arg = *++argv;
+                else
+                    error("malformed jobs option");
+
+                max_jobs = atoi(jobs_arg);
+                if (max_jobs < 1) error("malformed jobs option");
+                break;
+
             default:
                 error("unrecognized option: %c\n", (*argv)[1]);
         }
@@ -281,50 +594,25 @@ main(argc, argv)
     }
 
     if (ld_out == NULL) ld_out = "a.out";
-    add(&ld, ld_out, "/lib/cstart.o", NULL); 
+    add(&ld, "-o", ld_out, "/lib/cstart.o", NULL);
 
     if (*argv == NULL) error("no input files");
 
-    while (*argv) {
-        src = *argv;
-        switch (type(src)) {
-            case C_FILE:
-                new = morph(src, CC1_FILE);
-                copy(&args, &cpp);
-                add(&args, src, NULL);
-                add(&args, new, NULL);
-                run(&args, new);
-                if (goal == CC1_FILE) break;
-                add(&temps, new, NULL);
-                src = new;
-
-            case CC1_FILE:
-                new = morph(src, ASM_FILE);
-                copy(&args, &cc1);
-                add(&args, src, NULL);
-                add(&args, new, NULL);
-                run(&args, new);
-                if (goal == ASM_FILE) break;
-                src = new;
-                add(&temps, new, NULL);
-
-            case ASM_FILE:
-                new = morph(src, OBJ_FILE);
-                copy(&args, &as);
-                add(&args, new, NULL);
-                add(&args, src, NULL);
-                run(&args, new);
-                if (goal == OBJ_FILE) break;
-                add(&temps, new, NULL);
-                src = new;
+    for (i = 0; argv[i]; ++i) type(argv[i]);
+    jobs = (struct job *) mem(sizeof(struct job) * i);
 
-            case OBJ_FILE:
-                add(&ld,  src, NULL);
-        }
-        argv++;
+    for (nr_jobs = 0; nr_jobs < i; ++nr_jobs) {
+        jobs[nr_jobs].src = argv[nr_jobs];
+        jobs[nr_jobs].out = jobs[nr_jobs].src;
+        jobs[nr_jobs].nr_pids = 0;
+        jobs[nr_jobs].token = -1;
     }
 
+    join_jobserver();
+    run_jobs();
+
     if (goal == EXEC_FILE) {
+        for (i = 0; i < nr_jobs; ++i) add(&ld, jobs[i].out, NULL);
         for (i = 0; i < NR_LIBS; ++i) add(&ld, libs[i], NULL);
         run(&ld, ld_out);
     }
@@ -0,0 +1,197 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org).
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include "ncc1.h"
+
+/* the alias oracle answers one question: might two E_MEM operands refer
+   to overlapping storage? it uses only what's evident in the operands:
+
+   1. frame slots ([rbp+ofs]) and globals ([glob+ofs]) are known objects.
+      known objects are disjoint unless they're the same global, or both
+      in the frame, in which case the offsets and sizes decide (unless an
+      index register makes the offset unknown).
+   2. accesses of different types don't overlap: values of one size and
+      kind (integral or pointer, float, double) aren't stored through
+      pointers to another. char accesses are exempt.
+   3. members of different structs don't overlap, and a member of a struct
+      can't live in an object that isn't (or doesn't contain) a struct.
+
+   the type-based rules (2 and 3) don't hold in code that converts pointers
+   between types, so they're suspended for any function which contains an
+   explicit cast of an address or pointer (see cast_expression()), except
+   to char *. members of unions are considered to overlap everything.
+
+   nor can a function see the conversions made elsewhere: two pointers it
+   is handed may well point to the same object as different types (this is
+   how struct sockaddr is used, and without prototypes no cast is needed
+   to pass an int * as a long *). so the type-based rules only apply when
+   one of the operands is a known symbol, whose type is then evident, and
+   never to two accesses through pointers. even then, a global, or a local
+   whose address is taken, can be reached through a pointer which was so
+   converted, so for those only rule 1 is applied. */
+
+/* if 'tree', the address child of an E_FETCH, refers to a struct or union
+   member, return the tag of the innermost struct which contains it - or of
+   the outermost union, since members of a union overlap by design. this
+   recognizes the E_ADDs of member offsets made by member_expression(). */
+
+struct symbol *
+access_tag(tree)
+    struct tree * tree;
+{
+    struct symbol * tag = NULL;
+
+    while ((tree->op == E_ADD) && (tree->u.ch[1]->op == E_CON)) {
+        tree = tree->u.ch[0];
+        if (!(tree->type->ts & T_PTR) || !(tree->type->next->ts & T_TAG)) break;
+        if (!tag || (tree->type->next->tag->ss & S_UNION)) tag = tree->type->next->tag;
+    }
+
+    return tag;
+}
+
+/* which known object, if any, does 'tree' refer to? */
+
+#define OBJECT_UNKNOWN      0
+#define OBJECT_FRAME        1
+#define OBJECT_GLOBAL       2
+
+static
+object(tree)
+    struct tree * tree;
+{
+    if (tree->u.mi.glob) return OBJECT_GLOBAL;
+    if (tree->u.mi.b == R_BP) return OBJECT_FRAME;
+    return OBJECT_UNKNOWN;
+}
+
+/* does the 'type' of an object include a struct or union? */
+
+static
+has_tag(type)
+    struct type * type;
+{
+    for (; type; type = type->next) {
+        if (type->ts & T_TAG) return 1;
+        if (type->ts & (T_PTR | T_FUNC)) break;
+    }
+
+    return 0;
+}
+
+/* the kind of value accessed by 'type', for rule 2. 0 matches anything. */
+
+static
+kind(type)
+    struct type * type;
+{
+    if (type->ts & (T_FIELD | T_IS_CHAR)) return 0;
+    if (type->ts & T_FLOAT) return -1;
+    if (type->ts & T_LFLOAT) return -2;
+    return size_of(type);
+}
+
+/* the guts of may_alias(). 'a_symbol' and 'b_symbol' are the symbols of
+   the objects referenced, if known, or NULL. */
+
+static
+alias(a, a_symbol, b, b_symbol)
+    struct tree   * a;
+    struct symbol * a_symbol;
+    struct tree   * b;
+    struct symbol * b_symbol;
+{
+    int a_object = object(a);
+    int b_object = object(b);
+
+    if (a_object && b_object) {
+        if (a_object != b_object) return 0;
+        if (a->u.mi.glob != b->u.mi.glob) return 0;
+        if ((a->u.mi.i != R_NONE) || (b->u.mi.i != R_NONE)) return 1;
+        if ((a_object == OBJECT_GLOBAL) && ((a->u.mi.b != R_NONE) || (b->u.mi.b != R_NONE))) return 1;
+
+        return (a->u.mi.ofs < b->u.mi.ofs + size_of(b->type))
+            && (b->u.mi.ofs < a->u.mi.ofs + size_of(a->type));
+    }
+
+    if (type_puns) return 1;
+    if (!a_symbol && !b_symbol) return 1;
+    if (!kind(a->type) || !kind(b->type)) return 1;
+    if (a->u.mi.tag && (a->u.mi.tag->ss & S_UNION)) return 1;
+    if (b->u.mi.tag && (b->u.mi.tag->ss & S_UNION)) return 1;
+
+    if (kind(a->type) != kind(b->type)) return 0;
+    if (a->u.mi.tag && b->u.mi.tag && (a->u.mi.tag != b->u.mi.tag)) return 0;
+    if (a->u.mi.tag && !b->u.mi.tag && b_symbol && !has_tag(b_symbol->type)) return 0;
+    if (b->u.mi.tag && !a->u.mi.tag && a_symbol && !has_tag(a_symbol->type)) return 0;
+
+    return 1;
+}
+
+/* might E_MEM operands 'a' and 'b' overlap? this is used to remove dead
+   stores, and a store through a pointer is never dead just because it's
+   of a different type than the loads which follow it, so only the known
+   objects are considered here: the type-based rules aren't applied. */
+
+may_alias(a, b)
+    struct tree * a;
+    struct tree * b;
+{
+    return alias(a, NULL, b, NULL);
+}
+
+/* might E_MEM operand 'tree' overlap the storage of the 'symbol'?
+   this is may_alias() against the symbol's memory_tree(), but
+   with the benefit of knowing the symbol in the frame. */
+
+may_alias_symbol(tree, symbol)
+    struct tree   * tree;
+    struct symbol * symbol;
+{
+    struct tree memory;
+
+    memory.op = E_MEM;
+    memory.type = symbol->type;
+    memory.u.mi.glob = NULL;
+    memory.u.mi.ofs = 0;
+    memory.u.mi.b = R_NONE;
+    memory.u.mi.i = R_NONE;
+    memory.u.mi.s = 1;
+    memory.u.mi.rip = 0;
+    memory.u.mi.tag = NULL;
+
+    if (symbol->ss & S_BLOCK) {
+        store_symbol(symbol);
+        memory.u.mi.ofs = symbol->i;
+        memory.u.mi.b = R_BP;
+    } else {
+        memory.u.mi.glob = symbol;
+        memory.u.mi.rip = 1;
+    }
+
+    if (symbol->ss & (S_AUTO | S_STATIC | S_EXTERN))
+        return alias(tree, NULL, &memory, NULL);
+    else
+        return alias(tree, NULL, &memory, symbol);
+}
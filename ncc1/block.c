@@ -23,8 +23,17 @@
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include <stdlib.h>
+#include <string.h>
 #include "ncc1.h"
 
+/* the blocks, instructions and def/use data of a function all live
+   in the function arena, so they vanish together in free_blocks(). */
+
+static struct pool block_pool = { sizeof(struct block), ARENA_FUNCTION };
+static struct pool list_pool = { sizeof(struct block_list), ARENA_FUNCTION };
+static struct pool insn_pool = { sizeof(struct insn), ARENA_FUNCTION };
+static struct pool defuse_pool = { sizeof(struct defuse), ARENA_FUNCTION };
+
 /* place a block on the master list before another block.
    if 'before' is NULL, the block goes at the end. */
 
@@ -66,6 +75,16 @@ get_block(block)
         first_block = block->next;
 }
 
+/* move a block on the master list to just before another block. */
+
+move_block(block, before)
+    struct block * block;
+    struct block * before;
+{
+    get_block(block);
+    put_block(block, before);
+}
+
 /* create a new, empty block, and place it on the end of the master list. */
 
 struct block *
@@ -74,7 +93,7 @@ new_block()
     struct block * block;
     int            i;
 
-    block = (struct block *) allocate(sizeof(struct block));
+    block = (struct block *) pool_allocate(&block_pool);
     block->asm_label = next_asm_label++;
     block->bs = 0;
     block->nr_insns = 0;
@@ -86,6 +105,17 @@ new_block()
     block->nr_successors = 0;
     block->nr_predecessors = 0;
     block->defuses = NULL;
+    block->defuse_buckets = NULL;
+    block->nr_defuse_buckets = 0;
+    block->nr_defuses = 0;
+    block->work_link = NULL;
+    block->jump_table = NULL;
+    block->dfn = -1;
+    block->live_use = NULL;
+    block->live_def = NULL;
+    block->live_in = NULL;
+    block->live_out = NULL;
+    block->live_near = NULL;
 
     for (i = 0; i < NR_REGS; i++) {
         block->iregs[i] = NULL;
@@ -107,14 +137,14 @@ succeed_block(block, cc, successor)
     struct block_list * list;
 
     if (cc != CC_NEVER) {
-        list = (struct block_list *) allocate(sizeof(struct block_list));
+        list = (struct block_list *) pool_allocate(&list_pool);
         list->cc = cc;
         list->block = successor;
         list->link = block->successors;
         block->successors = list;
         block->nr_successors++;
 
-        list = (struct block_list *) allocate(sizeof(struct block_list));
+        list = (struct block_list *) pool_allocate(&list_pool);
         list->cc = CC_NONE;
         list->block = block;
         list->link = successor->predecessors;
@@ -137,14 +167,14 @@ unsucceed_block(block, n)
     successor = (*listp)->block;
     tmp = *listp;
     *listp = tmp->link;
-    free(tmp);
+    pool_free(&list_pool, tmp);
     block->nr_successors--;
 
     listp = &(successor->predecessors);
     while ((*listp)->block != block) listp = &((*listp)->link);
     tmp = *listp;
     *listp = tmp->link;
-    free(tmp);
+    pool_free(&list_pool, tmp);
     successor->nr_predecessors--;
 }
 
@@ -216,24 +246,54 @@ free_block(block)
 
     while (list = block->successors) {
         block->successors = list->link;
-        free(list);
+        pool_free(&list_pool, list);
     }
 
     while (list = block->predecessors) {
         block->predecessors = list->link;
-        free(list);
+        pool_free(&list_pool, list);
     }
 
     free_defuses(block);
-    free(block);
+    if (block->defuse_buckets) free(block->defuse_buckets);
+    free_live(block);
+    pool_free(&block_pool, block);
 }
 
-/* called after code generation is complete */
+/* free the operands of an instruction */
+
+static
+free_operands(insn)
+    struct insn * insn;
+{
+    int i;
+
+    for (i = 0; i < I_NR_OPERANDS(insn->opcode); i++)
+        free_tree(insn->operand[i]);
+}
+
+/* called after code generation is complete. the blocks themselves
+   are released with the function arena; only the operand trees, the
+   def/use hash tables and the live bitsets, which are allocated
+   elsewhere, are freed one by one. */
 
 free_blocks()
 {
-    while (first_block) free_block(first_block);
+    struct block * block;
+    struct insn  * insn;
+
+    for (block = first_block; block; block = block->next) {
+        for (insn = block->first_insn; insn; insn = insn->next)
+            free_operands(insn);
 
+        if (block->defuse_buckets) free(block->defuse_buckets);
+        free_live(block);
+    }
+
+    release_arena(ARENA_FUNCTION);
+
+    first_block = NULL;
+    last_block = NULL;
     entry_block = NULL;
     exit_block = NULL;
     current_block = NULL;
@@ -250,7 +310,7 @@ new_insn(opcode, operand0, operand1, operand2)
 {
     struct insn * insn;
 
-    insn = (struct insn *) allocate(sizeof(struct insn));
+    insn = (struct insn *) pool_allocate(&insn_pool);
     insn->opcode = opcode;
     insn->operand[0] = (I_NR_OPERANDS(opcode) >= 1) ? operand0 : NULL;
     insn->operand[1] = (I_NR_OPERANDS(opcode) >= 2) ? operand1 : NULL;
@@ -258,6 +318,8 @@ new_insn(opcode, operand0, operand1, operand2)
     insn->next = NULL;
     insn->previous = NULL;
     insn->flags = 0;
+    insn->nr_iargs = 0;
+    insn->nr_fargs = 0;
     return insn;
 }
 
@@ -266,12 +328,8 @@ new_insn(opcode, operand0, operand1, operand2)
 free_insn(insn)
     struct insn * insn;
 {
-    int i;
-
-    for (i = 0; i < I_NR_OPERANDS(insn->opcode); i++)
-        free_tree(insn->operand[i]);
-
-    free(insn);
+    free_operands(insn);
+    pool_free(&insn_pool, insn);
 }
 
 /* put an instruction into the instruction list in a block, 
@@ -377,6 +435,19 @@ analyze_insn(insn)
     if (insn->opcode & I_DEF_CX) analyze_insn1(insn->regs_defd, R_CX);
     if (insn->opcode & I_DEF_XMM0) analyze_insn1(insn->regs_defd, R_XMM0);
 
+    /* under -mregparm, a call DEFs all the scratch registers 
+       and USEs the registers which carry its arguments. */
+
+    if ((insn->opcode == I_CALL) && regparm_flag) {
+        for (i = 0; i < NR_REGS; i++) {
+            if (scratch_iregs & (1 << i)) analyze_insn1(insn->regs_defd, R_AX + i);
+            if (scratch_fregs & (1 << i)) analyze_insn1(insn->regs_defd, R_XMM0 + i);
+        }
+
+        for (i = 0; i < insn->nr_iargs; i++) analyze_insn1(insn->regs_used, iarg_regs[i]);
+        for (i = 0; i < insn->nr_fargs; i++) analyze_insn1(insn->regs_used, R_XMM0 + i);
+    }
+
     for (i = 0; i < I_NR_OPERANDS(insn->opcode); i++) {
         if (insn->operand[i]->op == E_REG) {
             if (insn->opcode & I_DEF(i)) 
@@ -512,6 +583,8 @@ split_block(block)
     }
 
     succeed_block(block, CC_ALWAYS, latter);
+    latter->jump_table = block->jump_table;
+    block->jump_table = NULL;
 }
 
 /* order and analyze all the instructions, and determine
@@ -524,27 +597,24 @@ analyze_block(block)
     struct insn * insn;
     struct insn * last_cc = NULL;
     int           n;
+    int           i;
 
     block->prohibit_iregs = (1 << R_IDX(R_BP)) | (1 << R_IDX(R_SP));
-    block->temponly_iregs = (   (1 << R_IDX(R_AX)) 
-                            |   (1 << R_IDX(R_CX)) 
-                            |   (1 << R_IDX(R_DX)) );
+    block->temponly_iregs = scratch_iregs;
 
     block->prohibit_fregs = 0;
-    block->temponly_fregs = 1 << R_IDX(R_XMM0);
+    block->temponly_fregs = scratch_fregs;
 
     for (insn = block->first_insn, n = 1; insn; insn = insn->next, ++n) {
         insn->n = n;
         analyze_insn(insn);
 
-        if (insn_touches_reg(insn, R_AX)) 
-            block->prohibit_iregs |= 1 << R_IDX(R_AX);
-        if (insn_touches_reg(insn, R_DX)) 
-            block->prohibit_iregs |= 1 << R_IDX(R_DX);
-        if (insn_touches_reg(insn, R_CX)) 
-            block->prohibit_iregs |= 1 << R_IDX(R_CX);
-        if (insn_touches_reg(insn, R_XMM0)) 
-            block->prohibit_fregs |= 1 << R_IDX(R_XMM0);
+        for (i = 0; i < NR_REGS; i++) {
+            if ((scratch_iregs & (1 << i)) && insn_touches_reg(insn, R_AX + i)) 
+                block->prohibit_iregs |= 1 << i;
+            if ((scratch_fregs & (1 << i)) && insn_touches_reg(insn, R_XMM0 + i)) 
+                block->prohibit_fregs |= 1 << i;
+        }
 
         if ((insn->opcode & I_USE_CC) && last_cc) 
             last_cc->flags |= INSN_FLAG_CC;
@@ -560,7 +630,7 @@ analyze_block(block)
 
 /* analyze all blocks. then, if a register isn't prohibited in any
    block, then it isn't subject to a temponly restriction. this mainly
-   opens up AX, CX, DX and XMM0 in leaf routines to global allocation. */
+   opens up the scratch registers in leaf routines to global allocation. */
 
 static
 analyze_blocks()
@@ -621,46 +691,116 @@ free_defuses(block)
 
     for (defuse = block->defuses; defuse; defuse = tmp) {
         tmp = defuse->link;
-        free(defuse);
+        pool_free(&defuse_pool, defuse);
     }
 
     block->defuses = NULL;
+    block->nr_defuses = 0;
+
+    if (block->defuse_buckets)
+        memset(block->defuse_buckets, 0, block->nr_defuse_buckets * sizeof(struct defuse *));
 }
 
-/* find the def/use information associated with a (pseudo) register in the 
-   specified block. if mode is FIND_DEFUSE_CREATE, this is guaranteed to 
-   return an entry, otherwise NULL is returned if no def/use data exists. */
+/* free the live variable bitsets of a block. */
 
-struct defuse *
-find_defuse(block, reg, mode)
+free_live(block)
+    struct block * block;
+{
+    if (block->live_use) free(block->live_use);
+
+    block->live_use = NULL;
+    block->live_def = NULL;
+    block->live_in = NULL;
+    block->live_out = NULL;
+    block->live_near = NULL;
+}
+
+/* besides being listed, the def/use records of a block are hashed by
+   register. a block has a record for every symbol live in or out of it,
+   which can be most of the symbols in the function, so they can't be
+   found by walking the list. the table doubles when the number of
+   records reaches the number of buckets. */
+
+#define DEFUSE_BUCKET(block, reg)                                               \
+    (((unsigned) R_IDX(reg) * 2 + (((reg) & R_IS_FLOAT) != 0))                  \
+     & ((block)->nr_defuse_buckets - 1))
+
+static
+grow_defuses(block)
     struct block * block;
 {
     struct defuse * defuse;
-    struct symbol * symbol;
+    int             i;
 
-    for (defuse = block->defuses; defuse; defuse = defuse->link) 
-        if (defuse->symbol->reg == reg) return defuse;
+    if (block->defuse_buckets) free(block->defuse_buckets);
 
-    if (mode != FIND_DEFUSE_CREATE) return NULL;
+    if (block->nr_defuse_buckets)
+        block->nr_defuse_buckets *= 2;
+    else
+        block->nr_defuse_buckets = MIN_DEFUSE_BUCKETS;
 
-    symbol = find_symbol_by_reg(reg);
-    if (symbol == NULL) error(ERROR_INTERNAL);
+    block->defuse_buckets = (struct defuse **) allocate(block->nr_defuse_buckets * sizeof(struct defuse *));
+    memset(block->defuse_buckets, 0, block->nr_defuse_buckets * sizeof(struct defuse *));
+
+    for (defuse = block->defuses; defuse; defuse = defuse->link) {
+        i = DEFUSE_BUCKET(block, defuse->symbol->reg);
+        defuse->hash_link = block->defuse_buckets[i];
+        block->defuse_buckets[i] = defuse;
+    }
+}
+
+/* find the def/use information associated with a (pseudo) register in the 
+   specified block. if mode is FIND_DEFUSE_CREATE, this is guaranteed to 
+   return an entry, otherwise NULL is returned if no def/use data exists. */
+
+static struct defuse *
+new_defuse(block, symbol)
+    struct block  * block;
+    struct symbol * symbol;
+{
+    struct defuse * defuse;
+    int             i;
 
-    defuse = (struct defuse *) allocate(sizeof(struct defuse));
+    defuse = (struct defuse *) pool_allocate(&defuse_pool);
     defuse->symbol = symbol;
     defuse->dus = 0;
     defuse->reg = R_NONE;
     defuse->first_n = 0;
     defuse->last_n = 0;
     defuse->distance = 0;
-    defuse->con = 0;
     defuse->cache = DU_CACHE_INVALID;
+    if (block->nr_defuses == block->nr_defuse_buckets) grow_defuses(block);
     defuse->link = block->defuses;
     block->defuses = defuse;
+    i = DEFUSE_BUCKET(block, symbol->reg);
+    defuse->hash_link = block->defuse_buckets[i];
+    block->defuse_buckets[i] = defuse;
+    block->nr_defuses++;
+
     return defuse;
 }
 
-/* like above, except no ability to create non-existent entries. */
+struct defuse *
+find_defuse(block, reg, mode)
+    struct block * block;
+{
+    struct defuse * defuse;
+    struct symbol * symbol;
+
+    if (block->defuse_buckets)
+        for (defuse = block->defuse_buckets[DEFUSE_BUCKET(block, reg)]; defuse; defuse = defuse->hash_link)
+            if (defuse->symbol->reg == reg) return defuse;
+
+    if (mode != FIND_DEFUSE_CREATE) return NULL;
+
+    symbol = find_symbol_by_reg(reg);
+    if (symbol == NULL) error(ERROR_INTERNAL);
+
+    return new_defuse(block, symbol);
+}
+
+/* like above, except no ability to create non-existent entries.
+   a NULL 'symbol' (an empty register, say) is never found. */
 
 struct defuse *
 find_defuse_by_symbol(block, symbol)
@@ -669,8 +809,9 @@ find_defuse_by_symbol(block, symbol)
 {
     struct defuse * defuse;
 
-    for (defuse = block->defuses; defuse; defuse = defuse->link) 
-        if (defuse->symbol == symbol) return defuse;
+    if (symbol && block->defuse_buckets)
+        for (defuse = block->defuse_buckets[DEFUSE_BUCKET(block, symbol->reg)]; defuse; defuse = defuse->hash_link)
+            if (defuse->symbol == symbol) return defuse;
 
     return NULL;
 }
@@ -718,57 +859,725 @@ compute_block_defuses(block)
     }
 }
 
-/* compute global def/use data. this destroys any existing def/use data. */
+/* live variable analysis is done with bitsets. every symbol that appears
+   in the def/use data is given a compact number, and each block gets USE,
+   DEF, IN and OUT sets indexed by those numbers. the data flow equations
+   are then solved a word at a time. the results are copied back into the
+   def/use records (as DU_IN and DU_OUT) for the rest of the compiler. */
+
+#define LIVE_WORD(i)        ((i) / 32)
+#define LIVE_BIT(i)         (1U << ((i) % 32))
+#define LIVE_TEST(set, i)   ((set)[LIVE_WORD(i)] & LIVE_BIT(i))
+
+static struct symbol ** live_symbols;       /* number -> symbol */
+static int              nr_live_symbols;
+static int              nr_live_words;      /* words in each set */
+static int            * live_inums;         /* pseudo register -> number */
+static int            * live_fnums;
+static int              live_ibase, live_ilimit;
+static int              live_fbase, live_flimit;
+static struct block  ** live_order;         /* blocks in postorder */
+static int              nr_live_order;
+static struct defuse ** live_defuses;       /* number -> defuse (scratch) */
+static struct block  ** live_queue;         /* for live_symbol() */
+
+/* the blocks live_symbol() visits, with the old state of their records */
+
+struct live_visit
+{
+    struct block * block;
+    int            dus;         /* DU_IN and DU_OUT */
+    int            distance;
+};
 
-compute_global_defuses()
+static struct live_visit * live_region;
+
+/* return the number of the symbol assigned 'reg', or -1 if it has none */
+
+static
+live_number(reg)
+{
+    int i = R_IDX(reg);
+
+    if (reg & R_IS_FLOAT) {
+        if ((i >= live_fbase) && (i < live_flimit)) return live_fnums[i - live_fbase];
+    } else {
+        if ((i >= live_ibase) && (i < live_ilimit)) return live_inums[i - live_ibase];
+    }
+
+    return -1;
+}
+
+/* widen the range [*base, *limit) to include 'i' */
+
+static
+live_range(base, limit, i)
+    int * base;
+    int * limit;
+{
+    if (*base == *limit) {
+        *base = i;
+        *limit = i + 1;
+    } else {
+        if (i < *base) *base = i;
+        if (i >= *limit) *limit = i + 1;
+    }
+}
+
+/* number the symbols in the def/use data, and set up 
+   the bitsets of each block with its local data. */
+
+static
+live_numbers()
 {
     struct block  * block;
-    struct block  * successor;
     struct defuse * defuse;
-    struct defuse * succ_defuse;
-    int             changes;
-    int             n;
-    int             distance;
+    int             i, n;
 
-    analyze_blocks();
+    if (live_symbols) free(live_symbols);
+    if (live_inums) free(live_inums);
+    if (live_fnums) free(live_fnums);
+    if (live_defuses) free(live_defuses);
+
+    live_ibase = live_ilimit = live_fbase = live_flimit = 0;
+    nr_live_symbols = 0;
 
     for (block = first_block; block; block = block->next) 
-        compute_block_defuses(block);
+        for (defuse = block->defuses; defuse; defuse = defuse->link) {
+            i = R_IDX(defuse->symbol->reg);
+
+            if (defuse->symbol->reg & R_IS_FLOAT)
+                live_range(&live_fbase, &live_flimit, i);
+            else
+                live_range(&live_ibase, &live_ilimit, i);
+        }
+
+    live_inums = (int *) allocate((live_ilimit - live_ibase + 1) * sizeof(int));
+    live_fnums = (int *) allocate((live_flimit - live_fbase + 1) * sizeof(int));
+    for (i = live_ibase; i < live_ilimit; i++) live_inums[i - live_ibase] = -1;
+    for (i = live_fbase; i < live_flimit; i++) live_fnums[i - live_fbase] = -1;
+
+    n = (live_ilimit - live_ibase) + (live_flimit - live_fbase);
+    live_symbols = (struct symbol **) allocate((n + 1) * sizeof(struct symbol *));
+    live_defuses = (struct defuse **) allocate((n + 1) * sizeof(struct defuse *));
+
+    for (block = first_block; block; block = block->next) 
+        for (defuse = block->defuses; defuse; defuse = defuse->link) {
+            if (live_number(defuse->symbol->reg) != -1) continue;
+            i = R_IDX(defuse->symbol->reg);
+
+            if (defuse->symbol->reg & R_IS_FLOAT)
+                live_fnums[i - live_fbase] = nr_live_symbols;
+            else
+                live_inums[i - live_ibase] = nr_live_symbols;
+
+            live_defuses[nr_live_symbols] = NULL;
+            live_symbols[nr_live_symbols++] = defuse->symbol;
+        }
+
+    nr_live_words = LIVE_WORD(nr_live_symbols) + 1;
+
+    for (block = first_block; block; block = block->next) {
+        free_live(block);
+        block->live_use = (unsigned *) allocate(nr_live_words * 6 * sizeof(unsigned));
+        block->live_def = block->live_use + nr_live_words;
+        block->live_in = block->live_def + nr_live_words;
+        block->live_out = block->live_in + nr_live_words;
+        block->live_near = block->live_out + nr_live_words;
+        memset(block->live_use, 0, nr_live_words * 6 * sizeof(unsigned));
+
+        for (defuse = block->defuses; defuse; defuse = defuse->link) {
+            i = live_number(defuse->symbol->reg);
+            if (defuse->dus & DU_USE) block->live_use[LIVE_WORD(i)] |= LIVE_BIT(i);
+            if (defuse->dus & DU_DEF) block->live_def[LIVE_WORD(i)] |= LIVE_BIT(i);
+        }
+    }
+}
+
+/* put the blocks in postorder (successors before predecessors, except 
+   around loops), which is the best order to solve backwards problems. */
+
+static
+live_order1(block)
+    struct block * block;
+{
+    struct block * successor;
+    int            n;
+
+    block->bs |= B_POST;
+
+    for (n = 0; successor = block_successor(block, n); ++n)
+        if (!(successor->bs & B_POST)) live_order1(successor);
+
+    live_order[nr_live_order++] = block;
+}
+
+static
+live_orders()
+{
+    struct block * block;
+    int            n = 0;
+
+    for (block = first_block; block; block = block->next) {
+        block->bs &= ~B_POST;
+        ++n;
+    }
+
+    if (live_order) free(live_order);
+    if (live_queue) free(live_queue);
+    if (live_region) free(live_region);
+    live_order = (struct block **) allocate(n * sizeof(struct block *));
+    live_queue = (struct block **) allocate(n * sizeof(struct block *));
+    live_region = (struct live_visit *) allocate(n * sizeof(struct live_visit));
+    nr_live_order = 0;
+
+    live_order1(entry_block);
+
+    for (block = first_block; block; block = block->next) 
+        if (!(block->bs & B_POST)) live_order1(block);
+}
+
+/* solve for IN and OUT: OUT is the union of the successors' INs, 
+   and IN = USE | (OUT & ~DEF). iterate until nothing changes. */
+
+static
+live_solve()
+{
+    struct block * block;
+    struct block * successor;
+    unsigned     * out;
+    unsigned       in;
+    int            changes;
+    int            i, n, w;
+
+    out = (unsigned *) allocate(nr_live_words * sizeof(unsigned));
 
     do {
         changes = 0;
 
-        for (block = first_block; block; block = block->next) {
-            for (n = 0; successor = block_successor(block, n); ++n) {
-                for (succ_defuse = successor->defuses; succ_defuse; succ_defuse = succ_defuse->link) {
-                    if (succ_defuse->dus & DU_IN) {
-                        defuse = find_defuse(block, succ_defuse->symbol->reg, FIND_DEFUSE_CREATE);
-                        distance = DU_TRANSIT(*defuse) ? (succ_defuse->distance + 1) : 0;
-
-                        if (!(defuse->dus & DU_OUT)) {
-                            changes++;
-                            defuse->dus |= DU_OUT;
-                            defuse->distance = distance;
-                        } 
-                        
-                        if (defuse->distance > distance) {
-                            defuse->distance = distance;
-                            changes++;
-                        }
-                    }
-                }
-            }
+        for (i = 0; i < nr_live_order; ++i) {
+            block = live_order[i];
+            for (w = 0; w < nr_live_words; ++w) out[w] = 0;
+
+            for (n = 0; successor = block_successor(block, n); ++n) 
+                for (w = 0; w < nr_live_words; ++w) 
+                    out[w] |= successor->live_in[w];
 
-            for (defuse = block->defuses; defuse; defuse = defuse->link) {
-                if (((defuse->dus & DU_OUT) && !(defuse->dus & DU_DEF)) || (defuse->dus & DU_USE)) {
-                    if (!(defuse->dus & DU_IN)) {
-                        defuse->dus |= DU_IN;
-                        changes++;
-                    }
+            for (w = 0; w < nr_live_words; ++w) {
+                in = block->live_use[w] | (out[w] & ~block->live_def[w]);
+
+                if ((in != block->live_in[w]) || (out[w] != block->live_out[w])) {
+                    block->live_in[w] = in;
+                    block->live_out[w] = out[w];
+                    changes++;
                 }
             }
         }
     } while (changes);
+
+    free(out);
+}
+
+/* point live_defuses[] at the def/use records in 'defuses', or clear them */
+
+static
+live_index(defuses, clear)
+    struct defuse * defuses;
+{
+    struct defuse * defuse;
+
+    for (defuse = defuses; defuse; defuse = defuse->link)
+        live_defuses[live_number(defuse->symbol->reg)] = clear ? NULL : defuse;
+}
+
+/* copy the IN and OUT sets back into the def/use records, 
+   creating records for the transit variables as needed. */
+
+static
+live_records(block)
+    struct block * block;
+{
+    struct defuse * defuse;
+    unsigned        bits;
+    int             w, i;
+
+    live_index(block->defuses, 0);
+
+    for (w = 0; w < nr_live_words; ++w) {
+        bits = block->live_in[w] | block->live_out[w];
+
+        for (i = w * 32; bits; bits >>= 1, ++i) {
+            if (!(bits & 1)) continue;
+            defuse = live_defuses[i];
+            if (defuse == NULL) defuse = live_defuses[i] = new_defuse(block, live_symbols[i]);
+            if (LIVE_TEST(block->live_in, i)) defuse->dus |= DU_IN;
+            if (LIVE_TEST(block->live_out, i)) defuse->dus |= DU_OUT;
+        }
+    }
+
+    live_index(block->defuses, 1);
+}
+
+/* compute the distances of the transit variables. a variable that's 
+   referenced in a block is at distance 0; a transit variable is one 
+   further than the nearest successor it's live into. 'live_near' holds
+   the variables whose distance is known (and the newly-found ones), so
+   each round finds the transit variables at the next distance out. */
+
+static
+live_distances()
+{
+    struct block * block;
+    struct block * successor;
+    unsigned     * near;
+    unsigned     * next;
+    unsigned       bits;
+    int            distance;
+    int            found;
+    int            n, w, i;
+
+    for (block = first_block; block; block = block->next) 
+        for (w = 0; w < nr_live_words; ++w) 
+            block->live_near[w] = block->live_use[w] | block->live_def[w];
+
+    for (distance = 1; ; ++distance) {
+        found = 0;
+
+        for (block = first_block; block; block = block->next) {
+            next = block->live_near + nr_live_words;
+            for (w = 0; w < nr_live_words; ++w) next[w] = 0;
+
+            for (n = 0; successor = block_successor(block, n); ++n) 
+                for (w = 0; w < nr_live_words; ++w) 
+                    next[w] |= successor->live_near[w] & successor->live_in[w];
+
+            for (w = 0; w < nr_live_words; ++w) {
+                next[w] &= block->live_out[w] & ~block->live_near[w];
+                if (next[w]) found++;
+            }
+        }
+
+        if (!found) break;
+
+        for (block = first_block; block; block = block->next) {
+            near = block->live_near;
+            next = near + nr_live_words;
+
+            for (w = 0; w < nr_live_words; ++w) 
+                if (next[w]) break;
+
+            if (w == nr_live_words) continue;
+            live_index(block->defuses, 0);
+
+            for (w = 0; w < nr_live_words; ++w) {
+                near[w] |= next[w];
+
+                for (bits = next[w], i = w * 32; bits; bits >>= 1, ++i) 
+                    if (bits & 1) live_defuses[i]->distance = distance;
+            }
+
+            live_index(block->defuses, 1);
+        }
+    }
+}
+
+/* compute global def/use data. this destroys any existing def/use data. */
+
+compute_global_defuses()
+{
+    struct block * block;
+
+    analyze_blocks();
+
+    for (block = first_block; block; block = block->next) 
+        compute_block_defuses(block);
+
+    live_numbers();
+    live_orders();
+    live_solve();
+
+    for (block = first_block; block; block = block->next) 
+        live_records(block);
+
+    live_distances();
+}
+
+/* the optimizers keep a worklist of blocks to (re)visit. a block is
+   put on the list when it's changed, or when its def/use data are. */
+
+static struct block * work_head;
+static struct block * work_tail;
+
+work_block(block)
+    struct block * block;
+{
+    if (!(block->bs & B_WORK)) {
+        block->bs |= B_WORK;
+        block->work_link = NULL;
+
+        if (work_tail)
+            work_tail->work_link = block;
+        else
+            work_head = block;
+
+        work_tail = block;
+    }
+}
+
+struct block *
+next_work()
+{
+    struct block * block;
+
+    if (block = work_head) {
+        work_head = block->work_link;
+        if (work_head == NULL) work_tail = NULL;
+        block->bs &= ~B_WORK;
+    }
+
+    return block;
+}
+
+/* remove the def/use entry for 'symbol' from 'block', if any */
+
+static
+remove_defuse(block, symbol)
+    struct block  * block;
+    struct symbol * symbol;
+{
+    struct defuse ** defusep;
+    struct defuse  * defuse;
+
+    if ((defuse = find_defuse_by_symbol(block, symbol)) == NULL) return 0;
+
+    defusep = &(block->defuse_buckets[DEFUSE_BUCKET(block, symbol->reg)]);
+    while (*defusep != defuse) defusep = &((*defusep)->hash_link);
+    *defusep = defuse->hash_link;
+
+    defusep = &(block->defuses);
+    while (*defusep != defuse) defusep = &((*defusep)->link);
+    *defusep = defuse->link;
+
+    pool_free(&defuse_pool, defuse);
+    block->nr_defuses--;
+}
+
+/* recompute the liveness (DU_IN, DU_OUT, and distance) of 'symbol' after
+   its local data, or its liveness, changed in 'origin'. that can only
+   affect the blocks which reach 'origin' through blocks that neither DEF
+   nor USE the symbol (and their predecessors, whose OUT may change): the
+   liveness of any other block is decided by paths that don't go through
+   'origin'. so those blocks, the region, are found by a walk backwards
+   from 'origin', and their IN and OUT are solved for again, taking the
+   blocks around the region as they are. then the distances of the transit
+   blocks in the region are relaxed until they settle. only the records
+   that differ are touched, and those blocks are put on the worklist. */
+
+#define LIVE_FAR    0x7FFFFFFF      /* a distance not yet known */
+
+static
+live_symbol(origin, symbol)
+    struct block  * origin;
+    struct symbol * symbol;
+{
+    struct block  * block;
+    struct block  * neighbor;
+    struct defuse * defuse;
+    int             nr_region = 0;
+    int             head = 0;
+    int             nr_queued = 0;
+    int             number;
+    unsigned        bit;
+    unsigned        in, out;
+    int             distance;
+    int             next;
+    int             dus;
+    int             i, n, w;
+
+    number = live_number(symbol->reg);
+    w = LIVE_WORD(number);
+    bit = LIVE_BIT(number);
+
+    /* find the region. the old state of each record is noted, and
+       its IN and OUT are cleared, to be solved for from scratch. */
+
+    origin->bs |= B_REGION;
+    live_region[nr_region++].block = origin;
+
+    for (i = 0; i < nr_region; ++i) {
+        block = live_region[i].block;
+        defuse = find_defuse_by_symbol(block, symbol);
+        live_region[i].dus = defuse ? (defuse->dus & (DU_IN | DU_OUT)) : 0;
+        live_region[i].distance = defuse ? defuse->distance : 0;
+        block->live_in[w] &= ~bit;
+        block->live_out[w] &= ~bit;
+
+        if ((block != origin) && ((block->live_use[w] | block->live_def[w]) & bit)) continue;
+
+        for (n = 0; neighbor = block_predecessor(block, n); ++n) {
+            if (neighbor->bs & B_REGION) continue;
+            neighbor->bs |= B_REGION;
+            live_region[nr_region++].block = neighbor;
+        }
+    }
+
+    /* solve for IN and OUT. a block's IN only ever goes from clear
+       to set, so its predecessors are requeued at most once. the queue
+       is circular; no block is on it twice, so it never overflows. */
+
+    for (i = 0; i < nr_region; ++i) {
+        live_region[i].block->bs |= B_QUEUED;
+        live_queue[nr_queued++] = live_region[i].block;
+    }
+
+    while (nr_queued) {
+        block = live_queue[head];
+        head = (head + 1) % nr_region;
+        --nr_queued;
+        block->bs &= ~B_QUEUED;
+
+        for (out = 0, n = 0; neighbor = block_successor(block, n); ++n)
+            out |= neighbor->live_in[w] & bit;
+
+        in = (block->live_use[w] & bit) | (out & ~block->live_def[w]);
+        block->live_out[w] |= out;
+        if (in == (block->live_in[w] & bit)) continue;
+        block->live_in[w] |= in;
+
+        for (n = 0; neighbor = block_predecessor(block, n); ++n) {
+            if (!(neighbor->bs & B_REGION) || (neighbor->bs & B_QUEUED)) continue;
+            neighbor->bs |= B_QUEUED;
+            live_queue[(head + nr_queued++) % nr_region] = neighbor;
+        }
+    }
+
+    /* give every block the symbol is now live in or out of a record.
+       the transit blocks start out LIVE_FAR, and are queued. */
+
+    for (i = 0; i < nr_region; ++i) {
+        block = live_region[i].block;
+        if (!((block->live_in[w] | block->live_out[w]) & bit)) continue;
+        defuse = find_defuse_by_symbol(block, symbol);
+        if (defuse == NULL) defuse = new_defuse(block, symbol);
+        defuse->distance = 0;
+
+        if (DU_TRANSIT(*defuse)) {
+            defuse->distance = LIVE_FAR;
+            block->bs |= B_QUEUED;
+            live_queue[(head + nr_queued++) % nr_region] = block;
+        }
+    }
+
+    /* relax the distances: a transit block is one further than the
+       nearest successor it's live into (which is at 0 if it refers
+       to the symbol). when one gets closer, so might its predecessors. */
+
+    while (nr_queued) {
+        block = live_queue[head];
+        head = (head + 1) % nr_region;
+        --nr_queued;
+        block->bs &= ~B_QUEUED;
+        defuse = find_defuse_by_symbol(block, symbol);
+        distance = LIVE_FAR;
+
+        for (n = 0; neighbor = block_successor(block, n); ++n) {
+            if (!(neighbor->live_in[w] & bit)) continue;
+
+            if ((neighbor->live_use[w] | neighbor->live_def[w]) & bit)
+                next = 0;
+            else
+                next = find_defuse_by_symbol(neighbor, symbol)->distance;
+
+            if (next < distance - 1) distance = next + 1;
+        }
+
+        if (distance >= defuse->distance) continue;
+        defuse->distance = distance;
+
+        for (n = 0; neighbor = block_predecessor(block, n); ++n) {
+            if (!(neighbor->bs & B_REGION) || (neighbor->bs & B_QUEUED)) continue;
+            if (!(neighbor->live_in[w] & bit) || ((neighbor->live_use[w] | neighbor->live_def[w]) & bit)) continue;
+            neighbor->bs |= B_QUEUED;
+            live_queue[(head + nr_queued++) % nr_region] = neighbor;
+        }
+    }
+
+    /* bring the records up to date, and compare them with the old */
+
+    for (i = 0; i < nr_region; ++i) {
+        block = live_region[i].block;
+        block->bs &= ~B_REGION;
+        dus = 0;
+        distance = 0;
+
+        if (block->live_in[w] & bit) dus |= DU_IN;
+        if (block->live_out[w] & bit) dus |= DU_OUT;
+        defuse = find_defuse_by_symbol(block, symbol);
+
+        if (defuse) {
+            defuse->dus = (defuse->dus & ~(DU_IN | DU_OUT)) | dus;
+            if (!DU_TRANSIT(*defuse)) defuse->distance = 0;
+            distance = defuse->distance;
+            if (defuse->dus == 0) remove_defuse(block, symbol);
+        }
+
+        if ((dus != live_region[i].dus) || (distance != live_region[i].distance))
+            work_block(block);
+    }
+}
+
+/* what should the DU_OUT status and distance of 'symbol' be in 
+   'block', based on the (up-to-date) data of its successors? */
+
+static
+live_out(block, symbol, local, distance)
+    struct block  * block;
+    struct symbol * symbol;
+    int           * distance;
+{
+    struct block  * successor;
+    struct defuse * succ_defuse;
+    int             out = 0;
+    int             n;
+
+    *distance = 0;
+
+    for (n = 0; successor = block_successor(block, n); ++n) {
+        succ_defuse = find_defuse_by_symbol(successor, symbol);
+        if ((succ_defuse == NULL) || !(succ_defuse->dus & DU_IN)) continue;
+
+        if (local == 0) {
+            if (!out || (*distance > (succ_defuse->distance + 1)))
+                *distance = succ_defuse->distance + 1;
+        }
+
+        out = DU_OUT;
+    }
+
+    return out;
+}
+
+/* update the def/use data after an optimizer has changed 'block' (its 
+   instructions, successors, or both). the local data are recomputed, and
+   any symbol whose local data or live-out status changed has its liveness
+   recomputed. the liveness of all other symbols carries over unchanged.
+
+   if the block now refers to a symbol that wasn't numbered when the data
+   were last computed globally, we just recompute everything globally. */
+
+update_defuses(block)
+    struct block * block;
+{
+    struct defuse * old_defuses;
+    struct defuse * old;
+    struct defuse * defuse;
+    struct block  * successor;
+    unsigned      * changed;
+    unsigned      * in;
+    unsigned      * out;
+    unsigned        bits;
+    int             distance;
+    int             i, n, w;
+
+    old_defuses = block->defuses;
+    block->defuses = NULL;
+    analyze_block(block);
+    compute_block_defuses(block);
+
+    for (defuse = block->defuses; defuse; defuse = defuse->link) 
+        if (live_number(defuse->symbol->reg) == -1) break;
+
+    if (defuse || (block->live_use == NULL)) {
+        while (old = old_defuses) {
+            old_defuses = old->link;
+            pool_free(&defuse_pool, old);
+        }
+
+        compute_global_defuses();
+        for (block = first_block; block; block = block->next) work_block(block);
+        return 0;
+    }
+
+    /* recompute the USE and DEF sets of the block, and from those
+       (and the successors) its new IN and OUT sets in 'live_near'. */
+
+    for (w = 0; w < nr_live_words; ++w) {
+        block->live_use[w] = 0;
+        block->live_def[w] = 0;
+    }
+
+    for (defuse = block->defuses; defuse; defuse = defuse->link) {
+        i = live_number(defuse->symbol->reg);
+        if (defuse->dus & DU_USE) block->live_use[LIVE_WORD(i)] |= LIVE_BIT(i);
+        if (defuse->dus & DU_DEF) block->live_def[LIVE_WORD(i)] |= LIVE_BIT(i);
+    }
+
+    in = block->live_near;
+    out = block->live_near + nr_live_words;
+    for (w = 0; w < nr_live_words; ++w) out[w] = 0;
+
+    for (n = 0; successor = block_successor(block, n); ++n) 
+        for (w = 0; w < nr_live_words; ++w) 
+            out[w] |= successor->live_in[w];
+
+    for (w = 0; w < nr_live_words; ++w) 
+        in[w] = block->live_use[w] | (out[w] & ~block->live_def[w]);
+
+    /* the predecessors only see our IN set and the distances of our 
+       transit variables. if neither changes for a symbol, its liveness
+       elsewhere is unaffected, and only our records need fixing. the 
+       others (in 'changed') are recomputed from scratch. */
+
+    changed = (unsigned *) allocate(nr_live_words * sizeof(unsigned));
+    for (w = 0; w < nr_live_words; ++w) changed[w] = in[w] ^ block->live_in[w];
+
+    live_index(old_defuses, 0);
+
+    for (w = 0; w < nr_live_words; ++w) {
+        for (bits = out[w] & ~changed[w], i = w * 32; bits; bits >>= 1, ++i) {
+            if (!(bits & 1)) continue;
+            old = live_defuses[i];
+            distance = 0;
+
+            if (!LIVE_TEST(block->live_use, i) && !LIVE_TEST(block->live_def, i))
+                live_out(block, live_symbols[i], 0, &distance);
+
+            if (distance != (old ? old->distance : 0)) changed[w] |= LIVE_BIT(i);
+        }
+    }
+
+    live_index(old_defuses, 1);
+    live_index(block->defuses, 0);
+
+    for (w = 0; w < nr_live_words; ++w) {
+        block->live_in[w] = in[w] & ~changed[w];
+        block->live_out[w] = out[w] & ~changed[w];
+
+        for (bits = block->live_in[w] | block->live_out[w], i = w * 32; bits; bits >>= 1, ++i) {
+            if (!(bits & 1)) continue;
+            defuse = live_defuses[i];
+            if (defuse == NULL) defuse = live_defuses[i] = new_defuse(block, live_symbols[i]);
+            if (LIVE_TEST(block->live_in, i)) defuse->dus |= DU_IN;
+
+            if (LIVE_TEST(block->live_out, i)) {
+                defuse->dus |= DU_OUT;
+                if (DU_TRANSIT(*defuse)) live_out(block, live_symbols[i], 0, &(defuse->distance));
+            }
+        }
+    }
+
+    live_index(block->defuses, 1);
+
+    while (old = old_defuses) {
+        old_defuses = old->link;
+        pool_free(&defuse_pool, old);
+    }
+
+    for (w = 0; w < nr_live_words; ++w) 
+        for (bits = changed[w], i = w * 32; bits; bits >>= 1, ++i) 
+            if (bits & 1) live_symbol(block, live_symbols[i]);
+
+    free(changed);
 }
 
 /* is 'reg' dead after 'insn' in 'block'?
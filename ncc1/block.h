@@ -25,6 +25,11 @@
 #define B_SEQ           0x00000001          /* sequenced */
 #define B_REG           0x00000002          /* registers allocated */
 #define B_RECON         0x00000004          /* reconciliation block */
+#define B_WORK          0x00000008          /* on the worklist */
+#define B_POST          0x00000010          /* visited by live_order1() */
+#define B_LOOP          0x00000020          /* in loop being optimized [loop.c] */
+#define B_REGION        0x00000040          /* visited by live_symbol() */
+#define B_QUEUED        0x00000080          /* on live_symbol()'s queue */
 
 struct block
 {
@@ -41,6 +46,22 @@ struct block
     int                 nr_successors;
     int                 nr_predecessors;
     struct defuse     * defuses;
+    struct defuse    ** defuse_buckets; /* 'defuses' hashed by register */
+    int                 nr_defuse_buckets;
+    int                 nr_defuses;
+    struct block      * work_link;      /* see work_block() */
+    struct symbol     * jump_table;     /* see successor rules below */
+    int                 dfn;            /* numbering for loop.c, prop.c */
+
+    /* live variable bitsets, indexed by the compact numbers that
+       compute_global_defuses() gives the symbols in the def/use data.
+       they're all carved out of one allocation, owned by 'live_use'. */
+
+    unsigned          * live_use;       /* USEd before DEFd in block */
+    unsigned          * live_def;       /* DEFd before USEd in block */
+    unsigned          * live_in;
+    unsigned          * live_out;
+    unsigned          * live_near;      /* scratch (two sets) for distances */
     struct symbol     * iregs[NR_REGS];
     struct symbol     * fregs[NR_REGS];
 
@@ -53,6 +74,15 @@ struct block
     int                 prohibit_fregs;
     int                 temponly_iregs;  
     int                 temponly_fregs;
+
+    /* the global allocator (-O2) tracks the liveness of the real registers
+       itself, as bitmasks: integral registers in the low 16 bits and float
+       registers in the high 16 bits (see REAL_BIT() in reg.c). */
+
+    int                 reals_used;     /* USEd before DEFd in block */
+    int                 reals_defd;
+    int                 reals_in;
+    int                 reals_out;
 };
 
 /* for successors, 'cc' is the branch condition that leads to
@@ -62,7 +92,9 @@ struct block
 
    0 successors: only the exit_block has no successors.
    1 successor: 'cc' for the one successor is ALWAYS.
-   2 successors: the 'cc's are opposite conditions. */
+   2 successors: the 'cc's are opposite conditions.
+   more: the block ends in an indirect jump through its 'jump_table',
+   and the 'cc' of each successor is CC_TABLE(i), for table entry i. */
 
 struct block_list
 {
@@ -101,16 +133,20 @@ struct block_list
 
 #define CC_NONE         12
 
+#define CC_TABLE(i)     (CC_NONE + 1 + (i))
+#define CC_TABLE_IDX(x) ((x) - (CC_NONE + 1))
+#define CC_IS_TABLE(x)  ((x) > CC_NONE)
+
 /* def/use, live variable information tracking and other sundries. */
 
 struct defuse
 {
     struct symbol * symbol;        
     struct defuse * link;
+    struct defuse * hash_link;  /* in block's 'defuse_buckets' */
     int             dus;        /* DU_* */
     int             reg;
     int             cache;      /* DU_CACHE */
-    int             con;        /* if DU_CON; see con_prop() [opt.c] */
             
     /* first_n and last_n give the insn indexes (insn->n) of the first
        and last appearances of the symbol in the block.  if the symbol 
@@ -129,7 +165,6 @@ struct defuse
 #define DU_OUT          0x00000002      
 #define DU_DEF          0x00000004      /* def or use */
 #define DU_USE          0x00000008
-#define DU_CON          0x00000010      /* for const_prop() [opt.c] */
 
     /* the register allocator uses these fields to track the coherency
        between the ->reg and memory, for aliased (i.e., non S_REGISTER) */
@@ -152,7 +187,12 @@ struct defuse
    expression trees, but limited to E_REG, E_MEM, E_IMM, E_CON. */
 
 #define NR_INSN_OPERANDS    3
-#define NR_INSN_REGS        (NR_INSN_OPERANDS * 2)  /* maximum # of registers referenced in one insn */
+
+/* maximum # of registers referenced in one insn. the worst case is an
+   I_CALL under -mregparm, which USEs all the argument registers as well 
+   as the registers in its operand, and DEFs all the scratch registers. */
+
+#define NR_INSN_REGS        (NR_IARG_REGS + NR_FARG_REGS + 2)
 
 #define INSN_FLAG_CC    0x00000001  /* condition codes from this insn used */
 
@@ -167,6 +207,12 @@ struct insn
     int           opcode; /* I_* */
     struct tree * operand[NR_INSN_OPERANDS];
 
+    /* for I_CALL only, the number of integral and floating-point
+       arguments passed in registers (see -mregparm) */
+
+    char          nr_iargs;
+    char          nr_fargs;
+
     /* these fields aren't valid until we begin analyis
        before optimization and register allocation */
 
@@ -255,16 +301,20 @@ struct insn
 #define I_DIVSD     (  37 | I_2_OPERANDS | I_DEF(0) | I_USE(0) | I_USE(1) )
 #define I_CBW       (  38 | I_0_OPERANDS | I_USE_AX | I_DEF_AX )
 #define I_CWD       (  39 | I_0_OPERANDS | I_USE_AX | I_DEF_AX | I_DEF_DX )
-#define I_SETZ      (  40 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETNZ     (  41 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETG      (  42 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETLE     (  43 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETGE     (  44 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETL      (  45 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETA      (  46 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETBE     (  47 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETAE     (  48 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
-#define I_SETB      (  49 | I_1_OPERANDS | I_DEF(0) | I_USE_CC )
+
+    /* SETcc only writes the low byte of its register, whose upper bytes
+       the code generator has already cleared, so the register is USEd too */
+
+#define I_SETZ      (  40 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETNZ     (  41 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETG      (  42 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETLE     (  43 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETGE     (  44 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETL      (  45 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETA      (  46 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETBE     (  47 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETAE     (  48 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
+#define I_SETB      (  49 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_USE_CC )
 #define I_NOT       (  50 | I_1_OPERANDS | I_DEF(0) | I_USE(0) )
 #define I_NEG       (  51 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_DEF_CC )
 #define I_PUSH      (  52 | I_1_OPERANDS | I_USE(0) )
@@ -274,3 +324,4 @@ struct insn
 #define I_RET       (  56 | I_0_OPERANDS )
 #define I_INC       (  57 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_DEF_CC )
 #define I_DEC       (  58 | I_1_OPERANDS | I_DEF(0) | I_USE(0) | I_DEF_CC )
+#define I_JMP       (  59 | I_1_OPERANDS | I_USE(0) )
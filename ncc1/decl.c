@@ -351,6 +351,7 @@ declarations(declare, flags, data)
 {
     struct type *   base;
     struct type *   type;
+    struct type *   field;
     int             ss;
     struct string * id;
     struct symbol * args;
@@ -387,8 +388,10 @@ declarations(declare, flags, data)
                     bits = constant_expression();
                     if ((bits < 0) || (bits > (size_of(type) * BITS))) error(ERROR_FIELDSZ);
                     if ((bits == 0) && id) error(ERROR_FIELDSZ);
-                    type->ts |= T_FIELD;
-                    T_SET_SIZE(type->ts, bits);
+                    field = new_type(type->ts | T_FIELD);
+                    T_SET_SIZE(field->ts, bits);
+                    free_type(type);
+                    type = field;
                 }
 
                 validate_type(type);
@@ -475,11 +478,20 @@ function_definition(symbol, args)
     struct symbol * symbol;
     struct symbol * args;
 {
+    int nr_iargs = 0;
+    int nr_fargs = 0;
+    int reg;
+
     if (symbol->ss & S_DEFINED) error(ERROR_DUPDEF);
 
     current_function = symbol;
     frame_offset = FRAME_ARGUMENTS;
     declarations(declare_argument, 0, args);
+    setup_blocks();
+
+    /* under -mregparm, the leading arguments arrive in registers. they're 
+       treated like locals (so given a frame slot only if their addresses 
+       are taken) and assigned from the argument registers on entry. */
 
     for (symbol = args; symbol; symbol = symbol->list) {
         if (symbol->type == NULL) {
@@ -487,13 +499,29 @@ function_definition(symbol, args)
             symbol->ss = S_LOCAL;
         }
 
-        symbol->i = frame_offset;
-        frame_offset += size_of(symbol->type);
-        frame_offset = ROUND_UP(frame_offset, FRAME_ALIGN);
+        reg = R_NONE;
+
+        if (regparm_flag) {
+            if (symbol->type->ts & T_IS_FLOAT) {
+                if (nr_fargs < NR_FARG_REGS) reg = R_XMM0 + nr_fargs++;
+            } else {
+                if (nr_iargs < NR_IARG_REGS) reg = iarg_regs[nr_iargs++];
+            }
+        }
+
+        if (reg != R_NONE) {
+            symbol->i = 0;
+            choose(E_ASSIGN, reg_tree(symbol_reg(symbol), copy_type(symbol->type)),
+                             reg_tree(reg, copy_type(symbol->type)));
+        } else {
+            symbol->i = frame_offset;
+            frame_offset += size_of(symbol->type);
+            frame_offset = ROUND_UP(frame_offset, FRAME_ALIGN);
+        }
     }
 
     frame_offset = 0;
-    setup_blocks();
+    type_puns = 0;
     compound();         /* will enter_scope() to capture the arguments */
     optimize();
     output_function();
@@ -522,8 +550,7 @@ declare_global(ss, id, type, args)
 
     if (symbol) {
         if (symbol->ss & effective_ss & (S_EXTERN | S_STATIC)) {
-            check_types(symbol->type, type, CHECK_TYPES_COMPOSE);
-            free_type(type);
+            symbol->type = compose_types(symbol->type, type);
         } else
             error(ERROR_REDECL);
     } else {
@@ -444,7 +444,7 @@ extract_field(tree)
 
     if ((tree->op != E_MEM) || !(tree->type->ts & T_FIELD)) error(ERROR_INTERNAL);
 
-    tree->type->ts &= T_BASE;
+    tree->type = field_storage(tree->type);
     temp = temporary(copy_type(tree->type));
     temp_bits = size_of(temp->type) * BITS;
 
@@ -493,7 +493,7 @@ insert_field(tree, value, goal, cc)
     } 
 
     original_tree = copy_tree(tree);
-    tree->type->ts &= T_BASE;
+    tree->type = field_storage(tree->type);
     choose(E_AND, copy_tree(tree), int_tree(tree->type->ts, target_mask));
     choose(E_OR, tree, copy_tree(source));
 
@@ -699,18 +699,59 @@ generate_call(tree, goal, cc)       /* E_CALL */
     struct tree * arguments;
     struct tree * argument;
     struct type * type;
+    struct tree * regs[NR_IARG_REGS + NR_FARG_REGS];
+    struct insn * insn;
+    int           nr_iargs = 0;
+    int           nr_fargs = 0;
     int           reg;
+    int           i;
     int           stack_adjust = 0;
 
     decap_tree(tree, &type, &function, &arguments, NULL);
     function = generate(function, GOAL_VALUE, NULL);
 
+    /* under -mregparm, the leading arguments are passed in registers. the 
+       arguments are evaluated last-to-first, so we count them in advance to
+       know which are which. each such argument is evaluated into a temporary
+       and only moved into its register just before the call, since evaluating
+       the others might otherwise clobber it. */
+
+    if (regparm_flag) {
+        for (argument = arguments; argument; argument = argument->list) {
+            if (argument->type->ts & T_IS_FLOAT)
+                ++nr_fargs;
+            else
+                ++nr_iargs;
+        }
+
+        for (i = 0; i < NR_IARG_REGS + NR_FARG_REGS; i++) regs[i] = NULL;
+    }
+
     /* this could use some optimization, especially w/r/t float arguments */
 
     while (argument = arguments)
     {
         arguments = argument->list;
         argument->list = NULL;
+
+        if (regparm_flag) {
+            if (argument->type->ts & T_IS_FLOAT)
+                i = (--nr_fargs < NR_FARG_REGS) ? (NR_IARG_REGS + nr_fargs) : -1;
+            else
+                i = (--nr_iargs < NR_IARG_REGS) ? nr_iargs : -1;
+
+            if (i != -1) {
+                argument = generate(argument, GOAL_VALUE, 0);
+                if ((argument->op != E_CON) && (argument->op != E_IMM)) {
+                    tree = temporary(copy_type(argument->type));
+                    choose(E_ASSIGN, copy_tree(tree), argument);
+                    argument = tree;
+                }
+                regs[i] = argument;
+                continue;
+            }
+        }
+
         argument = generate(argument, GOAL_VALUE, 0);
         argument = operand(argument);
 
@@ -738,6 +779,22 @@ generate_call(tree, goal, cc)       /* E_CALL */
         stack_adjust += FRAME_ALIGN;
     }
 
+    if (regparm_flag) {
+        for (i = 0; i < NR_IARG_REGS + NR_FARG_REGS; i++) {
+            if (regs[i] == NULL) continue;
+
+            if (i < NR_IARG_REGS) {
+                reg = iarg_regs[i];
+                nr_iargs = i + 1;
+            } else {
+                reg = R_XMM0 + (i - NR_IARG_REGS);
+                nr_fargs = (i - NR_IARG_REGS) + 1;
+            }
+
+            choose(E_ASSIGN, reg_tree(reg, copy_type(regs[i]->type)), regs[i]);
+        }
+    }
+
     /* I_CALL is implicitly REL, so an E_IMM must be REL and we strip it. */
 
     if (function->op == E_IMM) {
@@ -746,7 +803,10 @@ generate_call(tree, goal, cc)       /* E_CALL */
         normalize(function);
     }
 
-    emit(new_insn(I_CALL, operand(function)));
+    insn = new_insn(I_CALL, operand(function));
+    insn->nr_iargs = nr_iargs;
+    insn->nr_fargs = nr_fargs;
+    emit(insn);
     if (stack_adjust) emit(new_insn(I_ADD, reg_tree(R_SP, new_type(T_LONG)), int_tree(T_LONG, (long) stack_adjust)));
 
     if (goal == GOAL_EFFECT) {
@@ -1042,16 +1102,19 @@ generate_fetch(tree, goal, cc, lvalue)      /* E_FETCH */
     struct tree * tree;
     int *         cc;
 {
-    struct type * type;
-    struct tree * temp;
+    struct type   * type;
+    struct tree   * temp;
+    struct symbol * tag;
 
     decap_tree(tree, &type, &tree, NULL, NULL);
 
     if (goal == GOAL_EFFECT) {
         free_type(type);
         return generate(tree, goal, cc);
-    } else
+    } else {
+        tag = access_tag(tree);
         tree = generate(tree, GOAL_VALUE, cc);
+    }
 
     switch (tree->op)
     {
@@ -1077,6 +1140,8 @@ generate_fetch(tree, goal, cc, lvalue)      /* E_FETCH */
     default: error(ERROR_INTERNAL);
     }
 
+    tree->u.mi.tag = tag;
+
     if ((tree->op == E_MEM) && (tree->type->ts & T_FIELD) && !lvalue)
         tree = extract_field(tree);
 
@@ -36,7 +36,7 @@ float_literal(tree)
     symbol = new_symbol(NULL, S_STATIC, copy_type(tree->type));
     symbol->i = next_asm_label++;
     put_symbol(symbol, SCOPE_RETIRED);
-    segment(SEGMENT_TEXT);
+    section(SEGMENT_TEXT);
     output("%G: %s %O\n", symbol, (tree->type->ts & T_LFLOAT) ? ".qword" : ".dword", tree);
     free_tree(tree);
     return memory_tree(symbol);
@@ -110,12 +110,17 @@ initialize_scalar(type)
     free_tree(tree);
 }
 
+/* an array with no explicit bound takes its bound from the initializer.
+   the type is interned, so it isn't touched here; the bound is returned
+   and the caller gives the symbol its new type. */
+
 static
 initialize_array(type)
     struct type * type;
 {
     struct type * element_type;
     int           nr_elements = 0;
+    int           bound;
 
     element_type = type->next;
 
@@ -139,11 +144,13 @@ initialize_array(type)
         match(KK_RBRACE);
     }
 
-    if (type->nr_elements == 0) type->nr_elements = nr_elements;
-    if ((type->nr_elements == 0) || (nr_elements > type->nr_elements)) error(ERROR_BADINIT);
+    bound = type->nr_elements ? type->nr_elements : nr_elements;
+    if ((bound == 0) || (nr_elements > bound)) error(ERROR_BADINIT);
+
+    if (nr_elements < bound) 
+        output(" .fill %d,0\n", (bound - nr_elements) * size_of(element_type));
 
-    if (nr_elements < type->nr_elements) 
-        output(" .fill %d,0\n", (type->nr_elements - nr_elements) * size_of(element_type));
+    return bound;
 }
 
 static 
@@ -186,6 +193,8 @@ initialize_struct(type)
     if (adjust_bits / BITS) output(" .fill %d,0\n", adjust_bits / 8);
 }
 
+/* returns the bound of the array, if 'type' is an array. */
+
 static
 initialize(type)
     struct type * type;
@@ -193,11 +202,13 @@ initialize(type)
     if (type->ts & T_IS_SCALAR)
         initialize_scalar(type);
     else if (type->ts & T_ARRAY)
-        initialize_array(type);
+        return initialize_array(type);
     else if (type->ts & T_TAG)
         initialize_struct(type);
     else
         error(ERROR_INTERNAL);
+
+    return 0;
 }
 
 /* just declared the 'symbol' with the explicit storage class 'ss'.
@@ -210,6 +221,7 @@ initializer(symbol, ss)
 {
     struct tree *  tree;
     struct block * saved_block;
+    int            bound;
 
     if (symbol->ss & S_BLOCK) size_of(symbol->type);
 
@@ -224,10 +236,12 @@ initializer(symbol, ss)
             saved_block = current_block;    /* don't allow code generation */
             current_block = NULL;
 
-            segment(SEGMENT_DATA);
+            section(SEGMENT_DATA);
             output(".align %d\n", align_of(symbol->type));
             output("%G:", symbol);
-            initialize(symbol->type);
+            bound = initialize(symbol->type);
+            if ((symbol->type->ts & T_ARRAY) && (symbol->type->nr_elements == 0))
+                symbol->type = bound_type(symbol->type, bound);
             symbol->ss |= S_DEFINED;
             current_block = saved_block;
         } else
@@ -28,9 +28,30 @@
 #include <ctype.h>
 #include "ncc1.h"
 
+/* the input is read into memory in its entirety by yyinit(), and
+   is followed by a NUL sentinel, so the scanner can look ahead at 
+   *yyp without checking for the end (NUL belongs to no class). */
+
+#define YY_SLURP 65536      /* initial input buffer size */
+
+static char * yyinput;      /* the input */
+static char * yyp;          /* next character in input */
+static char * yyend;        /* end of input */
 static int    yych;         /* current input character */
 
-#define yynext() (yych = getc(yyin))
+#define yynext() (yych = (yyp < yyend) ? (*yyp++ & 0xFF) : -1)
+
+/* characters are classified by table, rather than through <ctype.h>.
+   the table is offset by one so EOF (-1) is a valid index. */
+
+#define YY_SPACE    0x01    /* whitespace, other than newline */
+#define YY_ALPHA    0x02    /* letters and underscore */
+#define YY_DIGIT    0x04    /* decimal digits */
+#define YY_XDIGIT   0x08    /* hexadecimal digits */
+
+static char yyclasses[UCHAR_MAX + 2];
+
+#define yyclass (yyclasses + 1)
 
 /* we maintain a dynamically-growing token buffer for
    those token classes with interesting text. */
@@ -180,6 +201,36 @@ static char * keyword[] =
 
 #define NR_KEYWORDS (sizeof(keyword)/sizeof(*keyword))
 
+static
+yyslurp()
+{
+    char * new_yyinput;
+    int    cap = 0;
+    int    len = 0;
+    int    n;
+
+    do {
+        if (len == cap) {
+            new_yyinput = allocate((cap ? (cap * 2) : YY_SLURP) + 1);
+            if (yyinput) {
+                memcpy(new_yyinput, yyinput, len);
+                free(yyinput);
+            }
+            yyinput = new_yyinput;
+            cap = cap ? (cap * 2) : YY_SLURP;
+        }
+
+        n = fread(yyinput + len, 1, cap - len, yyin);
+        len += n;
+    } while (n > 0);
+
+    if (ferror(yyin)) error(ERROR_INPUT);
+
+    yyinput[len] = 0;
+    yyp = yyinput;
+    yyend = yyinput + len;
+}
+
 yyinit()
 {
     struct string * k;
@@ -190,6 +241,14 @@ yyinit()
         k->token = KK_AUTO + i;
     }
 
+    for (i = 0; i <= UCHAR_MAX; ++i) {
+        if (isspace(i) && (i != '\n')) yyclass[i] |= YY_SPACE;
+        if (isalpha(i) || (i == '_')) yyclass[i] |= YY_ALPHA;
+        if (isdigit(i)) yyclass[i] |= YY_DIGIT;
+        if (isxdigit(i)) yyclass[i] |= YY_XDIGIT;
+    }
+
+    yyslurp();
     yynext();
 }
 
@@ -230,8 +289,10 @@ yylex()
 {
     int             delim;
     int             backslash;
+    char          * start;
+    unsigned        hash;
 
-    while (isspace(yych) && (yych != '\n'))
+    while (yyclass[yych] & YY_SPACE)
         yynext();
 
     yylen = 0;
@@ -372,9 +433,9 @@ yylex()
     case '.':
         yynext();
 
-        if (isdigit(yych)) {
+        if (yyclass[yych] & YY_DIGIT) {
             /* whoops, it's a float */
-            ungetc(yych, yyin);
+            --yyp;
             yych = '.';
             break;
         }
@@ -440,21 +501,26 @@ yylex()
     default: /* fall through */ ;
     }
 
-    /* identifiers/keywords */
+    /* identifiers/keywords are taken directly from the input,
+       and hashed as they're scanned. */
 
-    if (isalpha(yych) || (yych == '_')) {
-        while (isalnum(yych) || (yych == '_')) {
-            yystash(yych);
-            yynext();
+    if (yyclass[yych] & YY_ALPHA) {
+        start = yyp - 1;
+        hash = STRING_HASH(STRING_HASH_INIT, yych);
+
+        while (yyclass[*yyp & 0xFF] & (YY_ALPHA | YY_DIGIT)) {
+            hash = STRING_HASH(hash, *yyp);
+            yyp++;
         }
 
-        token.u.text = stringize(yytext, yylen);
+        token.u.text = hashed_string(start, yyp - start, hash);
+        yynext();
         return token.u.text->token;
     }
 
     /* numbers */
 
-    if (isdigit(yych) || (yych == '.')) {
+    if ((yyclass[yych] & YY_DIGIT) || (yych == '.')) {
         if (yych == '0') {
             yystash(yych);
             yynext();
@@ -463,7 +529,7 @@ yylex()
                 yystash(yych);
                 yynext();
 
-                while (isxdigit(yych)) {
+                while (yyclass[yych] & YY_XDIGIT) {
                     yystash(yych);
                     yynext();
                 }
@@ -472,7 +538,7 @@ yylex()
             }
         }
 
-        while (isdigit(yych)) {
+        while (yyclass[yych] & YY_DIGIT) {
             yystash(yych);
             yynext();
         }
@@ -482,7 +548,7 @@ yylex()
                 yystash(yych);
                 yynext();
 
-                while (isdigit(yych)) {
+                while (yyclass[yych] & YY_DIGIT) {
                     yystash(yych);
                     yynext();
                 }
@@ -501,7 +567,7 @@ yylex()
                     yynext();
                 }
 
-                while (isdigit(yych)) {
+                while (yyclass[yych] & YY_DIGIT) {
                     yystash(yych);
                     yynext();
                 }
@@ -0,0 +1,827 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org). 
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#include <stdlib.h>
+#include "ncc1.h"
+
+/* loop optimizations. natural loops are found from the dominator tree
+   (a back edge is one whose target dominates its source), and each gets
+   a preheader: a block which is the only entry into the loop header from
+   outside the loop. then, innermost loops first,
+
+   1. invariant computations are hoisted into the preheader, and
+   2. multiplications of induction variables by constants (mostly from
+      scale_pointers()) are reduced to additions.
+
+   loop_opt() is run once the local optimizations have settled. it changes
+   the flow graph and invalidates the def/use data as it goes, relying
+   only on the liveness at the loop headers, which it doesn't disturb. */
+
+#define DFN_NONE        -1      /* unreachable */
+#define DFN_NEW         -2      /* created after numbering (or in progress) */
+
+struct loop
+{
+    struct block * header;
+    int            size;        /* blocks in body, when discovered */
+};
+
+static struct block ** post;        /* reachable blocks in postorder */
+static int             nr_post;
+static int           * idoms;       /* postorder # -> postorder # of idom */
+static struct loop   * loops;
+static int             nr_loops;
+static struct block ** body;        /* blocks in the current loop */
+static int             nr_body;
+static int             preheaders;  /* number of preheaders created */
+static int             loop_writes; /* non-zero if loop writes to memory */
+
+/* per-pseudo data for the current loop, indexed by slot(). the integral
+   pseudos come first, then the floats. pseudos created by this pass have
+   no slots, and are left alone. */
+
+static int             nr_islots;
+static int             nr_fslots;
+static int             nr_slots;
+static int           * nr_defs;     /* # of DEFs in the loop */
+static struct insn  ** def_insns;   /* (the last) DEFing insn ... */
+static struct block ** def_blocks;  /* ... and the block it's in */
+static char          * unaliased;   /* 0 = unknown, 1 = S_REGISTER, 2 = not */
+
+static
+slot(reg)
+{
+    int i;
+
+    if (!R_IS_PSEUDO(reg)) return -1;
+    i = R_IDX(reg) - NR_REGS;
+
+    if (reg & R_IS_FLOAT) {
+        if (i >= nr_fslots) return -1;
+        return nr_islots + i;
+    } else {
+        if (i >= nr_islots) return -1;
+        return i;
+    }
+}
+
+/* number the reachable blocks in postorder */
+
+static
+number1(block)
+    struct block * block;
+{
+    struct block * successor;
+    int            n;
+
+    block->dfn = DFN_NEW;
+
+    for (n = 0; successor = block_successor(block, n); ++n)
+        if (successor->dfn == DFN_NONE) number1(successor);
+
+    block->dfn = nr_post;
+    post[nr_post++] = block;
+}
+
+/* find the immediate dominators, by the method of Cooper, Harvey and
+   Kennedy: iterate in reverse postorder, intersecting the dominators of
+   the predecessors processed so far, until nothing changes. */
+
+static
+intersect(a, b)
+{
+    while (a != b) {
+        while (a < b) a = idoms[a];
+        while (b < a) b = idoms[b];
+    }
+
+    return a;
+}
+
+static
+dominators()
+{
+    struct block * block;
+    struct block * predecessor;
+    int            changes;
+    int            idom;
+    int            i, n;
+
+    for (i = 0; i < nr_post; ++i) idoms[i] = -1;
+    idoms[entry_block->dfn] = entry_block->dfn;
+
+    do {
+        changes = 0;
+
+        for (i = nr_post - 1; i >= 0; --i) {
+            block = post[i];
+            if (block == entry_block) continue;
+            idom = -1;
+
+            for (n = 0; predecessor = block_predecessor(block, n); ++n) {
+                if (predecessor->dfn < 0) continue;
+                if (idoms[predecessor->dfn] == -1) continue;
+
+                if (idom == -1)
+                    idom = predecessor->dfn;
+                else
+                    idom = intersect(predecessor->dfn, idom);
+            }
+
+            if (idoms[i] != idom) {
+                idoms[i] = idom;
+                ++changes;
+            }
+        }
+    } while (changes);
+}
+
+/* does block 'a' dominate block 'b'? both must be numbered. */
+
+static
+dominates(a, b)
+    struct block * a;
+    struct block * b;
+{
+    int i;
+
+    for (i = b->dfn; i != a->dfn; i = idoms[i])
+        if (i == entry_block->dfn) return 0;
+
+    return 1;
+}
+
+/* collect the body of the loop headed by 'header' in body[], and mark
+   its blocks B_LOOP. the latches are the predecessors of the header that
+   it dominates; the body is everything that reaches a latch backwards
+   without passing through the header. */
+
+static
+find_body(header)
+    struct block * header;
+{
+    struct block * block;
+    struct block * predecessor;
+    int            i, n;
+
+    header->bs |= B_LOOP;
+    body[0] = header;
+    nr_body = 1;
+
+    for (n = 0; predecessor = block_predecessor(header, n); ++n) {
+        if (predecessor->dfn < 0) continue;
+        if (predecessor->bs & B_LOOP) continue;
+        if (!dominates(header, predecessor)) continue;
+        predecessor->bs |= B_LOOP;
+        body[nr_body++] = predecessor;
+    }
+
+    for (i = 1; i < nr_body; ++i) {
+        block = body[i];
+
+        for (n = 0; predecessor = block_predecessor(block, n); ++n) {
+            if (predecessor->dfn == DFN_NONE) continue;
+            if (predecessor->bs & B_LOOP) continue;
+            predecessor->bs |= B_LOOP;
+            body[nr_body++] = predecessor;
+        }
+    }
+}
+
+static
+clear_body()
+{
+    int i;
+
+    for (i = 0; i < nr_body; ++i) body[i]->bs &= ~B_LOOP;
+}
+
+/* find the natural loops, and sort them innermost first. an inner loop
+   is always smaller than the loop that encloses it, so sort by size. */
+
+static
+compare_loops(loop1, loop2)
+    struct loop * loop1;
+    struct loop * loop2;
+{
+    return loop1->size - loop2->size;
+}
+
+static
+find_loops()
+{
+    struct block * block;
+    struct block * successor;
+    char         * headers;
+    int            i, n;
+
+    headers = allocate(nr_post);
+    for (i = 0; i < nr_post; ++i) headers[i] = 0;
+
+    for (i = 0; i < nr_post; ++i) {
+        block = post[i];
+
+        for (n = 0; successor = block_successor(block, n); ++n) {
+            if (successor->dfn < 0) continue;
+            if (!dominates(successor, block)) continue;
+            headers[successor->dfn] = 1;
+        }
+    }
+
+    nr_loops = 0;
+
+    for (i = 0; i < nr_post; ++i) {
+        if (!headers[i]) continue;
+        find_body(post[i]);
+        loops[nr_loops].header = post[i];
+        loops[nr_loops].size = nr_body;
+        ++nr_loops;
+        clear_body();
+    }
+
+    free(headers);
+    qsort(loops, nr_loops, sizeof(struct loop), compare_loops);
+}
+
+/* give the loop (whose body is marked) a preheader, and return it. if
+   the header has only one predecessor outside the loop, and it has no
+   other successors, it serves. (except the entry block: the prologue
+   is appended to it, and must come first.) otherwise, a new block is
+   inserted, and all the outside edges into the header redirected to it. */
+
+static struct block *
+make_preheader(header)
+    struct block * header;
+{
+    struct block * preheader;
+    struct block * predecessor;
+    struct block * successor;
+    int            nr_outside = 0;
+    int            level = 0;
+    int            cc;
+    int            i, n;
+
+    for (n = 0; predecessor = block_predecessor(header, n); ++n) {
+        if (predecessor->bs & B_LOOP) continue;
+        level = MAX(level, predecessor->loop_level);
+        preheader = predecessor;
+        ++nr_outside;
+    }
+
+    if (    (nr_outside == 1)
+        &&  (preheader != entry_block)
+        &&  (preheader->nr_successors == 1) )
+    {
+        return preheader;
+    }
+
+    preheader = new_block();
+    preheader->dfn = DFN_NEW;
+    ++preheaders;
+    preheader->loop_level = level;
+    move_block(preheader, header);
+
+  again:
+    for (n = 0; predecessor = block_predecessor(header, n); ++n) {
+        if (predecessor->bs & B_LOOP) continue;
+        if (predecessor == preheader) continue;
+
+        for (i = 0; successor = block_successor(predecessor, i); ++i) {
+            if (successor == header) {
+                cc = block_successor_cc(predecessor, i);
+                unsucceed_block(predecessor, i);
+                succeed_block(predecessor, cc, preheader);
+                goto again;
+            }
+        }
+    }
+
+    succeed_block(preheader, CC_ALWAYS, header);
+    return preheader;
+}
+
+/* count the DEFs of each pseudo in the loop, noting where they are,
+   and see if the loop writes to memory (calls count). */
+
+static
+count_defs()
+{
+    struct block * block;
+    struct insn  * insn;
+    int            i, j, s;
+
+    for (i = 0; i < nr_slots; ++i) nr_defs[i] = 0;
+    loop_writes = 0;
+
+    for (i = 0; i < nr_body; ++i) {
+        block = body[i];
+
+        for (insn = block->first_insn; insn; insn = insn->next) {
+            if (insn->mem_defd) loop_writes = 1;
+
+            for (j = 0; (j < NR_INSN_REGS) && (insn->regs_defd[j] != R_NONE); ++j) {
+                if ((s = slot(insn->regs_defd[j])) == -1) continue;
+                nr_defs[s]++;
+                def_insns[s] = insn;
+                def_blocks[s] = block;
+            }
+        }
+    }
+}
+
+/* is the pseudo 'reg' unaliased? it's safe to hold such a value in a
+   register across memory writes (and to move its DEFs around). */
+
+static
+is_unaliased(reg)
+{
+    struct symbol * symbol;
+    int             s;
+
+    if ((s = slot(reg)) == -1) return 0;
+
+    if (unaliased[s] == 0) {
+        symbol = find_symbol_by_reg(reg);
+        unaliased[s] = (symbol && (symbol->ss & S_REGISTER)) ? 1 : 2;
+    }
+
+    return (unaliased[s] == 1);
+}
+
+/* is 'reg' invariant in the loop? it must never be DEFd, and if it's
+   aliased (e.g., it caches a global), the loop can't write to memory. */
+
+static
+is_invariant(reg)
+{
+    int s;
+
+    if (reg == R_BP) return 1;
+    if ((s = slot(reg)) == -1) return 0;
+    if (nr_defs[s]) return 0;
+    return (!loop_writes || is_unaliased(reg));
+}
+
+/* could 'insn', which DEFs 'reg', be executed in the preheader instead?
+   it must have no side effects beyond the DEF, must not fault (so memory
+   reads are limited to statics and the frame, and then only if the loop
+   doesn't write to memory), and otherwise only USE invariant registers. */
+
+static
+is_movable(insn, reg)
+    struct insn * insn;
+{
+    struct tree * tree;
+    int           i;
+
+    switch (I_IDX(insn->opcode))
+    {
+    case I_IDX(I_MOV):
+    case I_IDX(I_MOVSX):
+    case I_IDX(I_MOVZX):
+    case I_IDX(I_MOVSS):
+    case I_IDX(I_MOVSD):
+    case I_IDX(I_LEA):
+    case I_IDX(I_ADD):
+    case I_IDX(I_SUB):
+    case I_IDX(I_IMUL):
+    case I_IDX(I_SHL):
+    case I_IDX(I_SHR):
+    case I_IDX(I_SAR):
+    case I_IDX(I_AND):
+    case I_IDX(I_OR):
+    case I_IDX(I_XOR):
+    case I_IDX(I_NOT):
+    case I_IDX(I_NEG):
+        break;
+    default:
+        return 0;
+    }
+
+    if (insn->flags & INSN_FLAG_CC) return 0;
+    if (insn->mem_defd) return 0;
+    if (insn_nr_defs(insn) != 1) return 0;
+
+    for (i = 0; i < I_NR_OPERANDS(insn->opcode); ++i) {
+        tree = insn->operand[i];
+        if (tree->op != E_MEM) continue;
+        if (insn->opcode == I_LEA) continue;
+        if (loop_writes) return 0;
+
+        if (tree->u.mi.rip) continue;
+        if ((tree->u.mi.b == R_BP) && (tree->u.mi.i == R_NONE)) continue;
+        return 0;
+    }
+
+    for (i = 0; (i < NR_INSN_REGS) && (insn->regs_used[i] != R_NONE); ++i) {
+        if (insn->regs_used[i] == reg) continue;
+        if (!is_invariant(insn->regs_used[i])) return 0;
+    }
+
+    return 1;
+}
+
+/* is it worth hoisting 'insn'? not if it's just a copy or a constant. */
+
+static
+is_worthwhile(insn)
+    struct insn * insn;
+{
+    switch (I_IDX(insn->opcode))
+    {
+    case I_IDX(I_MOV):
+    case I_IDX(I_MOVSS):
+    case I_IDX(I_MOVSD):
+        return (insn->operand[1]->op == E_MEM);
+    default:
+        return 1;
+    }
+}
+
+/* the address of an array is computed into the same pseudo as the
+   element's, e.g., for a static,
+
+        LEA T, [rip _array]
+        ADD T, I
+
+   so T can't be hoisted, but the LEA can be, on its own: it's given a new
+   pseudo B, computed in the preheader, and the LEA becomes MOV T, B. the
+   LEAs of the same address in a loop share a B. returns non-zero if the
+   LEA 'insn' (which must be movable) was so split. */
+
+static struct
+{
+    struct tree * address;
+    int           reg;
+} bases[NR_BASES];
+
+static int nr_bases;
+
+static
+split_lea(insn, preheader)
+    struct insn  * insn;
+    struct block * preheader;
+{
+    struct tree * address = insn->operand[1];
+    struct tree * base;
+    struct insn * new;
+    int           b;
+    int           i;
+
+    for (i = 0; i < nr_bases; ++i) {
+        base = bases[i].address;
+
+        if (    (base->u.mi.glob == address->u.mi.glob)
+            &&  (base->u.mi.ofs == address->u.mi.ofs)
+            &&  (base->u.mi.b == address->u.mi.b)
+            &&  (base->u.mi.i == address->u.mi.i)
+            &&  ((base->u.mi.i == R_NONE) || (base->u.mi.s == address->u.mi.s))
+            &&  (base->u.mi.rip == address->u.mi.rip) ) break;
+    }
+
+    if (i < nr_bases)
+        b = bases[i].reg;
+    else {
+        if (nr_bases == NR_BASES) return 0;
+        b = symbol_reg(temporary_symbol(new_type(T_LONG)));
+
+        new = new_insn(I_LEA, reg_tree(b, new_type(T_LONG)), copy_tree(address));
+        put_insn(preheader, new, NULL);
+        analyze_insn(new);
+
+        bases[nr_bases].address = new->operand[1];
+        bases[nr_bases].reg = b;
+        ++nr_bases;
+    }
+
+    insn->opcode = I_MOV;
+    free_tree(insn->operand[1]);
+    insn->operand[1] = reg_tree(b, new_type(T_LONG));
+    analyze_insn(insn);
+    return 1;
+}
+
+/* hoist invariant computations out of the loop. a pseudo qualifies if it
+   isn't live into the header, and all its DEFs in the loop are movable and
+   together in one block, with no other references to it interleaved. then
+   every USE in the loop sees the last DEF, and the DEFs can be moved, in
+   order, into the preheader. an LEA which doesn't qualify only because of
+   the other DEFs is split instead (above). repeat until nothing changes:
+   each hoist can make more registers invariant. returns the number of
+   pseudos hoisted (or LEAs split). */
+
+static
+hoist(header, preheader)
+    struct block * header;
+    struct block * preheader;
+{
+    struct block  * block;
+    struct insn   * insn;
+    struct insn   * next;
+    struct insn   * last;
+    struct insn   * tmp;
+    struct defuse * defuse;
+    int             hoists = 0;
+    int             changes;
+    int             worth;
+    int             reg;
+    int             i, n, s;
+
+    count_defs();
+    nr_bases = 0;
+
+    do {
+        changes = 0;
+
+        for (i = 0; i < nr_body; ++i) {
+            block = body[i];
+
+            for (insn = block->first_insn; insn; insn = next) {
+                next = insn->next;
+
+                if (insn_nr_defs(insn) != 1) continue;
+                reg = insn->regs_defd[0];
+                if ((s = slot(reg)) == -1) continue;
+                if (insn_uses_reg(insn, reg)) continue;
+                if (!is_movable(insn, reg)) continue;
+
+                /* find the rest of the DEFs */
+
+                worth = 0;
+                last = NULL;
+                n = 0;
+
+                for (tmp = insn; tmp; tmp = tmp->next) {
+                    if (insn_defs_reg(tmp, reg)) {
+                        if (!is_movable(tmp, reg)) break;
+                        worth |= is_worthwhile(tmp);
+                        last = tmp;
+                        if (++n == nr_defs[s]) break;
+                    } else if (insn_uses_reg(tmp, reg))
+                        break;
+                }
+
+                if ((n != nr_defs[s]) && (insn->opcode == I_LEA)) {
+                    if (split_lea(insn, preheader)) ++hoists;
+                    continue;
+                }
+
+                if (n != nr_defs[s]) continue;
+                if (!worth) continue;
+                if (!is_unaliased(reg)) continue;
+                defuse = find_defuse(header, reg, FIND_DEFUSE_NORMAL);
+                if (defuse && (defuse->dus & DU_IN)) continue;
+
+                for (tmp = insn; tmp != last; tmp = next) {
+                    next = tmp->next;
+
+                    if (insn_defs_reg(tmp, reg)) {
+                        get_insn(block, tmp);
+                        put_insn(preheader, tmp, NULL);
+                    }
+                }
+
+                get_insn(block, last);
+                put_insn(preheader, last, NULL);
+
+                nr_defs[s] = 0;
+                next = block->first_insn;
+                ++hoists;
+                ++changes;
+            }
+        }
+    } while (changes);
+
+    return hoists;
+}
+
+/* strength reduction. look for a pseudo T computed from a basic induction
+   variable I (one whose only DEF in the loop is I += C) as
+
+        MOV[SX] T, I
+        IMUL T, K
+
+   where T has no other DEFs in the loop and isn't live into the header.
+   we introduce a new pseudo R, which tracks K * I:
+
+        preheader:  MOV[SX] R, I        I += C:     ADD R, C * K
+                    IMUL R, K                       I += C
+
+   and T is just a copy of R. sign extension (MOVSX) is only allowed from
+   signed ints, whose overflow is undefined, so the sums can't diverge.
+   pseudos which are reduced the same way share the same R. */
+
+static struct
+{
+    int  opcode;
+    int  iv;
+    long k;
+    int  reg;
+} reductions[NR_REDUCTIONS];
+
+static int nr_reductions;
+
+static
+reduce(header, preheader)
+    struct block * header;
+    struct block * preheader;
+{
+    struct block  * block;
+    struct insn   * insn;
+    struct insn   * imul;
+    struct insn   * step;
+    struct insn   * new;
+    struct defuse * defuse;
+    long            k;
+    long            c;
+    int             t, iv, r;
+    int             i, j, s;
+    int             reduced = 0;
+
+    count_defs();
+    nr_reductions = 0;
+
+    for (i = 0; i < nr_body; ++i) {
+        block = body[i];
+
+        for (insn = block->first_insn; insn; insn = insn->next) {
+            if ((insn->opcode != I_MOV) && (insn->opcode != I_MOVSX)) continue;
+            if (insn->operand[0]->op != E_REG) continue;
+            if (insn->operand[1]->op != E_REG) continue;
+            if (size_of(insn->operand[0]->type) != 8) continue;
+
+            if (insn->opcode == I_MOVSX) {
+                if (!(insn->operand[1]->type->ts & T_INT)) continue;
+            } else if (size_of(insn->operand[1]->type) != 8)
+                continue;
+
+            imul = insn->next;
+            if ((imul == NULL) || (imul->opcode != I_IMUL)) continue;
+            if (imul->flags & INSN_FLAG_CC) continue;
+            if (imul->operand[1]->op != E_CON) continue;
+            if (imul->operand[0]->op != E_REG) continue;
+            t = insn->operand[0]->u.reg;
+            if (imul->operand[0]->u.reg != t) continue;
+            k = imul->operand[1]->u.con.i;
+
+            /* T must be computed only here */
+
+            if ((s = slot(t)) == -1) continue;
+            if (nr_defs[s] != 2) continue;
+            if (!is_unaliased(t)) continue;
+            defuse = find_defuse(header, t, FIND_DEFUSE_NORMAL);
+            if (defuse && (defuse->dus & DU_IN)) continue;
+
+            /* I must be a basic induction variable */
+
+            iv = insn->operand[1]->u.reg;
+            if ((s = slot(iv)) == -1) continue;
+            if (nr_defs[s] != 1) continue;
+            if (!is_unaliased(iv)) continue;
+            step = def_insns[s];
+
+            switch (step->opcode)
+            {
+            case I_ADD:
+            case I_SUB:
+                if (step->operand[1]->op != E_CON) continue;
+                c = step->operand[1]->u.con.i;
+                if (step->opcode == I_SUB) c = -c;
+                break;
+            case I_INC:
+                c = 1;
+                break;
+            case I_DEC:
+                c = -1;
+                break;
+            default:
+                continue;
+            }
+
+            if ((step->operand[0]->op != E_REG) || (step->operand[0]->u.reg != iv)) continue;
+            if ((c * k) != (int) (c * k)) continue;
+
+            /* looks good. find (or make) R */
+
+            for (j = 0; j < nr_reductions; ++j)
+                if (    (reductions[j].opcode == insn->opcode)
+                    &&  (reductions[j].iv == iv)
+                    &&  (reductions[j].k == k) ) break;
+
+            if (j < nr_reductions)
+                r = reductions[j].reg;
+            else {
+                if (nr_reductions == NR_REDUCTIONS) continue;
+                r = symbol_reg(temporary_symbol(new_type(T_LONG)));
+
+                new = new_insn(insn->opcode, reg_tree(r, new_type(T_LONG)), copy_tree(insn->operand[1]));
+                put_insn(preheader, new, NULL);
+                analyze_insn(new);
+                new = new_insn(I_IMUL, reg_tree(r, new_type(T_LONG)), int_tree(T_LONG, k));
+                put_insn(preheader, new, NULL);
+                analyze_insn(new);
+                new = new_insn(I_ADD, reg_tree(r, new_type(T_LONG)), int_tree(T_LONG, c * k));
+                put_insn(def_blocks[s], new, step);
+                analyze_insn(new);
+
+                reductions[nr_reductions].opcode = insn->opcode;
+                reductions[nr_reductions].iv = iv;
+                reductions[nr_reductions].k = k;
+                reductions[nr_reductions].reg = r;
+                ++nr_reductions;
+            }
+
+            /* T = R, and the IMUL goes away */
+
+            insn->opcode = I_MOV;
+            free_tree(insn->operand[1]);
+            insn->operand[1] = reg_tree(r, new_type(T_LONG));
+            analyze_insn(insn);
+            kill_insn(block, imul);
+            ++reduced;
+        }
+    }
+
+    return reduced;
+}
+
+/* the driver. returns non-zero if anything was changed,
+   in which case the def/use data must be recomputed. */
+
+loop_opt()
+{
+    struct block * block;
+    struct block * preheader;
+    int            nr_blocks = 0;
+    int            changes = 0;
+    int            i;
+
+    for (block = first_block; block; block = block->next) {
+        block->dfn = DFN_NONE;
+        ++nr_blocks;
+    }
+
+    post = (struct block **) allocate(nr_blocks * sizeof(struct block *));
+    idoms = (int *) allocate(nr_blocks * sizeof(int));
+    loops = (struct loop *) allocate(nr_blocks * sizeof(struct loop));
+    body = (struct block **) allocate(nr_blocks * 2 * sizeof(struct block *));
+    nr_post = 0;
+    number1(entry_block);
+    dominators();
+    find_loops();
+
+    /* pseudos created from here on have no slots. */
+
+    nr_islots = R_IDX(next_iregister) - NR_REGS;
+    nr_fslots = R_IDX(next_fregister) - NR_REGS;
+    nr_slots = nr_islots + nr_fslots + 1;       /* never zero */
+    nr_defs = (int *) allocate(nr_slots * sizeof(int));
+    def_insns = (struct insn **) allocate(nr_slots * sizeof(struct insn *));
+    def_blocks = (struct block **) allocate(nr_slots * sizeof(struct block *));
+    unaliased = allocate(nr_slots);
+    for (i = 0; i < nr_slots; ++i) unaliased[i] = 0;
+
+    preheaders = 0;
+
+    for (i = 0; i < nr_loops; ++i) {
+        if (loops[i].header == entry_block) continue;
+        find_body(loops[i].header);
+        preheader = make_preheader(loops[i].header);
+        changes += hoist(loops[i].header, preheader);
+        changes += reduce(loops[i].header, preheader);
+        clear_body();
+    }
+
+    free(post);
+    free(idoms);
+    free(loops);
+    free(body);
+    free(nr_defs);
+    free(def_insns);
+    free(def_blocks);
+    free(unaliased);
+
+    return changes + preheaders;
+}
@@ -31,6 +31,9 @@
 
 int             g_flag;             /* -g: produce debug info */
 int             O_flag;             /* -O: enable optimizations */
+int             regparm_flag;       /* -mregparm: pass arguments in registers */
+int             sections_flag;      /* -fsections: a section per function/datum */
+int             H_flag;             /* -H: print hash table statistics */
 FILE          * yyin;               /* lexical input */
 struct token    token;          
 struct string * input_name;         /* input file name and line number ... */
@@ -45,7 +48,14 @@ struct symbol * current_function;
 int             frame_offset;
 int             save_iregs;         /* bitsets (1 << R_IDX(x)) of registers .. */
 int             save_fregs;         /* .. used in this function */
+int             iarg_regs[NR_IARG_REGS] = { R_DI, R_SI, R_DX, R_CX, R_8, R_9 };
+
+int             scratch_iregs = (1 << R_IDX(R_AX))      /* bitsets of registers */
+                              | (1 << R_IDX(R_CX))      /* which are not preserved */
+                              | (1 << R_IDX(R_DX));     /* across calls */
+int             scratch_fregs = (1 << R_IDX(R_XMM0));
 int             loop_level;
+int             type_puns;          /* pointer casts seen in this function */
 struct block *  first_block;
 struct block *  last_block;
 struct block *  current_block;
@@ -113,7 +123,8 @@ static char *errors[] =
     "misplaced break, continue or case",    /* ERROR_MISPLACED */
     "dangling goto (undefined label)",      /* ERROR_DANGLING */
     "duplicate case label",                 /* ERROR_DUPCASE */
-    "switch/case expression not integral"   /* ERROR_CASE */
+    "switch/case expression not integral",  /* ERROR_CASE */
+    "unrecognized option"                   /* ERROR_OPTION */
 };
 
 error(code)
@@ -127,7 +138,7 @@ error(code)
 
     fprintf(stderr, "ERROR: %s\n", errors[code]);
 
-    if (output_file) {
+    if (output_file && (output_file != stdout)) {
         fclose(output_file);
         unlink(output_name->data);
     }
@@ -147,45 +158,182 @@ allocate(bytes)
     return p;
 }
 
+/* an arena is a list of chunks, from which memory is allocated by bumping
+   a pointer. individual allocations are never freed; instead, the whole
+   arena is released at once. each chunk is linked to the previous one
+   through its first word, so allocations start at ARENA_ALIGN. */
+
+#define ARENA_ALIGN     8
+
+static struct arena
+{
+    char *  chunks;         /* most recent first */
+    char *  next;           /* next free byte in current chunk */
+    char *  end;            /* end of current chunk */
+    int     generation;     /* incremented on release */
+} arenas[NR_ARENAS];
+
+char *
+arena_allocate(n, bytes)
+    int n;
+    int bytes;
+{
+    struct arena * arena = &arenas[n];
+    char         * p;
+    int            size;
+
+    bytes = ROUND_UP(bytes, ARENA_ALIGN);
+
+    if ((arena->end - arena->next) < bytes) {
+        size = MAX(ARENA_CHUNK, bytes + ARENA_ALIGN);
+        p = allocate(size);
+        *((char **) p) = arena->chunks;
+        arena->chunks = p;
+        arena->next = p + ARENA_ALIGN;
+        arena->end = p + size;
+    }
+
+    p = arena->next;
+    arena->next += bytes;
+    return p;
+}
+
+/* free all the memory in an arena. any pools drawing
+   from the arena are emptied as a consequence. */
+
+release_arena(n)
+{
+    struct arena * arena = &arenas[n];
+    char         * chunk;
+
+    while (chunk = arena->chunks) {
+        arena->chunks = *((char **) chunk);
+        free(chunk);
+    }
+
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->generation++;
+}
+
+/* allocate an object from a pool, recycling a free one if possible. */
+
+char *
+pool_allocate(pool)
+    struct pool * pool;
+{
+    char * p;
+
+    if (pool->generation != arenas[pool->arena].generation) {
+        pool->generation = arenas[pool->arena].generation;
+        pool->free = NULL;
+    }
+
+    if (p = pool->free) {
+        pool->free = *((char **) p);
+        return p;
+    }
+
+    return arena_allocate(pool->arena, pool->size);
+}
+
+/* return an object to its pool. */
+
+pool_free(pool, p)
+    struct pool * pool;
+    char        * p;
+{
+    *((char **) p) = pool->free;
+    pool->free = p;
+}
+
+/* report an unrecognized option (with its argument). as with the
+   output file name below, error() is tricked into printing it. */
+
+static
+bad_option(opt, arg)
+    char * arg;
+{
+    char * text;
+
+    text = allocate(strlen(arg) + 3);
+    text[0] = '-';
+    text[1] = opt;
+    strcpy(text + 2, arg);
+    input_name = stringize(text, strlen(text));
+    error(ERROR_OPTION);
+}
 
 main(argc, argv)
     char *argv[];
 {
-    int opt;
+    char * arg;
+    int    opt;
+    int    i;
+
+    /* the options are parsed by hand, like the driver's, rather than with
+       getopt(), which can't take the optional argument of -O portably. */
+
+    for (--argc, ++argv; argc && (**argv == '-') && (*argv)[1]; --argc, ++argv) {
+        opt = (*argv)[1];
+        arg = *argv + 2;
+
+        if (((opt == 'm') || (opt == 'f')) && (*arg == 0)) {
+            if (argc < 2) error(ERROR_CMDLINE);
+            --argc;
+            arg = *++argv;
+        }
 
-    while ((opt = getopt(argc, argv, "gO")) != -1)
-    {
         switch (opt)
         {
-        case 'O':
-            ++O_flag;
+        case 'O':   /* -O, or -O2 for global register allocation */
+            if (*arg == 0)
+                ++O_flag;
+            else if (!strcmp(arg, "2"))
+                O_flag = 2;
+            else
+                bad_option(opt, arg);
             break;
         case 'g':
+            if (*arg) bad_option(opt, arg);
             ++g_flag;
             break;
+        case 'H':
+            if (*arg) bad_option(opt, arg);
+            ++H_flag;
+            break;
+        case 'm':   /* -mregparm: register calling convention */
+            if (strcmp(arg, "regparm")) bad_option(opt, arg);
+            ++regparm_flag;
+
+            for (i = 0; i < NR_IARG_REGS; i++) scratch_iregs |= 1 << R_IDX(iarg_regs[i]);
+            for (i = 0; i < NR_FARG_REGS; i++) scratch_fregs |= 1 << R_IDX(R_XMM0 + i);
+            break;
+        case 'f':   /* -fsections: let the linker drop what isn't used */
+            if (strcmp(arg, "sections")) bad_option(opt, arg);
+            ++sections_flag;
+            break;
         default:
-            exit(1);
+            bad_option(opt, arg);
         }
     }
 
-    argc -= optind;
-    argv = &argv[optind];
-
     if (argc != 2) error(ERROR_CMDLINE);
 
     output_name = stringize(argv[1], strlen(argv[1]));
     input_name = output_name; /* trick error() for a sec */
-    output_file = fopen(argv[1], "w");
+    output_file = strcmp(argv[1], "-") ? fopen(argv[1], "w") : stdout;
     if (!output_file) error(ERROR_OUTPUT);
 
     input_name = stringize(argv[0], strlen(argv[0]));
-    yyin = fopen(argv[0], "r");
+    yyin = strcmp(argv[0], "-") ? fopen(argv[0], "r") : stdin;
     if (!yyin) error(ERROR_INPUT);
 
     yyinit();
     translation_unit();
     literals();
     externs();
+    if (H_flag) hash_stats();
 
     fclose(output_file);
     exit(0);
@@ -46,19 +46,56 @@ extern void output(char * fmt, ...);
 #define FRAME_ARGUMENTS     16      /* start of arguments in frame */
 #define FRAME_ALIGN         8       /* always 8-byte aligned */
 
-/* number of buckets in the hash tables. a power of two is preferable.
-   more buckets can improve performance, but with NR_SYMBOL_BUCKETS in 
-   particular, larger numbers can have a negative impact, as every bucket 
-   must be scanned when exiting a scope. */
+/* initial number of buckets in the hash tables, which grow as needed.
+   these must be powers of two. */
 
-#define NR_STRING_BUCKETS   64
-#define NR_SYMBOL_BUCKETS   32
+#define MIN_STRING_BUCKETS  256
+#define MIN_SYMBOL_BUCKETS  64
+#define MIN_TYPE_BUCKETS    256
+#define MIN_DEFUSE_BUCKETS  8
+
+/* strings are hashed incrementally, a character at a time, with FNV-1a. */
+
+#define STRING_HASH_INIT    0x811C9DC5
+#define STRING_HASH(h,c)    (((h) ^ ((c) & 0xff)) * 16777619)
 
 /* limits the level of block nesting. the number is arbitrary, but
    it must be at least "a few less" than INT_MAX at most. */
 
 #define SCOPE_MAX           1000
 
+/* switch statements with at least SWITCH_TABLE_MIN cases which occupy
+   at least SWITCH_TABLE_DENSITY percent of their range of values are
+   dispatched through a jump table, provided the table would have at
+   most SWITCH_TABLE_MAX entries. runs of at most SWITCH_LINEAR_MAX
+   sparse cases are tested in sequence, rather than by binary search. */
+
+#define SWITCH_TABLE_MIN        4
+#define SWITCH_TABLE_DENSITY    40
+#define SWITCH_TABLE_MAX        4096
+#define SWITCH_LINEAR_MAX       3
+
+/* the maximum number of distinct induction expressions which will be
+   strength-reduced in any one loop [loop.c]. */
+
+#define NR_REDUCTIONS           16
+
+/* the maximum number of distinct addresses whose LEAs will be hoisted
+   from any one loop, apart from the rest of their DEFs [loop.c]. */
+
+#define NR_BASES                16
+
+/* global propagation [prop.c] keeps a state for each pseudo live across 
+   blocks, in each block. functions which would need more than this many
+   states are skipped, to bound the time and space required. */
+
+#define PROP_MAX_CELLS          (4 * 1024 * 1024)
+
+/* memory for the compiler's data structures is carved from chunks of this
+   many bytes [ncc1.c]. larger requests get a chunk of their own. */
+
+#define ARENA_CHUNK             (64 * 1024)
+
 /*
  * MAX_SIZE limits the number of bytes specified by a type. 256MB - 1
  * is currently the largest safe value, due to the use of 'int' to 
@@ -79,8 +116,34 @@ extern void output(char * fmt, ...);
 #include "reg.h"
 #include "block.h"
 
+/* arenas [ncc1.c]. the function arena holds the intermediate code of the
+   function being compiled, and is released in bulk when it's been output.
+   the permanent arena holds everything that may outlive a function. */
+
+#define ARENA_FUNCTION          0
+#define ARENA_PERMANENT         1
+#define NR_ARENAS               2
+
+/* a pool dispenses fixed-size objects from an arena, and keeps discarded
+   objects on a free list to be recycled. a pool is implicitly emptied when
+   its arena is released. */
+
+struct pool
+{
+    int     size;               /* of each object, in bytes */
+    int     arena;              /* ARENA_* */
+    char *  free;               /* free list, linked through first word */
+    int     generation;         /* of the arena, when 'free' was valid */
+};
+
 extern int              g_flag;
 extern int              O_flag;
+extern int              regparm_flag;
+extern int              sections_flag;
+extern int              H_flag;
+extern int              iarg_regs[];
+extern int              scratch_iregs;
+extern int              scratch_fregs;
 extern FILE *           yyin;
 extern struct token     token;
 extern int              line_number;
@@ -92,6 +155,7 @@ extern int              next_asm_label;
 extern int              next_iregister;
 extern int              next_fregister;
 extern int              loop_level;
+extern int              type_puns;
 extern struct symbol *  current_function;
 extern int              frame_offset;
 extern int              save_iregs;
@@ -103,7 +167,10 @@ extern struct block *   first_block;
 extern struct block *   last_block;
 
 extern char *           allocate();
+extern char *           arena_allocate();
+extern char *           pool_allocate();
 extern struct string *  stringize();
+extern struct string *  hashed_string();
 extern struct symbol *  string_symbol();
 extern struct symbol *  new_symbol();
 extern struct symbol *  find_symbol();
@@ -112,10 +179,15 @@ extern struct symbol *  find_typedef();
 extern struct symbol *  find_symbol_list();
 extern struct symbol *  temporary_symbol();
 extern struct symbol *  find_label();
+extern struct symbol *  access_tag();
 extern struct type *    new_type();
 extern struct type *    copy_type();
 extern struct type *    splice_types();
 extern struct type *    argument_type();
+extern struct type *    intern_type();
+extern struct type *    compose_types();
+extern struct type *    bound_type();
+extern struct type *    field_storage();
 extern struct tree *    new_tree();
 extern struct tree *    copy_tree();
 extern struct tree *    expression();
@@ -134,6 +206,7 @@ extern struct type *    abstract_type();
 extern struct block *   new_block();
 extern struct block *   block_successor();
 extern struct block *   block_predecessor();
+extern struct block *   next_work();
 extern struct insn *    new_insn();
 extern struct tree *    generate();
 extern struct tree *    float_literal();
@@ -161,10 +234,6 @@ extern struct defuse *  find_defuse_by_symbol();
 #define DECLARATIONS_INTS       0x00000002 
 #define DECLARATIONS_FIELDS     0x00000004
 
-/* flags for check_types() */
-
-#define CHECK_TYPES_COMPOSE     0x00000001
-
 /* output segments */
 
 #define SEGMENT_TEXT    0           /* code */
@@ -229,3 +298,4 @@ extern struct defuse *  find_defuse_by_symbol();
 #define ERROR_DANGLING      54      /* undefined label */
 #define ERROR_DUPCASE       55      /* duplicate case label */
 #define ERROR_CASE          56      /* switch/case must be integral */
+#define ERROR_OPTION        57      /* unrecognized option */
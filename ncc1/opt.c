@@ -337,9 +337,65 @@ temp_peep(block)
     return -kills; 
 }
 
+/* are E_MEM operands 'a' and 'b' the same location, of the same size? */
+
+static
+same_memory(a, b)
+    struct tree * a;
+    struct tree * b;
+{
+    return (a->u.mi.glob == b->u.mi.glob) 
+        && (a->u.mi.ofs == b->u.mi.ofs)
+        && (a->u.mi.b == b->u.mi.b)
+        && (a->u.mi.i == b->u.mi.i)
+        && ((a->u.mi.i == R_NONE) || (a->u.mi.s == b->u.mi.s))
+        && (a->u.mi.rip == b->u.mi.rip)
+        && (size_of(a->type) == size_of(b->type));
+}
+
+/* 'insn' stores to memory. is the location overwritten by a later store 
+   in the block, before it might be read? the address registers must not 
+   change in between, and any other memory read must not alias it. */
+
+static
+overwritten(insn)
+    struct insn * insn;
+{
+    struct tree * memory = insn->operand[0];
+    struct insn * next;
+    int           i;
+
+    for (next = insn->next; next; next = next->next) {
+        if (next->opcode == I_CALL) return 0;
+
+        if (next->mem_used && (next->opcode != I_LEA)) {
+            for (i = 0; i < I_NR_OPERANDS(next->opcode); i++)
+                if (    (next->opcode & I_USE(i)) 
+                    &&  (next->operand[i]->op == E_MEM) 
+                    &&  may_alias(next->operand[i], memory) ) 
+                {
+                    return 0;
+                }
+        }
+
+        if (    ((next->opcode == I_MOV) || (next->opcode == I_MOVSS) || (next->opcode == I_MOVSD))
+            &&  (next->operand[0]->op == E_MEM) 
+            &&  same_memory(next->operand[0], memory) )
+        {
+            return 1;
+        }
+
+        if ((memory->u.mi.b != R_NONE) && insn_defs_reg(next, memory->u.mi.b)) return 0;
+        if ((memory->u.mi.i != R_NONE) && insn_defs_reg(next, memory->u.mi.i)) return 0;
+    }
+
+    return 0;
+}
+
 /* remove dead code (dead stores): any instruction that
    only DEFs a register whose value is never used, and
-   has no other side effects, is dead code. */
+   has no other side effects, is dead code. so too is a 
+   store to memory that's overwritten before it's read. */
 
 static 
 dead_stores(block)
@@ -352,6 +408,15 @@ dead_stores(block)
     for (insn = block->first_insn; insn; insn = next) {
         next = insn->next;
 
+        if (    ((insn->opcode == I_MOV) || (insn->opcode == I_MOVSS) || (insn->opcode == I_MOVSD))
+            &&  (insn->operand[0]->op == E_MEM) 
+            &&  overwritten(insn) ) 
+        {
+            kill_insn(block, insn);
+            ++kills;
+            continue;
+        }
+
         /* no side effects:
            1. can't set condition codes that are inspected
            2. no memory reads
@@ -372,97 +437,6 @@ dead_stores(block)
     return -kills; 
 }
 
-/* constant propogation. step through the block and track if a register
-   has a known constant value; set DU_CON and 'con' if so. as is typical,
-   the register in question must be unaliased (S_REGISTER).
-
-   we could use this information to replace the register with the
-   constant value in subsequent insns, if we wished, but we don't (yet).
-   for now, we're more interested in eliminating jumps. see end of loop.
-   the function is written to make it easy to add "proper" constant
-   propagation here, once it becomes clear when that is a win. */
-
-static
-con_prop(block)
-    struct block * block;
-{
-    struct insn    * insn;
-    int             i;
-    int             j;
-    int             reg;
-    struct defuse * defuse;
-    struct block  * test_block;
-    struct block  * succ;
-    
-    for (insn = block->first_insn; insn; insn = insn->next) {
-        /* first, invalidate all the
-           registers DEFd in this insn */
-
-        j = insn_nr_defs(insn);
-
-        for (i = 0; i < j; ++i) {
-            defuse = find_defuse(block, insn->regs_defd[i], 
-                FIND_DEFUSE_NORMAL);
-
-            if (defuse) defuse->dus &= ~DU_CON;
-        }
-
-        /* look for a MOV <reg>, <con> 
-           that meets our constraints */
-
-        if (insn->opcode != I_MOV) continue;
-        if (insn->operand[1]->op != E_CON) continue;
-        if (insn->operand[0]->op != E_REG) continue;
-        reg = insn->operand[0]->u.reg;
-        defuse = find_defuse(block, reg, FIND_DEFUSE_NORMAL);
-        if (!defuse) continue;
-        if (!(defuse->symbol->ss & S_REGISTER)) continue;
-        if (!(defuse->symbol->type->ts & T_INT)) continue;
-
-        /* looks good, remember it */
-
-        defuse->dus |= DU_CON;
-        defuse->con = insn->operand[1]->u.con.i;
-    }
-
-    /* look to see if we have exactly one successor whose 
-       sole purpose is to TEST a value whose value we know
-       is constant; we can jump around the test. this, in 
-       concert with dead code and jump optimization, makes
-       the output for logical operators much, much better.
-       the code generator just doesn't have enough context. */
-
-    if (block->nr_successors != 1) return 0;
-    test_block = block_successor(block, 0);
-    if (test_block->nr_insns != 1) return 0;
-    insn = test_block->first_insn;
-    if (insn->opcode != I_TEST) return 0;
-    if (insn->operand[0]->op != E_REG) return 0;
-    if (insn->operand[1]->op != E_REG) return 0;
-    reg = insn->operand[0]->u.reg;
-    if (insn->operand[1]->u.reg != reg) return 0;
-    defuse = find_defuse(block, reg, FIND_DEFUSE_NORMAL);
-    if (!defuse) return 0;
-    if (!(defuse->dus & DU_CON)) return 0;
-
-    /* ok, looks good: let's try to go around test_block
-       by picking the right Z or NZ successor. */
-
-    for (i = 0; succ = block_successor(test_block, i); ++i) {
-        j = block_successor_cc(test_block, i);
-        if ((defuse->con == 0) && (j == CC_Z)) break;
-        if ((defuse->con != 0) && (j == CC_NZ)) break;
-    }
-  
-    if (succ) {
-        unsucceed_block(block, 0);
-        succeed_block(block, CC_ALWAYS, succ);
-        return -1;
-    } else
-        return 0;
-}
- 
-
 struct optimizer
 {
     int     level;
@@ -470,8 +444,7 @@ struct optimizer
 } optimizers[] = {
     { 1, early_subs },    
     { 1, temp_peep },
-    { 1, dead_stores },     
-    { 1, con_prop }
+    { 1, dead_stores }
 };
 
 #define NR_OPTIMIZERS (sizeof(optimizers)/sizeof(*optimizers))
@@ -482,9 +455,12 @@ struct optimizer
 optimize()
 {   
     struct block * block;
+    struct block * predecessor;
     int            again;
+    int            looped = 0;
     int            ret;
     int            i;
+    int            n;
 
     succeed_block(current_block, CC_ALWAYS, exit_block);
     walk_symbols(SCOPE_FUNCTION, SCOPE_RETIRED, walk1);
@@ -494,27 +470,57 @@ optimize()
        each local optimization function will return non-zero if
        it made any changes - negative if data flow is invalidated.
 
-       for now, we're extremely conservative about maintaining
-       data flow information - if an optimizer reports that the 
-       data has been invalidated for the block, we recompute ALL
-       the data (globally) and restart from the beginning. this 
-       obviously has very poor asymptotic properties, so the
-       optimizers should try to incrementally update the data. */
-    
+       the data flow information is computed globally only once. 
+       after that, when an optimizer invalidates a block's data, 
+       update_defuses() fixes it incrementally. the changed block,
+       its predecessors, and any blocks whose liveness data changed
+       go on the worklist to be revisited. jumps() and unreachable()
+       don't invalidate the data, so when the worklist is exhausted 
+       we clean up the flow graph, and go around again if necessary. 
+
+       once things have settled, the global propagation pass [prop.c]
+       runs, and the loop optimizations [loop.c] get one shot. these 
+       rework the flow graph, so the data flow must be computed from 
+       scratch afterwards, and then we go around again. */
+
+    jumps();
+    unreachable();
+    compute_global_defuses();
+
     do  
     {
-      restart:
         again = 0;
-        jumps(); 
-        unreachable();
-        compute_global_defuses();
+        for (block = first_block; block; block = block->next) work_block(block);
 
-        for (block = first_block; block; block = block->next) {
+        while (block = next_work()) {
             for (i = 0; i < NR_OPTIMIZERS; ++i) {
                 if (optimizers[i].level <= O_flag) {
                     ret = optimizers[i].func(block);
-                    again += ret;
-                    if (ret < 0) goto restart;
+                    if (ret == 0) continue;
+                    if (ret < 0) update_defuses(block);
+
+                    work_block(block);
+                    for (n = 0; predecessor = block_predecessor(block, n); ++n)
+                        work_block(predecessor);
+
+                    ++again;
+                }
+            }
+        }
+
+        jumps();
+        unreachable();
+
+        if (!again && O_flag) {
+            if (propagate()) {
+                compute_global_defuses();
+                ++again;
+            } else if (!looped) {
+                looped = 1;
+
+                if (loop_opt()) {
+                    compute_global_defuses();
+                    ++again;
                 }
             }
         }
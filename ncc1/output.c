@@ -24,6 +24,7 @@
 
 #include "ncc1.h"
 #include <stdarg.h>
+#include <stdlib.h>
 
 /* write a register name to the output file.  the T_* type bits
    are used solely as a hint to the proper size for integer registers. */
@@ -246,6 +247,16 @@ segment(new)
     }
 }
 
+/* select a SEGMENT_*, as segment() does, for a function or datum.
+   with -fsections, it gets a section of its own, so it can be left
+   out of the executable if nothing uses it. */
+
+section(new)
+{
+    segment(new);
+    if (sections_flag) output(".section\n");
+}
+
 /* output 'length' bytes of 'string' to the assembler output.
    the caller is assumed to have selected the appropriate segment
    and emitted a label, if necessary. if 'length' exceeds the 
@@ -291,7 +302,7 @@ static char *insns[] =
         /*  40 */   "setz", "setnz", "setg", "setle", "setge",
         /*  45 */   "setl", "seta", "setbe", "setae", "setb",
         /*  50 */   "not", "neg", "push", "pop", "call",
-        /*  55 */   "test", "ret", "inc", "dec"
+        /*  55 */   "test", "ret", "inc", "dec", "jmp"
 };
 
 /* output a block. the main task of this function is to output the 
@@ -352,10 +363,14 @@ output_block(block)
 
         output("\n; %d successors:", block->nr_successors);
 
-        for (n = 0; cessor = block_successor(block, n); ++n) 
-            output(" %s=%d", 
-                jmps[block_successor_cc(block, n)], 
-                cessor->asm_label);
+        for (n = 0; cessor = block_successor(block, n); ++n) {
+            if (CC_IS_TABLE(block_successor_cc(block, n)))
+                output(" [%d]=%d", CC_TABLE_IDX(block_successor_cc(block, n)), cessor->asm_label);
+            else
+                output(" %s=%d", 
+                    jmps[block_successor_cc(block, n)], 
+                    cessor->asm_label);
+        }
     }
 
     output("\n%L:\n", block->asm_label);
@@ -371,6 +386,35 @@ output_block(block)
     }
 }
 
+/* output the jump table of a block. the table is built from the successors
+   at output time, rather than when the switch is lowered, because jump
+   optimization and register reconciliation may have retargeted them. */
+
+static
+output_table(block)
+    struct block * block;
+{
+    struct block ** targets;
+    struct block  * successor;
+    int             cc;
+    int             n;
+
+    targets = (struct block **) allocate(block->nr_successors * sizeof(struct block *));
+
+    for (n = 0; successor = block_successor(block, n); ++n) {
+        cc = block_successor_cc(block, n);
+        if (!CC_IS_TABLE(cc) || (CC_TABLE_IDX(cc) >= block->nr_successors)) error(ERROR_INTERNAL);
+        targets[CC_TABLE_IDX(cc)] = successor;
+    }
+
+    output(".align 4\n%G:\n", block->jump_table);
+
+    for (n = 0; n < block->nr_successors; ++n)
+        output(" .dword %L-%G\n", targets[n]->asm_label, block->jump_table);
+
+    free(targets);
+}
+
 /* called after the code generator is complete, to output all the function blocks.
    the main task of this function is to glue the successive blocks together with
    appropriate jump instructions, which is surprisingly tedious. */
@@ -383,7 +427,7 @@ output_function()
     int            cc1;
 
     block = first_block;
-    segment(SEGMENT_TEXT);
+    section(SEGMENT_TEXT);
     if (current_function->ss & S_EXTERN) output(".global %G\n", current_function);
     output("%G:\n", current_function);
 
@@ -397,6 +441,13 @@ output_function()
 
         if (!successor1) continue;
 
+        /* a block with a jump table ends with its own (indirect) jump. */
+
+        if (block->jump_table) {
+            output_table(block);
+            continue;
+        }
+
         /* if there's only one successor, it should be unconditional,
            so emit a jump unless the target is being output next. */
     
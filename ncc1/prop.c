@@ -0,0 +1,1041 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org). 
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+
+#include <stdlib.h>
+#include "ncc1.h"
+
+/* global constant and copy propagation, by the sparse conditional
+   method. rather than convert to SSA form, we solve a lattice over the
+   S_REGISTER pseudos directly: at any point, a pseudo is either
+
+        V_TOP       not yet known (no executable path reaches here),
+        V_CON       known to hold a constant,
+        V_COPY      known to hold the same value as another pseudo, or
+        V_BOTTOM    unknown.
+
+   flow edges are only followed when they might be taken: a CMP or TEST
+   of known values at the end of a block selects its successors. so the
+   values in untaken arms don't pollute the joins.
+
+   only pseudos which are live into some block need per-block state;
+   the rest (the great majority, temporaries) are tracked only while
+   the block they're confined to is being examined.
+
+   once the solution is reached, we
+
+        1. substitute constants and copied registers into operands,
+        2. turn computations with constant results into MOVs,
+        3. remove MOVs that don't change their destination,
+        4. remove successors that can't be taken, and
+        5. jump around TEST/CMP blocks whose outcome is known on
+           entry from a particular predecessor. (this is important to
+           clean up after the code generator's logical operators.)
+
+   the def/use data is not maintained; the caller must recompute it
+   if anything has changed, which is indicated by a non-zero return. */
+
+#define V_TOP           0
+#define V_CON           1
+#define V_COPY          2
+#define V_BOTTOM        3
+
+static int             nr_islots;
+static int             nr_fslots;
+static int           * indices;     /* slot -> candidate index (or -1) */
+
+static int             nr_cands;    /* candidate pseudos ... */
+static int             nr_globals;  /* ... the first of which are global */
+static int           * regs;        /* candidate index -> register */
+static int           * sizes;       /* size of pseudo (bytes) */
+
+/* the current state. the entries for the locals are only valid if their
+   stamps match 'stamp', which saves clearing them for each new block.
+   each pseudo has a chain of the V_COPYs of it (linked by 'nexts' and
+   'prevs') so they can be found quickly when it's DEFd. */
+
+static char          * kinds;       /* V_* */
+static long          * values;      /* constant or index of copy source */
+static int           * stamps;
+static int             stamp;
+static int           * heads;       /* first copy of this pseudo ... */
+static int           * head_stamps; /* ... valid only if == stamp */
+static int           * nexts;
+static int           * prevs;
+
+static int             nr_blocks;
+static int             nr_ordered;
+static struct block ** blocks;      /* by dfn (reverse postorder) */
+static char          * in_kinds;    /* state on entry to each block ... */
+static long          * in_values;   /* ... of the globals only */
+static char          * reached;     /* block is known to be executable */
+static char          * queued;      /* block needs to be (re)examined */
+
+/* the last insn in the current block to set the condition codes.
+   if it's a CMP or TEST of known values, then 'cc_known' is set. */
+
+static struct insn   * cc_insn;
+static int             cc_known;
+static long            cc_a;
+static long            cc_b;
+static int             cc_size;
+
+/* the slot of a pseudo register, for indices[], or -1 */
+
+static
+slot(reg)
+{
+    int i;
+
+    if (!R_IS_PSEUDO(reg)) return -1;
+    i = R_IDX(reg) - NR_REGS;
+
+    if (reg & R_IS_FLOAT) {
+        if (i >= nr_fslots) return -1;
+        return nr_islots + i;
+    } else {
+        if (i >= nr_islots) return -1;
+        return i;
+    }
+}
+
+/* the candidate index of 'reg', or -1 */
+
+static
+candidate(reg)
+{
+    int s;
+
+    if ((s = slot(reg)) == -1) return -1;
+    return indices[s];
+}
+
+/* access the current state of candidate 'i' */
+
+static
+kind_of(i)
+{
+    if ((i >= nr_globals) && (stamps[i] != stamp)) return V_BOTTOM;
+    return kinds[i];
+}
+
+/* the first of the V_COPYs of 'i', or -1 */
+
+static
+head_of(i)
+{
+    if (head_stamps[i] != stamp) return -1;
+    return heads[i];
+}
+
+/* link/unlink candidate 'i', which is a V_COPY,
+   to/from the chain of its source. */
+
+static
+link_copy(i)
+{
+    int s = values[i];
+
+    nexts[i] = head_of(s);
+    prevs[i] = -1;
+    if (nexts[i] != -1) prevs[nexts[i]] = i;
+    heads[s] = i;
+    head_stamps[s] = stamp;
+    return 0;
+}
+
+static
+unlink_copy(i)
+{
+    if (prevs[i] != -1)
+        nexts[prevs[i]] = nexts[i];
+    else
+        heads[values[i]] = nexts[i];
+
+    if (nexts[i] != -1) prevs[nexts[i]] = prevs[i];
+    return 0;
+}
+
+static
+set_state(i, kind, value)
+    long value;
+{
+    if (kind_of(i) == V_COPY) unlink_copy(i);
+    kinds[i] = kind;
+    values[i] = value;
+    if (i >= nr_globals) stamps[i] = stamp;
+    if (kind == V_COPY) link_copy(i);
+    return 0;
+}
+
+/* sign- or zero-extend the low 'size' bytes of 'i' */
+
+static long
+sign_extend(i, size)
+    long i;
+{
+    switch (size)
+    {
+    case 1:     return (char) i;
+    case 2:     return (short) i;
+    case 4:     return (int) i;
+    default:    return i;
+    }
+}
+
+static long
+zero_extend(i, size)
+    long i;
+{
+    switch (size)
+    {
+    case 1:     return (unsigned char) i;
+    case 2:     return (unsigned short) i;
+    case 4:     return (unsigned) i;
+    default:    return i;
+    }
+}
+
+/* normalize a constant to the type, as the code generator does */
+
+static long
+normalize_con(type, i)
+    struct type * type;
+    long          i;
+{
+    switch (type->ts & T_BASE)
+    {
+    case T_CHAR:    return (char) i;
+    case T_UCHAR:   return (unsigned char) i;
+    case T_SHORT:   return (short) i;
+    case T_USHORT:  return (unsigned short) i;
+    case T_INT:     return (int) i;
+    case T_UINT:    return (unsigned) i;
+    default:        return i;
+    }
+}
+
+/* if 'tree' is an operand with a known constant value,
+   put the value (normalized to its type) in 'i' and return
+   true. a register is only examined at or below its size. */
+
+static
+value_of(tree, i)
+    struct tree * tree;
+    long        * i;
+{
+    int c;
+
+    if ((tree->op == E_CON) && !(tree->type->ts & T_IS_FLOAT)) {
+        *i = tree->u.con.i;
+        return 1;
+    }
+
+    if (tree->op != E_REG) return 0;
+    if ((c = candidate(tree->u.reg)) == -1) return 0;
+    if (kind_of(c) != V_CON) return 0;
+    if (size_of(tree->type) > sizes[c]) return 0;
+
+    *i = normalize_con(tree->type, values[c]);
+    return 1;
+}
+
+/* if 'insn' computes a constant, put it in 'i' and return true.
+   otherwise return false. the caller has already verified that
+   operand[0] is an (appropriately-sized) candidate register. */
+
+static
+compute(insn, i)
+    struct insn * insn;
+    long        * i;
+{
+    struct tree * dst;
+    struct tree * src;
+    long          a, b;
+    int           size;
+
+    dst = insn->operand[0];
+    src = insn->operand[1];
+    size = size_of(dst->type);
+
+    switch (insn->opcode)
+    {
+    case I_MOV:
+        if (!value_of(src, &b)) return 0;
+        *i = b;
+        break;
+
+    case I_MOVSX:
+    case I_MOVZX:
+        if (!value_of(src, &b)) return 0;
+
+        if (insn->opcode == I_MOVSX)
+            *i = sign_extend(b, (int) size_of(src->type));
+        else
+            *i = zero_extend(b, (int) size_of(src->type));
+
+        break;
+
+    case I_NOT:
+    case I_NEG:
+    case I_INC:
+    case I_DEC:
+        if (!value_of(dst, &a)) return 0;
+
+        switch (insn->opcode)
+        {
+        case I_NOT:     *i = ~a; break;
+        case I_NEG:     *i = -a; break;
+        case I_INC:     *i = a + 1; break;
+        case I_DEC:     *i = a - 1; break;
+        }
+
+        break;
+
+    case I_ADD:
+    case I_SUB:
+    case I_IMUL:
+    case I_AND:
+    case I_OR:
+    case I_XOR:
+    case I_SHL:
+    case I_SHR:
+    case I_SAR:
+        if (!value_of(dst, &a)) return 0;
+        if (!value_of(src, &b)) return 0;
+
+        switch (insn->opcode)
+        {
+        case I_ADD:     *i = a + b; break;
+        case I_SUB:     *i = a - b; break;
+        case I_IMUL:    *i = a * b; break;
+        case I_AND:     *i = a & b; break;
+        case I_OR:      *i = a | b; break;
+        case I_XOR:     *i = a ^ b; break;
+        case I_SHL:
+        case I_SHR:
+        case I_SAR:
+            b &= (size == 8) ? 63 : 31;
+
+            if (insn->opcode == I_SHL)
+                *i = zero_extend(a, size) << b;
+            else if (insn->opcode == I_SHR)
+                *i = ((unsigned long) zero_extend(a, size)) >> b;
+            else
+                *i = sign_extend(a, size) >> b;
+
+            break;
+        }
+
+        break;
+
+    default:
+        return 0;
+    }
+
+    *i = normalize_con(dst->type, *i);
+    return 1;
+}
+
+/* if 'insn' is a register-to-register copy between candidates,
+   return true, with their indices in 'd' and 's'. */
+
+static
+is_copy(insn, d, s)
+    struct insn * insn;
+    int         * d;
+    int         * s;
+{
+    struct tree * dst;
+    struct tree * src;
+
+    if (    (insn->opcode != I_MOV)
+        &&  (insn->opcode != I_MOVSS)
+        &&  (insn->opcode != I_MOVSD) ) return 0;
+
+    dst = insn->operand[0];
+    src = insn->operand[1];
+    if ((dst->op != E_REG) || (src->op != E_REG)) return 0;
+    if ((*d = candidate(dst->u.reg)) == -1) return 0;
+    if ((*s = candidate(src->u.reg)) == -1) return 0;
+    if (sizes[*d] != sizes[*s]) return 0;
+    if (size_of(dst->type) != sizes[*d]) return 0;
+    if (size_of(src->type) != sizes[*s]) return 0;
+
+    return 1;
+}
+
+/* if 'insn' is a copy, return the index of its source, resolved
+   through the copy that it is known to be (if any). otherwise -1. */
+
+static
+copy_source(insn)
+    struct insn * insn;
+{
+    int d, s;
+
+    if (!is_copy(insn, &d, &s)) return -1;
+    if (kind_of(s) == V_COPY) s = values[s];
+    return s;
+}
+
+/* the destination of 'insn', if it's an appropriately-sized
+   candidate register which we might track, or -1 */
+
+static
+destination(insn)
+    struct insn * insn;
+{
+    struct tree * dst;
+    int           d;
+
+    if (I_NR_OPERANDS(insn->opcode) < 1) return -1;
+    if (!(insn->opcode & I_DEF(0))) return -1;
+    dst = insn->operand[0];
+    if (dst->op != E_REG) return -1;
+    if ((d = candidate(dst->u.reg)) == -1) return -1;
+    if (size_of(dst->type) != sizes[d]) return -1;
+    return d;
+}
+
+/* candidate 'i' has been DEFd; forget anything that copies it */
+
+static
+kill_copies(i)
+{
+    int t;
+
+    while ((t = head_of(i)) != -1) set_state(t, V_BOTTOM, 0L);
+    return 0;
+}
+
+/* does 'insn' change the state? it doesn't if it's a MOV that
+   assigns a register a value that it is already known to have. */
+
+static
+is_redundant(insn)
+    struct insn * insn;
+{
+    long i;
+    int  d, s;
+
+    if ((d = destination(insn)) == -1) return 0;
+    if (insn_nr_defs(insn) != 1) return 0;
+
+    if ((s = copy_source(insn)) != -1) {
+        if (s == d) return 1;
+        return ((kind_of(d) == V_COPY) && (values[d] == s));
+    }
+
+    if ((insn->opcode == I_MOV) && (kind_of(d) == V_CON) && compute(insn, &i))
+        return (values[d] == i);
+
+    return 0;
+}
+
+/* update the state to reflect the execution of 'insn' */
+
+static
+transfer(insn)
+    struct insn * insn;
+{
+    long i;
+    int  kind = V_BOTTOM;
+    long value = 0;
+    int  d, s, c, n;
+
+    if (insn->opcode & I_DEF_CC) {
+        cc_insn = insn;
+        cc_known = 0;
+
+        if (((insn->opcode == I_CMP) || (insn->opcode == I_TEST))
+            && value_of(insn->operand[0], &cc_a)
+            && value_of(insn->operand[1], &cc_b) )
+        {
+            cc_size = size_of(insn->operand[0]->type);
+            if (insn->opcode == I_TEST) cc_a &= cc_b, cc_b = 0;
+            cc_known = 1;
+        }
+    }
+
+    if (insn_nr_defs(insn) == 0) return 0;
+    if (is_redundant(insn)) return 0;
+
+    if ((d = destination(insn)) != -1) {
+        if ((s = copy_source(insn)) != -1) {
+            if (kind_of(s) == V_CON) {
+                kind = V_CON;
+                value = values[s];
+            } else {
+                kind = V_COPY;
+                value = s;
+            }
+        } else if (compute(insn, &i)) {
+            kind = V_CON;
+            value = i;
+        }
+    }
+
+    for (n = 0; (n < NR_INSN_REGS) && (insn->regs_defd[n] != R_NONE); ++n) {
+        if ((c = candidate(insn->regs_defd[n])) == -1) continue;
+        set_state(c, V_BOTTOM, 0L);
+        kill_copies(c);
+    }
+
+    if (d != -1) set_state(d, kind, value);
+    return 0;
+}
+
+/* is a successor with condition 'cc' possibly taken,
+   given the condition codes at the end of the block? */
+
+static
+is_taken(cc)
+{
+    long sa, sb;
+    unsigned long ua, ub;
+
+    if (!cc_known || (cc == CC_ALWAYS) || CC_IS_TABLE(cc)) return 1;
+
+    sa = sign_extend(cc_a, cc_size);
+    sb = sign_extend(cc_b, cc_size);
+    ua = zero_extend(cc_a, cc_size);
+    ub = zero_extend(cc_b, cc_size);
+
+    switch (cc)
+    {
+    case CC_Z:      return (ua == ub);
+    case CC_NZ:     return (ua != ub);
+    case CC_G:      return (sa > sb);
+    case CC_LE:     return (sa <= sb);
+    case CC_GE:     return (sa >= sb);
+    case CC_L:      return (sa < sb);
+    case CC_A:      return (ua > ub);
+    case CC_BE:     return (ua <= ub);
+    case CC_AE:     return (ua >= ub);
+    case CC_B:      return (ua < ub);
+    default:        return 1;
+    }
+}
+
+/* simulate 'block' from its entry state. if 'f' is
+   given, it's called on each insn in lieu of transfer(). */
+
+static
+simulate(block, f)
+    struct block * block;
+    int         (* f)();
+{
+    struct insn * insn;
+    struct insn * next;
+    char        * in_k;
+    long        * in_v;
+    int           i;
+
+    in_k = in_kinds + (block->dfn * nr_globals);
+    in_v = in_values + (block->dfn * nr_globals);
+
+    for (i = 0; i < nr_globals; ++i) {
+        kinds[i] = in_k[i];
+        values[i] = in_v[i];
+    }
+
+    ++stamp;
+    cc_insn = NULL;
+    cc_known = 0;
+
+    for (i = 0; i < nr_globals; ++i)
+        if (kinds[i] == V_COPY) link_copy(i);
+
+    for (insn = block->first_insn; insn; insn = next) {
+        next = insn->next;
+
+        if (f)
+            f(block, insn);
+        else
+            transfer(insn);
+    }
+
+    return 0;
+}
+
+/* merge the current state into the entry state of 'block',
+   and mark it to be examined again if anything has changed. */
+
+static
+merge(block)
+    struct block * block;
+{
+    char * in_k;
+    long * in_v;
+    int    changes = 0;
+    int    i;
+
+    in_k = in_kinds + (block->dfn * nr_globals);
+    in_v = in_values + (block->dfn * nr_globals);
+
+    if (!reached[block->dfn]) {
+        reached[block->dfn] = 1;
+
+        for (i = 0; i < nr_globals; ++i) {
+            in_k[i] = kinds[i];
+            in_v[i] = values[i];
+        }
+
+        ++changes;
+    } else {
+        for (i = 0; i < nr_globals; ++i) {
+            if (kinds[i] == V_TOP) continue;
+            if (in_k[i] == V_BOTTOM) continue;
+
+            if (in_k[i] == V_TOP) {
+                in_k[i] = kinds[i];
+                in_v[i] = values[i];
+                ++changes;
+            } else if ((in_k[i] != kinds[i]) || (in_v[i] != values[i])) {
+                in_k[i] = V_BOTTOM;
+                ++changes;
+            }
+        }
+    }
+
+    if (changes) queued[block->dfn] = 1;
+    return 0;
+}
+
+/* solve the lattice. the blocks are swept in reverse postorder,
+   so everything settles after a few passes through the loops. */
+
+static
+solve()
+{
+    struct block * block;
+    struct block * successor;
+    int            changes;
+    int            i, n;
+
+    for (n = 0; n < nr_globals; ++n) {
+        in_kinds[entry_block->dfn * nr_globals + n] = V_BOTTOM;
+        in_values[entry_block->dfn * nr_globals + n] = 0;
+    }
+
+    reached[entry_block->dfn] = 1;
+    queued[entry_block->dfn] = 1;
+
+    do {
+        changes = 0;
+
+        for (i = 0; i < nr_blocks; ++i) {
+            if (!queued[i]) continue;
+            queued[i] = 0;
+            block = blocks[i];
+            simulate(block, NULL);
+
+            for (n = 0; successor = block_successor(block, n); ++n)
+                if (is_taken(block_successor_cc(block, n))) merge(successor);
+
+            ++changes;
+        }
+    } while (changes);
+
+    return 0;
+}
+
+/* the constant 'i', as an operand of the same type as 'tree' */
+
+static struct tree *
+con_tree(tree, i)
+    struct tree * tree;
+    long          i;
+{
+    struct tree * con;
+
+    con = new_tree(E_CON, copy_type(tree->type));
+    con->u.con.i = i;
+    return con;
+}
+
+/* can 'insn' take an immediate value 'i' as its source operand? */
+
+static
+takes_imm(insn, i)
+    struct insn * insn;
+    long          i;
+{
+    int size = size_of(insn->operand[0]->type);
+
+    /* only a register can be loaded with a full 64-bit immediate */
+
+    if ((insn->opcode == I_MOV) && (insn->operand[0]->op == E_REG)) return 1;
+
+    switch (insn->opcode)
+    {
+    case I_IMUL:    if (size == 1) return 0;
+    case I_MOV:
+    case I_ADD:
+    case I_SUB:
+    case I_AND:
+    case I_OR:
+    case I_XOR:
+    case I_CMP:
+    case I_TEST:    return ((size != 8) || (i == (int) i));
+    default:        return 0;
+    }
+}
+
+/* make the substitutions in 'insn' in 'block'.
+   the counterpart of transfer() for the rewriting pass. */
+
+static int changes;
+
+static
+rewrite(block, insn)
+    struct block * block;
+    struct insn  * insn;
+{
+    struct tree * tree;
+    long          i;
+    int           c, d, n;
+    int           touched = 0;
+
+    if (is_redundant(insn) && !(insn->flags & INSN_FLAG_CC)) {
+        kill_insn(block, insn);
+        ++changes;
+        return 0;
+    }
+
+    /* constant results become MOVs */
+
+    if (    (insn->opcode != I_MOV)
+        &&  ((d = destination(insn)) != -1)
+        &&  (insn_nr_defs(insn) == 1)
+        &&  !(insn->flags & INSN_FLAG_CC)
+        &&  compute(insn, &i) )
+    {
+        if (I_NR_OPERANDS(insn->opcode) == 2) free_tree(insn->operand[1]);
+        insn->opcode = I_MOV;
+        insn->operand[1] = con_tree(insn->operand[0], i);
+        ++touched;
+    }
+
+    /* substitute into the operands which are only USEd */
+
+    for (n = 0; n < I_NR_OPERANDS(insn->opcode); ++n) {
+        tree = insn->operand[n];
+
+        if (tree->op == E_MEM) {
+            if ((c = candidate(tree->u.mi.b)) != -1) {
+                if (kind_of(c) == V_COPY) {
+                    tree->u.mi.b = regs[values[c]];
+                    ++touched;
+                }
+            }
+
+            if ((c = candidate(tree->u.mi.i)) != -1) {
+                if ((kind_of(c) == V_CON) && (sizes[c] == 8) && !tree->u.mi.rip) {
+                    i = tree->u.mi.ofs + values[c] * tree->u.mi.s;
+
+                    if (i == (int) i) {
+                        tree->u.mi.ofs = i;
+                        tree->u.mi.i = R_NONE;
+                        tree->u.mi.s = 1;
+                        ++touched;
+                    }
+                } else if (kind_of(c) == V_COPY) {
+                    tree->u.mi.i = regs[values[c]];
+                    ++touched;
+                }
+            }
+
+            continue;
+        }
+
+        if (tree->op != E_REG) continue;
+        if (!(insn->opcode & I_USE(n))) continue;
+        if (insn->opcode & I_DEF(n)) continue;
+        if ((c = candidate(tree->u.reg)) == -1) continue;
+
+        if (    (n == 1)
+            &&  value_of(tree, &i)
+            &&  takes_imm(insn, i) )
+        {
+            insn->operand[n] = con_tree(tree, i);
+            free_tree(tree);
+            ++touched;
+        } else if (kind_of(c) == V_COPY) {
+            tree->u.reg = regs[values[c]];
+            ++touched;
+        }
+    }
+
+    if (touched) {
+        analyze_insn(insn);
+        ++changes;
+    }
+
+    transfer(insn);
+    return 0;
+}
+
+/* after rewriting 'block', remove the successors that can't be taken.
+   if the outcome is certain, the CMP or TEST that decided it goes too,
+   provided nothing else (e.g., a SETcc) is looking at the flags. */
+
+static
+fold(block)
+    struct block * block;
+{
+    struct block * successor;
+    struct insn  * insn;
+    int            cc;
+    int            taken = 0;
+    int            n;
+
+    if (!cc_known) return 0;
+
+    for (n = 0; successor = block_successor(block, n); ++n)
+        if (is_taken(block_successor_cc(block, n))) ++taken;
+
+    if ((taken == 0) || (taken == block->nr_successors)) return 0;
+
+    again:
+    for (n = 0; successor = block_successor(block, n); ++n) {
+        if (!is_taken(block_successor_cc(block, n))) {
+            unsucceed_block(block, n);
+            goto again;
+        }
+    }
+
+    if (block->nr_successors == 1) {
+        successor = block_successor(block, 0);
+        cc = block_successor_cc(block, 0);
+
+        if (cc != CC_ALWAYS) {
+            unsucceed_block(block, 0);
+            succeed_block(block, CC_ALWAYS, successor);
+        }
+
+        for (insn = cc_insn->next; insn; insn = insn->next)
+            if (insn->opcode & I_USE_CC) break;
+
+        if (insn == NULL) kill_insn(block, cc_insn);
+    }
+
+    ++changes;
+    return 0;
+}
+
+/* if 'block' unconditionally proceeds to a block that does nothing
+   but TEST or CMP, and we know the outcome given the state at the end
+   of 'block', then go straight to the appropriate successor. */
+
+static
+thread(block)
+    struct block * block;
+{
+    struct block * test;
+    struct block * successor;
+    struct block * target = NULL;
+    struct insn  * insn;
+    int            n;
+
+    if (block->nr_successors != 1) return 0;
+    if (block_successor_cc(block, 0) != CC_ALWAYS) return 0;
+    test = block_successor(block, 0);
+    if ((test == block) || (test->nr_insns != 1)) return 0;
+    insn = test->first_insn;
+    if ((insn->opcode != I_CMP) && (insn->opcode != I_TEST)) return 0;
+
+    transfer(insn);
+    if (!cc_known) return 0;
+
+    for (n = 0; successor = block_successor(test, n); ++n) {
+        if (is_taken(block_successor_cc(test, n))) {
+            if (target) return 0;
+            target = successor;
+        }
+    }
+
+    if (target) {
+        unsucceed_block(block, 0);
+        succeed_block(block, CC_ALWAYS, target);
+        ++changes;
+    }
+
+    return 0;
+}
+
+/* number the blocks reachable from 'block' in postorder */
+
+static
+order1(block)
+    struct block * block;
+{
+    struct block * successor;
+    int            n;
+
+    block->dfn = -2;
+
+    for (n = 0; successor = block_successor(block, n); ++n)
+        if (successor->dfn == -1) order1(successor);
+
+    block->dfn = nr_ordered++;
+    return 0;
+}
+
+/* assign candidate indices to the S_REGISTER pseudos in the def/use
+   data. if 'globals' is set, only those live into some block. */
+
+static
+number(globals)
+{
+    struct block  * block;
+    struct defuse * defuse;
+    int             s;
+
+    for (block = first_block; block; block = block->next) {
+        for (defuse = block->defuses; defuse; defuse = defuse->link) {
+            if (!(defuse->symbol->ss & S_REGISTER)) continue;
+            if (globals && !(defuse->dus & DU_IN)) continue;
+            if ((s = slot(defuse->symbol->reg)) == -1) continue;
+            if (indices[s] != -1) continue;
+
+            regs[nr_cands] = defuse->symbol->reg;
+            sizes[nr_cands] = size_of(defuse->symbol->type);
+            indices[s] = nr_cands++;
+        }
+    }
+
+    return 0;
+}
+
+propagate()
+{
+    struct block * block;
+    int            nr_slots;
+    int            cells;
+    int            i;
+
+    nr_blocks = 0;
+
+    for (block = first_block; block; block = block->next) {
+        block->dfn = -1;
+        ++nr_blocks;
+    }
+
+    nr_ordered = 0;
+    order1(entry_block);
+    i = nr_ordered;
+
+    for (block = first_block; block; block = block->next) {
+        if (block->dfn == -1)
+            block->dfn = nr_ordered++;
+        else
+            block->dfn = i - 1 - block->dfn;
+    }
+
+    nr_islots = R_IDX(next_iregister) - NR_REGS;
+    nr_fslots = R_IDX(next_fregister) - NR_REGS;
+    nr_slots = nr_islots + nr_fslots;
+    indices = (int *) allocate((nr_slots + 1) * sizeof(int));
+    regs = (int *) allocate((nr_slots + 1) * sizeof(int));
+    sizes = (int *) allocate((nr_slots + 1) * sizeof(int));
+    for (i = 0; i < nr_slots; ++i) indices[i] = -1;
+
+    nr_cands = 0;
+    number(1);
+    nr_globals = nr_cands;
+    number(0);
+
+    cells = nr_blocks * nr_globals;
+
+    if ((nr_cands == 0) || (cells > PROP_MAX_CELLS)) {
+        free(indices);
+        free(regs);
+        free(sizes);
+        return 0;
+    }
+
+    kinds = allocate(nr_cands);
+    values = (long *) allocate(nr_cands * sizeof(long));
+    stamps = (int *) allocate(nr_cands * sizeof(int));
+    heads = (int *) allocate(nr_cands * sizeof(int));
+    head_stamps = (int *) allocate(nr_cands * sizeof(int));
+    nexts = (int *) allocate(nr_cands * sizeof(int));
+    prevs = (int *) allocate(nr_cands * sizeof(int));
+    blocks = (struct block **) allocate(nr_blocks * sizeof(struct block *));
+    in_kinds = allocate(cells + 1);
+    in_values = (long *) allocate((cells + 1) * sizeof(long));
+    reached = allocate(nr_blocks);
+    queued = allocate(nr_blocks);
+
+    for (i = 0; i < nr_cands; ++i) {
+        stamps[i] = 0;
+        head_stamps[i] = 0;
+    }
+
+    for (i = 0; i < cells; ++i) in_kinds[i] = V_TOP;
+
+    for (block = first_block; block; block = block->next) {
+        blocks[block->dfn] = block;
+        reached[block->dfn] = 0;
+        queued[block->dfn] = 0;
+    }
+
+    stamp = 0;
+    solve();
+
+    changes = 0;
+
+    for (block = first_block; block; block = block->next) {
+        if (reached[block->dfn]) {
+            simulate(block, rewrite);
+            fold(block);
+            thread(block);
+        } else if ((block != exit_block) && block->nr_successors) {
+            /* dead code: cut it loose, and unreachable() will remove it */
+
+            while (block->nr_successors) unsucceed_block(block, 0);
+            ++changes;
+        }
+    }
+
+    free(indices);
+    free(regs);
+    free(sizes);
+    free(kinds);
+    free(values);
+    free(stamps);
+    free(heads);
+    free(head_stamps);
+    free(nexts);
+    free(prevs);
+    free(blocks);
+    free(in_kinds);
+    free(in_values);
+    free(reached);
+    free(queued);
+
+    return changes;
+}
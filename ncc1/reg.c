@@ -22,6 +22,7 @@
  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
+#include <stdlib.h>
 #include <string.h>
 #include "ncc1.h"
 
@@ -242,6 +243,186 @@ spill(block, defuse, before, dir)
     put_insn(block, insn, before);
 }
 
+/* might 'insn' read or write the memory which holds the aliased 'symbol'?
+   without optimization, we assume any memory access does. otherwise we
+   consult the alias oracle [alias.c]. LEA only computes an address, so
+   it's not an access at all. */
+
+static
+touches(insn, symbol)
+    struct insn   * insn;
+    struct symbol * symbol;
+{
+    int i;
+
+    if (!insn->mem_used && !insn->mem_defd) return 0;
+    if (!O_flag || (insn->opcode == I_CALL)) return 1;
+    if (insn->opcode == I_LEA) return 0;
+
+    for (i = 0; i < I_NR_OPERANDS(insn->opcode); i++)
+        if ((insn->operand[i]->op == E_MEM) && may_alias_symbol(insn->operand[i], symbol))
+            return 1;
+
+    return 0;
+}
+
+/* will the register holding the aliased 'symbol' be needed after 'insn'?
+   that is, is it USEd later in the block, before it's DEFd again and
+   before its memory might be written (which forces a reload anyway)? */
+
+static
+reused(insn, symbol)
+    struct insn   * insn;
+    struct symbol * symbol;
+{
+    for (insn = insn->next; insn; insn = insn->next) {
+        if (insn_uses_reg(insn, symbol->reg)) return 1;
+        if (insn_defs_reg(insn, symbol->reg)) return 0;
+        if (insn->mem_defd && touches(insn, symbol)) return 0;
+    }
+
+    return 0;
+}
+
+/* can operand 'i' of 'insn' be replaced with a memory operand? AMD64 permits
+   only one memory operand per instruction, and the other operand must be
+   a register, or an immediate that fits in 32 bits if 'i' is the target. */
+
+static
+takes_mem(insn, i)
+    struct insn * insn;
+{
+    struct tree * other = NULL;
+    int           size = size_of(insn->operand[i]->type);
+
+    if (I_NR_OPERANDS(insn->opcode) == 2) {
+        other = insn->operand[!i];
+
+        if (    (other->op != E_REG)
+            &&  !(  (i == 0) && (other->op == E_CON)
+                 && ((size != 8) || (other->u.con.i == (int) other->u.con.i)) ) )
+            return 0;
+    }
+
+    switch (insn->opcode)
+    {
+    case I_MOV:
+    case I_ADD:
+    case I_SUB:
+    case I_AND:
+    case I_OR:
+    case I_XOR:
+    case I_CMP:
+    case I_TEST:
+    case I_MOVSS:
+    case I_MOVSD:
+        return 1;
+
+    case I_MOVSX:
+    case I_MOVZX:
+    case I_IMUL:
+    case I_CVTSD2SI:
+    case I_CVTSI2SS:
+    case I_CVTSI2SD:
+    case I_CVTSS2SD:
+    case I_CVTSD2SS:
+    case I_ADDSS:
+    case I_ADDSD:
+    case I_SUBSS:
+    case I_SUBSD:
+    case I_MULSS:
+    case I_MULSD:
+    case I_DIVSS:
+    case I_DIVSD:
+    case I_UCOMISS:
+    case I_UCOMISD:
+        return (i == 1);
+
+    case I_SHL:
+    case I_SHR:
+    case I_SAR:
+        return (i == 0);
+
+    case I_PUSH:
+        return (size == 8);
+
+    case I_DIV:
+    case I_IDIV:
+    case I_INC:
+    case I_DEC:
+    case I_NEG:
+    case I_NOT:
+    case I_SETZ:
+    case I_SETNZ:
+    case I_SETG:
+    case I_SETLE:
+    case I_SETGE:
+    case I_SETL:
+    case I_SETA:
+    case I_SETBE:
+    case I_SETAE:
+    case I_SETB:
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* try to fuse the load or store of the aliased variable in 'defuse'
+   into 'insn', by replacing its register with its memory location.
+   this is only worthwhile if the register isn't needed afterward. */
+
+static
+fuse(insn, defuse)
+    struct insn   * insn;
+    struct defuse * defuse;
+{
+    struct symbol * symbol = defuse->symbol;
+    struct tree   * operand;
+    struct tree   * memory;
+    int             i, n;
+
+    /* the register must appear once, as an operand in its own right,
+       and the insn must not already have a memory operand. */
+
+    for (i = 0, n = -1; i < I_NR_OPERANDS(insn->opcode); i++) {
+        operand = insn->operand[i];
+        if (operand->op == E_MEM) return 0;
+        if ((operand->op == E_REG) && (operand->u.reg == symbol->reg)) {
+            if (n != -1) return 0;
+            n = i;
+        }
+    }
+
+    if (n == -1) return 0;
+    operand = insn->operand[n];
+    if (size_of(operand->type) > size_of(symbol->type)) return 0;
+
+    /* a load is fused only if the register doesn't hold the value yet; a
+       read-modify-write only if memory is up to date. a store must write
+       the whole variable, which makes the register contents moot. */
+
+    if (insn->opcode & I_DEF(n)) {
+        if (size_of(operand->type) != size_of(symbol->type)) return 0;
+        if ((insn->opcode & I_USE(n)) && (defuse->cache == DU_CACHE_DIRTY)) return 0;
+    } else if (defuse->cache != DU_CACHE_INVALID)
+        return 0;
+
+    if (!takes_mem(insn, n)) return 0;
+    if (reused(insn, symbol)) return 0;
+
+    memory = memory_tree(symbol);
+    free_type(memory->type);
+    memory->type = copy_type(operand->type);
+    insn->operand[n] = memory;
+    free_tree(operand);
+    analyze_insn(insn);
+
+    defuse->cache = DU_CACHE_INVALID;
+    return 1;
+}
+
 /* the second pass has three main responsibilities:
 
    1. to rewrite the pseudo-registers in each instruction with 
@@ -250,9 +431,11 @@ spill(block, defuse, before, dir)
       save/restore the callee-save registers, and
    3. insert appropriate memory accesses for aliased variables.
 
-   there's a lot of room for optimization here w/r/t #3. in particular,
-   in many cases a load or store could be fused with another instruction
-   (since AMD64 supports memory operands). TO-DO. */
+   with optimization, #3 is refined in two ways: a load or store is fused
+   into the instruction that consumes or produces the value when AMD64 can
+   encode it (see fuse()), and only memory accesses which might actually 
+   overlap an aliased variable's storage force it to be spilled or 
+   reloaded (see touches()). */
 
 static 
 rewrite(block)
@@ -262,7 +445,28 @@ rewrite(block)
     struct defuse * defuse;
     int             i;
 
+    /* a variable passing through a block is given a register there even
+       if it doesn't appear in any instruction, and reconcile() may load
+       it into that register, so it counts as used in this function too. */
+
+    for (defuse = block->defuses; defuse; defuse = defuse->link) {
+        if (defuse->reg == R_NONE) continue;
+
+        if (defuse->reg & R_IS_FLOAT)
+            save_fregs |= 1 << R_IDX(defuse->reg);
+        else
+            save_iregs |= 1 << R_IDX(defuse->reg);
+    }
+
     for (insn = block->first_insn; insn; insn = insn->next) {
+        if (O_flag) {
+            for (defuse = block->defuses; defuse; defuse = defuse->link) {
+                if (defuse->reg == R_NONE) continue;
+                if (defuse->symbol->ss & S_REGISTER) continue;
+                if (fuse(insn, defuse)) break;
+            }
+        }
+
         for (defuse = block->defuses; defuse; defuse = defuse->link) {
             if (defuse->reg == R_NONE) continue;
 
@@ -270,7 +474,7 @@ rewrite(block)
                 /* rules for aliased variables .. */
 
                 /* before a memory read or write (or I_CALL): DIRTY -> spill -> CLEAN */
-                if ((insn->mem_used || insn->mem_defd) && (defuse->cache == DU_CACHE_DIRTY)) {
+                if (touches(insn, defuse->symbol) && (defuse->cache == DU_CACHE_DIRTY)) {
                     spill(block, defuse, insn, SPILL_OUT);
                     defuse->cache = DU_CACHE_CLEAN;
                 }
@@ -285,7 +489,7 @@ rewrite(block)
                 if (insn_defs_reg(insn, defuse->symbol->reg)) defuse->cache = DU_CACHE_DIRTY;
 
                 /* after a memory write (or I_CALL), * -> INVALID */
-                if (insn->mem_defd) defuse->cache = DU_CACHE_INVALID;
+                if (insn->mem_defd && touches(insn, defuse->symbol)) defuse->cache = DU_CACHE_INVALID;
             } 
 
             /* if the register appears in this instruction, substitute
@@ -397,23 +601,879 @@ reconcile(from, n)
 
 }
 
-allocate_regs()
+/* the global allocator is used with -O2. rather than allocating registers
+   block-by-block, it builds an interference graph for the whole function 
+   and colors it, Chaitin/Briggs style: conservative coalescing of copies,
+   optimistic simplification, and spill costs weighted by loop_level. since
+   a symbol gets the same register everywhere, there's nothing to reconcile.
+
+   the nodes of the graph are the real registers (precolored) followed by
+   all the pseudo registers that appear in the def/use data. aliased symbols 
+   are included: rewrite() caches them in their registers from their first
+   appearance in a block until the end of the block, so that's their range. */
+
+#define NR_REAL_NODES       (NR_REGS * 2)
+#define REAL_BIT(reg)       (1 << (R_IDX(reg) + (((reg) & R_IS_FLOAT) ? NR_REGS : 0)))
+#define NODE_K(n)           ((nodes[n].reg & R_IS_FLOAT) ? NR_REGS : (NR_REGS - 2))
+#define LOOP_WEIGHT(b)      (1L << (3 * MIN((b)->loop_level, 7)))
+
+struct node
+{
+    struct symbol * symbol;     /* NULL for real registers */
+    int             reg;        /* register represented */
+    int             color;      /* real register assigned, or R_NONE */
+    int             alias;      /* node this was coalesced into (or itself) */
+    int             hint;       /* a move-related node, or -1 */
+    int             first_n;    /* first appearance in block (aliased) */
+    int             ns;         /* NS_* */
+    int             degree;
+    int             nr_adjs;
+    int             max_adjs;
+    int           * adjs;
+    long            cost;       /* weighted number of references */
+};
+
+#define NS_ALIASED      0x00000001      /* symbol isn't S_REGISTER */
+#define NS_SPILLTEMP    0x00000002      /* created by spill_node(): don't spill */
+#define NS_REMOVED      0x00000004      /* simplified out of the graph */
+
+struct move
+{
+    int             dst;
+    int             src;
+    long            weight;
+};
+
+static struct node  * nodes;
+static int            nr_nodes;
+static unsigned     * matrix;           /* triangular interference bit matrix */
+static unsigned     * live;             /* bitset of live nodes */
+static int            nr_words;         /* ... and its size */
+static int          * marks;            /* for de-duplicating neighbors */
+static int            stamp;
+static int          * inodes;           /* pseudo register -> node maps */
+static int          * fnodes;
+static int            ibase, ilimit;    /* ... and their ranges */
+static int            fbase, flimit;
+static struct move  * moves;
+static int            nr_moves;
+static int            max_moves;
+static int            spill_iregs;      /* registers numbered at/above these */
+static int            spill_fregs;      /* were created by spill_node() */
+static int            colored_regs;     /* REAL_BITs handed out so far */
+
+/* return the node index of 'reg', or -1 if it isn't in the graph. 
+   RBP and RSP are never allocated, so they're never in the graph. */
+
+static
+node_of(reg)
+{
+    int i = R_IDX(reg);
+
+    if ((reg == R_BP) || (reg == R_SP) || (reg == R_NONE)) return -1;
+    if (i < NR_REGS) return i + ((reg & R_IS_FLOAT) ? NR_REGS : 0);
+
+    if (reg & R_IS_FLOAT) {
+        if ((i >= fbase) && (i < flimit)) return fnodes[i - fbase];
+    } else {
+        if ((i >= ibase) && (i < ilimit)) return inodes[i - ibase];
+    }
+
+    return -1;
+}
+
+/* follow the coalescing chain to the representative node */
+
+static
+find_node(n)
+{
+    while (nodes[n].alias != n) n = nodes[n].alias;
+    return n;
+}
+
+static
+interferes(a, b)
+{
+    long bit;
+    int  t;
+
+    if (a == b) return 0;
+    if (a < b) { t = a; a = b; b = t; }
+    bit = (((long) a * (a - 1)) / 2) + b;
+    return (matrix[bit / 32] >> (bit % 32)) & 1;
+}
+
+/* add 'b' to the adjacency list of 'a'. we don't 
+   bother with lists for the real registers. */
+
+static
+adjacent(a, b)
+{
+    int * adjs;
+
+    if (a < NR_REAL_NODES) return 0;
+
+    if (nodes[a].nr_adjs == nodes[a].max_adjs) {
+        nodes[a].max_adjs = nodes[a].max_adjs ? (nodes[a].max_adjs * 2) : 8;
+        adjs = (int *) allocate(nodes[a].max_adjs * sizeof(int));
+
+        if (nodes[a].adjs) {
+            memcpy(adjs, nodes[a].adjs, nodes[a].nr_adjs * sizeof(int));
+            free(nodes[a].adjs);
+        }
+
+        nodes[a].adjs = adjs;
+    }
+
+    nodes[a].adjs[nodes[a].nr_adjs++] = b;
+    nodes[a].degree++;
+}
+
+/* record that nodes 'a' and 'b' interfere. registers of different 
+   classes never interfere, nor do the real registers with each other. */
+
+static
+interfere(a, b)
+{
+    long bit;
+    int  t;
+
+    if (a == b) return 0;
+    if ((nodes[a].reg ^ nodes[b].reg) & (R_IS_INTEGRAL | R_IS_FLOAT)) return 0;
+    if ((a < NR_REAL_NODES) && (b < NR_REAL_NODES)) return 0;
+    if (interferes(a, b)) return 0;
+
+    if (a < b) { t = a; a = b; b = t; }
+    bit = (((long) a * (a - 1)) / 2) + b;
+    matrix[bit / 32] |= 1 << (bit % 32);
+
+    adjacent(a, b);
+    adjacent(b, a);
+}
+
+/* give the pseudo register of 'symbol' a node, if it doesn't have one */
+
+static
+new_node(symbol)
+    struct symbol * symbol;
+{
+    int n;
+    int i = R_IDX(symbol->reg);
+
+    if (node_of(symbol->reg) != -1) return 0;
+
+    n = nr_nodes++;
+    nodes[n].symbol = symbol;
+    nodes[n].reg = symbol->reg;
+    nodes[n].ns = 0;
+
+    if (!(symbol->ss & S_REGISTER)) nodes[n].ns |= NS_ALIASED;
+
+    if (symbol->reg & R_IS_FLOAT) {
+        fnodes[i - fbase] = n;
+        if (i >= spill_fregs) nodes[n].ns |= NS_SPILLTEMP;
+    } else {
+        inodes[i - ibase] = n;
+        if (i >= spill_iregs) nodes[n].ns |= NS_SPILLTEMP;
+    }
+}
+
+/* widen the range [*base, *limit) to include 'i' */
+
+static
+range(base, limit, i)
+    int * base;
+    int * limit;
+{
+    if (*base == *limit) {
+        *base = i;
+        *limit = i + 1;
+    } else {
+        if (i < *base) *base = i;
+        if (i >= *limit) *limit = i + 1;
+    }
+}
+
+/* allocate and initialize the nodes of the graph */
+
+static
+new_graph()
+{
+    struct block  * block;
+    struct defuse * defuse;
+    int             i;
+    long            bits;
+
+    ibase = ilimit = fbase = flimit = 0;
+
+    for (block = first_block; block; block = block->next) 
+        for (defuse = block->defuses; defuse; defuse = defuse->link) {
+            if (defuse->symbol->reg & R_IS_FLOAT)
+                range(&fbase, &flimit, R_IDX(defuse->symbol->reg));
+            else
+                range(&ibase, &ilimit, R_IDX(defuse->symbol->reg));
+        }
+
+    inodes = (int *) allocate((ilimit - ibase + 1) * sizeof(int));
+    fnodes = (int *) allocate((flimit - fbase + 1) * sizeof(int));
+    for (i = ibase; i < ilimit; i++) inodes[i - ibase] = -1;
+    for (i = fbase; i < flimit; i++) fnodes[i - fbase] = -1;
+
+    nr_nodes = NR_REAL_NODES + (ilimit - ibase) + (flimit - fbase);
+    nodes = (struct node *) allocate(nr_nodes * sizeof(struct node));
+    
+    for (i = 0; i < nr_nodes; i++) {
+        nodes[i].symbol = NULL;
+        nodes[i].color = R_NONE;
+        nodes[i].alias = i;
+        nodes[i].hint = -1;
+        nodes[i].first_n = 0;
+        nodes[i].ns = 0;
+        nodes[i].degree = 0;
+        nodes[i].nr_adjs = 0;
+        nodes[i].max_adjs = 0;
+        nodes[i].adjs = NULL;
+        nodes[i].cost = 0;
+    }
+
+    for (i = 0; i < NR_REGS; i++) {
+        nodes[i].reg = nodes[i].color = R_AX + i;
+        nodes[NR_REGS + i].reg = nodes[NR_REGS + i].color = R_XMM0 + i;
+    }
+
+    nr_nodes = NR_REAL_NODES;
+
+    for (block = first_block; block; block = block->next) 
+        for (defuse = block->defuses; defuse; defuse = defuse->link) 
+            new_node(defuse->symbol);
+
+    bits = ((long) nr_nodes * (nr_nodes - 1)) / 2;
+    matrix = (unsigned *) allocate(((bits / 32) + 1) * sizeof(unsigned));
+    memset(matrix, 0, ((bits / 32) + 1) * sizeof(unsigned));
+
+    nr_words = (nr_nodes / 32) + 1;
+    live = (unsigned *) allocate(nr_words * sizeof(unsigned));
+    marks = (int *) allocate(nr_nodes * sizeof(int));
+    for (i = 0; i < nr_nodes; i++) marks[i] = 0;
+    stamp = 0;
+
+    nr_moves = 0;
+    max_moves = 0;
+    moves = NULL;
+}
+
+static
+free_graph()
+{
+    int i;
+
+    for (i = 0; i < nr_nodes; i++) 
+        if (nodes[i].adjs) free(nodes[i].adjs);
+
+    free(nodes);
+    free(matrix);
+    free(live);
+    free(marks);
+    free(inodes);
+    free(fnodes);
+    if (moves) free(moves);
+}
+
+/* compute the liveness of the real registers. there aren't many
+   of them, so this is simple. the exit block USEs the return value. */
+
+static
+live_reals()
 {
     struct block * block;
-    int            n;
+    struct block * successor;
+    struct insn  * insn;
+    int            changes;
+    int            in, out;
+    int            i, n;
+
+    for (block = first_block; block; block = block->next) {
+        block->reals_used = 0;
+        block->reals_defd = 0;
+        block->reals_in = 0;
+        block->reals_out = 0;
+
+        for (insn = block->first_insn; insn; insn = insn->next) {
+            for (i = 0; (i < NR_INSN_REGS) && insn->regs_used[i]; i++) {
+                n = insn->regs_used[i];
+                if (R_IS_PSEUDO(n) || (node_of(n) == -1)) continue;
+                if (!(block->reals_defd & REAL_BIT(n))) block->reals_used |= REAL_BIT(n);
+            }
+
+            for (i = 0; (i < NR_INSN_REGS) && insn->regs_defd[i]; i++) {
+                n = insn->regs_defd[i];
+                if (R_IS_PSEUDO(n) || (node_of(n) == -1)) continue;
+                block->reals_defd |= REAL_BIT(n);
+            }
+        }
+    }
+
+    exit_block->reals_out = REAL_BIT(R_AX) | REAL_BIT(R_XMM0);
+    exit_block->reals_in = exit_block->reals_out;
+
+    do {
+        changes = 0;
+
+        for (block = last_block; block; block = block->previous) {
+            out = block->reals_out;
+            for (n = 0; successor = block_successor(block, n); ++n) out |= successor->reals_in;
+            in = block->reals_used | (out & ~block->reals_defd);
+
+            if ((in != block->reals_in) || (out != block->reals_out)) {
+                block->reals_in = in;
+                block->reals_out = out;
+                changes++;
+            }
+        }
+    } while (changes);
+}
 
-    /* repeat register allocation until it succeeds (no splits required) */
+#define LIVE_SET(n)     (live[(n) / 32] |= (1 << ((n) % 32)))
+#define LIVE_CLR(n)     (live[(n) / 32] &= ~(1 << ((n) % 32)))
+
+/* node 'n' interferes with everything that's live */
+
+static
+interfere_live(n, except)
+{
+    int      w, b;
+    unsigned bits;
+
+    for (w = 0; w < nr_words; w++) 
+        for (bits = live[w], b = 0; bits; bits >>= 1, b++) 
+            if ((bits & 1) && ((w * 32 + b) != except))
+                interfere(n, w * 32 + b);
+}
+
+/* if 'insn' is a register-to-register copy between unaliased registers of 
+   the same class and size, return non-zero and set 'dst' and 'src'. */
+
+static
+is_move(insn, dst, src)
+    struct insn * insn;
+    int         * dst;
+    int         * src;
+{
+    if ((insn->opcode != I_MOV) && (insn->opcode != I_MOVSS) && (insn->opcode != I_MOVSD)) return 0;
+    if (insn->operand[0]->op != E_REG) return 0;
+    if (insn->operand[1]->op != E_REG) return 0;
+    if (size_of(insn->operand[0]->type) != size_of(insn->operand[1]->type)) return 0;
+
+    *dst = node_of(insn->operand[0]->u.reg);
+    *src = node_of(insn->operand[1]->u.reg);
+
+    if ((*dst == -1) || (*src == -1) || (*dst == *src)) return 0;
+    if ((nodes[*dst].ns | nodes[*src].ns) & NS_ALIASED) return 0;
+    if ((nodes[*dst].reg ^ nodes[*src].reg) & (R_IS_INTEGRAL | R_IS_FLOAT)) return 0;
+
+    return 1;
+}
+
+static
+add_move(dst, src, weight)
+    long weight;
+{
+    struct move * tmp;
+
+    if (nr_moves == max_moves) {
+        max_moves = max_moves ? (max_moves * 2) : 32;
+        tmp = (struct move *) allocate(max_moves * sizeof(struct move));
+
+        if (moves) {
+            memcpy(tmp, moves, nr_moves * sizeof(struct move));
+            free(moves);
+        }
+
+        moves = tmp;
+    }
+
+    moves[nr_moves].dst = dst;
+    moves[nr_moves].src = src;
+    moves[nr_moves].weight = weight;
+    nr_moves++;
+
+    if (nodes[dst].hint == -1) nodes[dst].hint = src;
+    if (nodes[src].hint == -1) nodes[src].hint = dst;
+}
+
+/* build the interference graph for one block, by walking backwards 
+   from the end of the block, starting with what's live out. */
+
+static
+build_block(block)
+    struct block * block;
+{
+    struct defuse * defuse;
+    struct insn   * insn;
+    long            weight;
+    int             dst, src;
+    int             i, j, n;
+
+    weight = LOOP_WEIGHT(block);
+    for (i = 0; i < nr_words; i++) live[i] = 0;
+
+    for (defuse = block->defuses; defuse; defuse = defuse->link) {
+        n = node_of(defuse->symbol->reg);
+
+        if (nodes[n].ns & NS_ALIASED) {
+            if (!DU_TRANSIT(*defuse)) {
+                nodes[n].first_n = defuse->first_n;
+                LIVE_SET(n);
+            }
+        } else if (defuse->dus & DU_OUT) 
+            LIVE_SET(n);
+    }
+
+    for (i = 0; i < NR_REAL_NODES; i++) 
+        if (block->reals_out & (1 << i)) LIVE_SET(i);
+
+    for (insn = block->last_insn; insn; insn = insn->previous) {
+        src = -1;
+        if (is_move(insn, &dst, &src)) add_move(dst, src, weight);
+
+        for (i = 0; (i < NR_INSN_REGS) && insn->regs_defd[i]; i++) {
+            if ((n = node_of(insn->regs_defd[i])) == -1) continue;
+            nodes[n].cost += weight;
+            interfere_live(n, src);
+
+            for (j = 0; (j < NR_INSN_REGS) && insn->regs_defd[j]; j++) 
+                if ((j != i) && (node_of(insn->regs_defd[j]) != -1))
+                    interfere(n, node_of(insn->regs_defd[j]));
+        }
+
+        for (i = 0; (i < NR_INSN_REGS) && insn->regs_defd[i]; i++) {
+            if ((n = node_of(insn->regs_defd[i])) == -1) continue;
+            if (!(nodes[n].ns & NS_ALIASED)) LIVE_CLR(n);
+        }
+
+        for (i = 0; (i < NR_INSN_REGS) && insn->regs_used[i]; i++) {
+            if ((n = node_of(insn->regs_used[i])) == -1) continue;
+            nodes[n].cost += weight;
+            LIVE_SET(n);
+        }
+
+        /* an aliased register may be (re)loaded right before any 
+           USE, so it interferes with everything live at that point. */
+
+        for (i = 0; (i < NR_INSN_REGS) && insn->regs_used[i]; i++) {
+            if ((n = node_of(insn->regs_used[i])) == -1) continue;
+            if (nodes[n].ns & NS_ALIASED) interfere_live(n, -1);
+        }
+
+        for (i = 0; i < NR_INSN_REGS; i++) {
+            if ((n = node_of(insn->regs_used[i])) != -1)
+                if ((nodes[n].ns & NS_ALIASED) && (nodes[n].first_n == insn->n)) LIVE_CLR(n);
+            if ((n = node_of(insn->regs_defd[i])) != -1)
+                if ((nodes[n].ns & NS_ALIASED) && (nodes[n].first_n == insn->n)) LIVE_CLR(n);
+        }
+    }
+
+    /* the values live out of the entry block are all loaded 
+       there (see entry_loads()), so they all interfere. */
+
+    if (block == entry_block) 
+        for (n = 0; n < nr_nodes; n++) 
+            if (live[n / 32] & (1 << (n % 32))) 
+                interfere_live(n, -1);
+}
+
+/* merge node 'b' into node 'a' */
+
+static
+merge_nodes(a, b)
+{
+    int i, t;
+
+    nodes[b].alias = a;
+    nodes[a].cost += nodes[b].cost;
+    ++stamp;
+
+    for (i = 0; i < nodes[b].nr_adjs; i++) {
+        t = find_node(nodes[b].adjs[i]);
+        if ((t == a) || (marks[t] == stamp)) continue;
+        marks[t] = stamp;
+
+        if (interferes(a, t)) 
+            nodes[t].degree--;
+        else {
+            interfere(a, t);
+            nodes[t].degree--;
+        }
+    }
+}
+
+/* Briggs' conservative test: it's safe to coalesce 'a' and 'b' if the
+   combined node would have fewer than K neighbors of significant degree. */
+
+static
+briggs(a, b)
+{
+    int i, t, x;
+    int count = 0;
+
+    ++stamp;
+
+    for (x = a; x != -1; x = (x == a) ? b : -1) {
+        for (i = 0; i < nodes[x].nr_adjs; i++) {
+            t = find_node(nodes[x].adjs[i]);
+            if ((t == a) || (t == b) || (marks[t] == stamp)) continue;
+            marks[t] = stamp;
+            if ((t < NR_REAL_NODES) || (nodes[t].degree >= NODE_K(t))) count++;
+        }
+    }
+
+    return (count < NODE_K(a));
+}
+
+static
+heavier(a, b)
+    struct move * a;
+    struct move * b;
+{
+    if (a->weight > b->weight) return -1;
+    if (a->weight < b->weight) return 1;
+    return 0;
+}
+
+/* coalesce move-related pseudo registers, heaviest moves first. moves
+   involving real registers are left alone; they're just hints for select. */
+
+static
+coalesce()
+{
+    int i, a, b;
+
+    qsort(moves, nr_moves, sizeof(struct move), heavier);
+
+    for (i = 0; i < nr_moves; i++) {
+        a = find_node(moves[i].dst);
+        b = find_node(moves[i].src);
+
+        if (a == b) continue;
+        if ((a < NR_REAL_NODES) || (b < NR_REAL_NODES)) continue;
+        if ((nodes[a].ns | nodes[b].ns) & NS_SPILLTEMP) continue;
+        if (interferes(a, b)) continue;
+        if (!briggs(a, b)) continue;
+
+        merge_nodes(a, b);
+    }
+}
+
+/* remove node 'n' from the graph, and push it on the stack */
+
+static
+simplify_node(n, stack, sp)
+    int * stack;
+    int * sp;
+{
+    int i, t;
+
+    nodes[n].ns |= NS_REMOVED;
+    stack[(*sp)++] = n;
+    ++stamp;
+
+    for (i = 0; i < nodes[n].nr_adjs; i++) {
+        t = find_node(nodes[n].adjs[i]);
+        if (marks[t] == stamp) continue;
+        marks[t] = stamp;
+        nodes[t].degree--;
+    }
+}
+
+/* pick a color for node 'n', given the colors 'taken' by its neighbors.
+   in order of preference: the color of a move-related node, a register
+   the caller saves (a scratch register), a register we already have to save,
+   and anything else. returns R_NONE if there's nothing available. */
+
+static
+pick_color(n, taken)
+{
+    int base = (nodes[n].reg & R_IS_FLOAT) ? R_XMM0 : R_AX;
+    int shift = (nodes[n].reg & R_IS_FLOAT) ? NR_REGS : 0;
+    int free_regs;
+    int prefer;
+    int h;
+    int i;
+
+    free_regs = ((1 << NR_REGS) - 1) & ~taken;
+    if (!(nodes[n].reg & R_IS_FLOAT)) free_regs &= ~((1 << R_IDX(R_BP)) | (1 << R_IDX(R_SP)));
+    if (free_regs == 0) return R_NONE;
+
+    if ((h = nodes[n].hint) != -1) {
+        h = find_node(h);
+        if ((nodes[h].color != R_NONE) && (free_regs & (1 << R_IDX(nodes[h].color))))
+            return nodes[h].color;
+    }
+
+    if (nodes[n].reg & R_IS_FLOAT)
+        prefer = scratch_fregs;
+    else
+        prefer = scratch_iregs;
+
+    if (!(free_regs & prefer)) prefer = (colored_regs >> shift) & ((1 << NR_REGS) - 1);
+    if (free_regs & prefer) free_regs &= prefer;
+
+    for (i = 0; !(free_regs & (1 << i)); i++) ;
+    colored_regs |= 1 << (i + shift);
+    return base + i;
+}
+
+/* simplify the graph, then select colors. returns the number of 
+   nodes that couldn't be colored (which are marked R_NONE). */
+
+static
+color_graph()
+{
+    int * stack;
+    int   sp = 0;
+    int   remaining = 0;
+    int   spills = 0;
+    int   found;
+    int   n, i, t;
+    int   taken;
+    int   best;
+
+    stack = (int *) allocate(nr_nodes * sizeof(int));
+
+    for (n = NR_REAL_NODES; n < nr_nodes; n++) 
+        if (find_node(n) == n) remaining++;
+
+    while (remaining) {
+        found = 0;
+
+        for (n = NR_REAL_NODES; n < nr_nodes; n++) {
+            if ((find_node(n) != n) || (nodes[n].ns & NS_REMOVED)) continue;
+
+            if (nodes[n].degree < NODE_K(n)) {
+                simplify_node(n, stack, &sp);
+                remaining--;
+                found++;
+            }
+        }
+
+        if (found) continue;
+
+        /* everyone left is of significant degree. pick the one with the
+           lowest cost/degree ratio, and optimistically push it anyway. */
+
+        best = -1;
+
+        for (n = NR_REAL_NODES; n < nr_nodes; n++) {
+            if ((find_node(n) != n) || (nodes[n].ns & NS_REMOVED)) continue;
+
+            if (    (best == -1) 
+                ||  ((nodes[best].ns & NS_SPILLTEMP) && !(nodes[n].ns & NS_SPILLTEMP))
+                ||  (   !((nodes[best].ns ^ nodes[n].ns) & NS_SPILLTEMP)
+                     && ((nodes[n].cost * nodes[best].degree) < (nodes[best].cost * nodes[n].degree))) )
+                best = n;
+        }
+
+        simplify_node(best, stack, &sp);
+        remaining--;
+    }
+
+    while (sp) {
+        n = stack[--sp];
+        taken = 0;
+
+        for (i = 0; i < nodes[n].nr_adjs; i++) {
+            t = find_node(nodes[n].adjs[i]);
+            if (nodes[t].color != R_NONE) taken |= 1 << R_IDX(nodes[t].color);
+        }
+
+        nodes[n].color = pick_color(n, taken);
+
+        if (nodes[n].color == R_NONE) {
+            if (nodes[n].ns & NS_SPILLTEMP) error(ERROR_INTERNAL);
+            spills++;
+        }
+    }
+
+    free(stack);
+    return spills;
+}
+
+/* spill a symbol: each instruction that references it gets a brand-new 
+   temporary, loaded from memory before a USE and stored after a DEF. */
+
+static
+spill_symbol(symbol)
+    struct symbol * symbol;
+{
+    struct block * block;
+    struct insn  * insn;
+    struct insn  * next;
+    struct insn  * new;
+    int            opcode;
+    int            reg;
+
+    opcode = I_MOV;
+    if (symbol->type->ts & T_FLOAT) opcode = I_MOVSS;
+    if (symbol->type->ts & T_LFLOAT) opcode = I_MOVSD;
+
+    for (block = first_block; block; block = block->next) {
+        for (insn = block->first_insn; insn; insn = next) {
+            next = insn->next;
+            if (!insn_touches_reg(insn, symbol->reg)) continue;
+
+            reg = symbol_reg(temporary_symbol(copy_type(symbol->type)));
+
+            if (insn_uses_reg(insn, symbol->reg)) {
+                new = new_insn(opcode, reg_tree(reg, copy_type(symbol->type)), memory_tree(symbol));
+                put_insn(block, new, insn);
+                analyze_insn(new);
+            }
+
+            if (insn_defs_reg(insn, symbol->reg)) {
+                new = new_insn(opcode, memory_tree(symbol), reg_tree(reg, copy_type(symbol->type)));
+                put_insn(block, new, next);
+                analyze_insn(new);
+            }
+
+            insn_replace_reg(insn, symbol->reg, reg);
+            analyze_insn(insn);
+        }
+    }
+}
+
+/* allocate registers for the whole function by coloring. */
+
+static
+color_regs()
+{
+    struct block  * block;
+    struct defuse * defuse;
+    int             n;
+
+    spill_iregs = R_IDX(next_iregister);
+    spill_fregs = R_IDX(next_fregister);
+    colored_regs = 0;
 
   restart:
     sequence_blocks();
     compute_global_defuses();
+    new_graph();
+    live_reals();
 
-    for (block = first_block; block; block = block->next) {
-        if (!select_regs(block)) {
-            split_block(block);
-            goto restart;
-        }
+    for (block = first_block; block; block = block->next) build_block(block);
+
+    coalesce();
+
+    if (color_graph()) {
+        for (n = NR_REAL_NODES; n < nr_nodes; n++) 
+            if (nodes[find_node(n)].color == R_NONE)
+                spill_symbol(nodes[n].symbol);
+
+        free_graph();
+        goto restart;
+    }
+
+    for (block = first_block; block; block = block->next) 
+        for (defuse = block->defuses; defuse; defuse = defuse->link) 
+            defuse->reg = nodes[find_node(node_of(defuse->symbol->reg))].color;
+
+    free_graph();
+}
+
+/* after coloring, coalesced copies are now copies 
+   of a register to itself. get rid of them. */
+
+static
+self_moves(block)
+    struct block * block;
+{
+    struct insn * insn;
+    struct insn * next;
+
+    for (insn = block->first_insn; insn; insn = next) {
+        next = insn->next;
+
+        if ((insn->opcode != I_MOV) && (insn->opcode != I_MOVSS) && (insn->opcode != I_MOVSD)) continue;
+        if (insn->operand[0]->op != E_REG) continue;
+        if (insn->operand[1]->op != E_REG) continue;
+        if (insn->operand[0]->u.reg != insn->operand[1]->u.reg) continue;
+        if (size_of(insn->operand[0]->type) != size_of(insn->operand[1]->type)) continue;
+
+        kill_insn(block, insn);
     }
+}
+
+/* with the global allocator, the only values that must be loaded
+   on entry to the function are the unaliased formal arguments. */
+
+static
+entry_loads()
+{
+    struct block  * loads;
+    struct block  * to;
+    struct defuse * defuse;
+
+    loads = new_block();
+    loads->bs |= B_RECON;
+
+    for (defuse = entry_block->defuses; defuse; defuse = defuse->link) {
+        if (!(defuse->dus & DU_OUT)) continue;
+        if (!(defuse->symbol->ss & S_REGISTER)) continue;
+        if (defuse->symbol->i <= 0) continue;
+        spill(loads, defuse, NULL, SPILL_IN);
+    }
+
+    if (loads->nr_insns) {
+        to = block_successor(entry_block, 0);
+        unsucceed_block(entry_block, 0);
+        succeed_block(entry_block, CC_ALWAYS, loads);
+        succeed_block(loads, CC_ALWAYS, to);
+    } else
+        free_block(loads);
+}
+
+/* the block-by-block allocator. repeat until it succeeds (no splits
+   required). the def/use data must be recomputed after splitting, so
+   every block that fails in a pass is split before starting over: one
+   at a time, a long function would be analyzed once for every split.
+   the new halves are at the end of the list, and wait for the next pass,
+   in which every block again inherits registers from its predecessors. */
+
+static
+local_regs()
+{
+    struct block * block;
+    struct block * last;
+    int            splits;
+
+    do {
+        sequence_blocks();
+        compute_global_defuses();
+        last = last_block;
+        splits = 0;
+
+        for (block = first_block; block; block = block->next) block->bs &= ~B_REG;
+
+        for (block = first_block; block; block = block->next) {
+            if (!select_regs(block)) {
+                split_block(block);
+                ++splits;
+            }
+
+            if (block == last) break;
+        }
+    } while (splits);
+}
+
+allocate_regs()
+{
+    struct block * block;
+    int            n;
+
+    if (O_flag > 1)
+        color_regs();
+    else
+        local_regs();
 
     /* rewrite blocks with the chosen registers and record
        which registers the callee needs to save. */
@@ -423,15 +1483,20 @@ allocate_regs()
 
     for (block = first_block; block; block = block->next) rewrite(block);
 
-    save_iregs &= ~((1 << R_IDX(R_AX)) | (1 << R_IDX(R_CX)) | (1 << R_IDX(R_DX)));
+    save_iregs &= ~scratch_iregs;
     save_iregs &= ~((1 << R_IDX(R_BP)) | (1 << R_IDX(R_SP)));
-    save_fregs &= ~(1 << R_IDX(R_XMM0));
+    save_fregs &= ~scratch_fregs;
 
-    /* finally, reconcile each block's registers with its successors'. */
+    if (O_flag > 1) {
+        for (block = first_block; block; block = block->next) self_moves(block);
+        entry_loads();
+    } else {
+        /* finally, reconcile each block's registers with its successors'. */
 
-    for (block = first_block; block; block = block->next) {
-        if (block->bs & B_RECON) continue;
-        for (n = 0; block_successor(block, n); ++n) reconcile(block, n);
+        for (block = first_block; block; block = block->next) {
+            if (block->bs & B_RECON) continue;
+            for (n = 0; block_successor(block, n); ++n) reconcile(block, n);
+        }
     }
 
     sequence_blocks();
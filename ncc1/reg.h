@@ -71,3 +71,12 @@
 #define R_XMM14         (R_IS_FLOAT | 14)
 #define R_XMM15         (R_IS_FLOAT | 15)
 #define R_FPSEUDO       (R_IS_FLOAT | NR_REGS)
+
+/* under -mregparm, the first NR_IARG_REGS integral arguments to a function
+   are passed in iarg_regs[], and the first NR_FARG_REGS floating-point 
+   arguments in XMM0 and up. these registers join AX, CX, DX and XMM0 as
+   scratch registers (see scratch_iregs and scratch_fregs), i.e., they're
+   not preserved across calls. */
+
+#define NR_IARG_REGS    6
+#define NR_FARG_REGS    4
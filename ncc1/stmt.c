@@ -97,6 +97,7 @@ while_statement()
     saved_continue_block = continue_block;
     saved_break_block = break_block;
 
+    ++loop_level;
     test_block = new_block();
     body_block = new_block();
     break_block = new_block();
@@ -118,7 +119,9 @@ while_statement()
     body_block = current_block;
     succeed_block(body_block, CC_ALWAYS, test_block);
 
+    --loop_level;
     current_block = break_block;
+    current_block->loop_level = loop_level;
     continue_block = saved_continue_block;
     break_block = saved_break_block;
 }
@@ -134,6 +137,7 @@ do_statement()
 
     saved_continue_block = continue_block;
     saved_break_block = break_block;
+    ++loop_level;
     continue_block = new_block();
     break_block = new_block();
     body_block = new_block();
@@ -154,7 +158,9 @@ do_statement()
     succeed_block(current_block, cc, body_block);
     succeed_block(current_block, CC_INVERT(cc), break_block);
 
+    --loop_level;
     current_block = break_block;
+    current_block->loop_level = loop_level;
     continue_block = saved_continue_block;
     break_block = saved_break_block;
 }
@@ -197,6 +203,7 @@ for_statement()
 
     saved_continue_block = continue_block;
     saved_break_block = break_block;
+    ++loop_level;
     test_block = new_block();
     body_block = new_block();
     continue_block = new_block();
@@ -230,7 +237,9 @@ for_statement()
     if (step) generate(step, GOAL_EFFECT, NULL);
     succeed_block(current_block, CC_ALWAYS, test_block);
     
+    --loop_level;
     current_block = break_block;
+    current_block->loop_level = loop_level;
     continue_block = saved_continue_block;
     break_block = saved_break_block;
 }
@@ -289,6 +298,240 @@ goto_statement()
     current_block = new_block();
 }
 
+/* switch statements are lowered after their bodies are parsed, once all
+   the cases are known. the cases are sorted by value and grouped greedily
+   into clusters: runs of cases dense enough to warrant a jump table (see
+   SWITCH_TABLE_* in ncc1.h), and single cases. the clusters are then
+   dispatched by a balanced binary search on the switch value in AX, with
+   short runs of single cases tested linearly at the leaves. */
+
+struct cluster
+{
+    int first;          /* index of first case in cluster */
+    int last;           /* index of last case in cluster */
+    int table;          /* non-zero if dispatched through a jump table */
+};
+
+/* compare two case values, for qsort(). the ordering depends on the
+   signedness of the controlling expression. */
+
+static
+compare_cases(p1, p2)
+    struct switchcase ** p1;
+    struct switchcase ** p2;
+{
+    long i1;
+    long i2;
+
+    i1 = (*p1)->value->u.con.i;
+    i2 = (*p2)->value->u.con.i;
+
+    if (switch_type->ts & T_IS_UNSIGNED) {
+        if ((unsigned long) i1 < (unsigned long) i2) return -1;
+        if ((unsigned long) i1 > (unsigned long) i2) return 1;
+    } else {
+        if (i1 < i2) return -1;
+        if (i1 > i2) return 1;
+    }
+
+    return 0;
+}
+
+/* emit a jump table for the cases cases[first] through cases[last].
+   the switch value is widened into an index register, biased to zero
+   and bounds-checked before the indirect jump. each table entry is a
+   successor of the dispatching block, with the CC_TABLE() of its slot.
+
+   the entries are the targets' offsets from the table, not addresses,
+   so the text needs no relocation: the entry is fetched (into the index
+   register, since the index isn't needed after) and added to the table
+   address to find the target. */
+
+static
+switch_table(reg_ax, cases, first, last)
+    struct tree        * reg_ax;
+    struct switchcase ** cases;
+{
+    struct tree   * index;
+    struct tree   * base;
+    struct tree   * tree;
+    struct symbol * table;
+    struct block  * table_block;
+    long            lo;
+    long            n;
+    long            i;
+    int             opcode;
+
+    lo = cases[first]->value->u.con.i;
+    n = (cases[last]->value->u.con.i - lo) + 1;
+
+    if (switch_type->ts & T_IS_LONG) 
+        opcode = I_MOV;
+    else if (switch_type->ts & T_IS_UNSIGNED)
+        opcode = I_MOVZX;
+    else
+        opcode = I_MOVSX;
+
+    index = reg_tree(symbol_reg(temporary_symbol(new_type(T_LONG))), new_type(T_LONG));
+    put_insn(current_block, new_insn(opcode, copy_tree(index), copy_tree(reg_ax)), NULL);
+    if (lo) put_insn(current_block, new_insn(I_SUB, copy_tree(index), int_tree(T_LONG, lo)), NULL);
+    put_insn(current_block, new_insn(I_CMP, copy_tree(index), int_tree(T_LONG, n - 1)), NULL);
+    succeed_block(current_block, CC_A, default_block);
+    succeed_block(current_block, CC_BE, table_block = new_block());
+    current_block = table_block;
+
+    table = new_symbol(NULL, S_STATIC, new_type(T_LONG));
+    table->i = next_asm_label++;
+    put_symbol(table, SCOPE_RETIRED);
+
+    base = reg_tree(symbol_reg(temporary_symbol(new_type(T_LONG))), new_type(T_LONG));
+    put_insn(current_block, new_insn(I_LEA, copy_tree(base), memory_tree(table)), NULL);
+
+    tree = new_tree(E_MEM, new_type(T_INT));
+    tree->u.mi.b = base->u.reg;
+    tree->u.mi.i = index->u.reg;
+    tree->u.mi.s = 4;
+    put_insn(current_block, new_insn(I_MOVSX, copy_tree(index), tree), NULL);
+    put_insn(current_block, new_insn(I_ADD, copy_tree(index), copy_tree(base)), NULL);
+    put_insn(current_block, new_insn(I_JMP, copy_tree(index)), NULL);
+    current_block->jump_table = table;
+
+    for (i = 0; i < n; ++i) {
+        if (cases[first]->value->u.con.i == (lo + i)) 
+            succeed_block(current_block, CC_TABLE(i), cases[first++]->target);
+        else
+            succeed_block(current_block, CC_TABLE(i), default_block);
+    }
+
+    free_tree(index);
+    free_tree(base);
+}
+
+/* dispatch to the cases in clusters[first] through clusters[last]. */
+
+static
+switch_search(reg_ax, cases, clusters, first, last)
+    struct tree        * reg_ax;
+    struct switchcase ** cases;
+    struct cluster     * clusters;
+{
+    struct block * lower_block;
+    struct block * upper_block;
+    struct block * tmp;
+    int            mid;
+    int            i;
+
+    for (i = first; i <= last; ++i) 
+        if (clusters[i].table) break;
+
+    if ((i > last) && ((last - first) < SWITCH_LINEAR_MAX)) {
+        for (i = first; i <= last; ++i) {
+            put_insn(current_block, new_insn(I_CMP, copy_tree(reg_ax), 
+                     copy_tree(cases[clusters[i].first]->value)), NULL);
+            succeed_block(current_block, CC_Z, cases[clusters[i].first]->target);
+            succeed_block(current_block, CC_NZ, tmp = new_block());
+            current_block = tmp;
+        }
+
+        succeed_block(current_block, CC_ALWAYS, default_block);
+        return 0;
+    }
+
+    if (first == last) {
+        switch_table(reg_ax, cases, clusters[first].first, clusters[first].last);
+        return 0;
+    }
+
+    mid = (first + last + 1) / 2;
+    lower_block = new_block();
+    upper_block = new_block();
+    put_insn(current_block, new_insn(I_CMP, copy_tree(reg_ax), 
+             copy_tree(cases[clusters[mid].first]->value)), NULL);
+
+    if (switch_type->ts & T_IS_UNSIGNED) {
+        succeed_block(current_block, CC_B, lower_block);
+        succeed_block(current_block, CC_AE, upper_block);
+    } else {
+        succeed_block(current_block, CC_L, lower_block);
+        succeed_block(current_block, CC_GE, upper_block);
+    }
+
+    current_block = lower_block;
+    switch_search(reg_ax, cases, clusters, first, mid - 1);
+    current_block = upper_block;
+    switch_search(reg_ax, cases, clusters, mid, last);
+}
+
+/* generate the dispatch code for the switch whose cases are in the
+   'switchcases' list, into the current block, consuming the list. */
+
+static
+lower_switch(reg_ax)
+    struct tree * reg_ax;
+{
+    struct switchcase  * switchcase;
+    struct switchcase ** cases;
+    struct cluster     * clusters;
+    unsigned long        span;
+    int                  nr_cases;
+    int                  nr_clusters;
+    int                  i;
+    int                  j;
+    int                  k;
+
+    nr_cases = 0;
+    for (switchcase = switchcases; switchcase; switchcase = switchcase->next) ++nr_cases;
+
+    if (nr_cases == 0) {
+        succeed_block(current_block, CC_ALWAYS, default_block);
+        return 0;
+    }
+
+    cases = (struct switchcase **) allocate(nr_cases * sizeof(struct switchcase *));
+    clusters = (struct cluster *) allocate(nr_cases * sizeof(struct cluster));
+
+    for (i = 0, switchcase = switchcases; switchcase; switchcase = switchcase->next) 
+        cases[i++] = switchcase;
+
+    qsort(cases, nr_cases, sizeof(struct switchcase *), compare_cases);
+
+    /* find, for each case, the longest dense run that starts there. 
+       the span is computed unsigned, so it can't overflow. the bias 
+       (the value of the first case) must fit in a 32-bit immediate. */
+
+    for (nr_clusters = 0, i = 0; i < nr_cases; i = j + 1, ++nr_clusters) {
+        clusters[nr_clusters].first = i;
+        clusters[nr_clusters].table = 0;
+        j = i;
+
+        if ((cases[i]->value->u.con.i >= -2147483648L) && (cases[i]->value->u.con.i <= 2147483647L)) {
+            for (k = i + 1; k < nr_cases; ++k) {
+                span = (unsigned long) cases[k]->value->u.con.i - (unsigned long) cases[i]->value->u.con.i;
+                if (span >= SWITCH_TABLE_MAX) break;
+                if (((k - i + 1) * 100L) >= (SWITCH_TABLE_DENSITY * (span + 1))) j = k;
+            }
+
+            if ((j - i + 1) >= SWITCH_TABLE_MIN) 
+                clusters[nr_clusters].table = 1;
+            else
+                j = i;
+        }
+
+        clusters[nr_clusters].last = j;
+    }
+
+    switch_search(reg_ax, cases, clusters, 0, nr_clusters - 1);
+
+    for (i = 0; i < nr_cases; ++i) {
+        free_tree(cases[i]->value);
+        free(cases[i]);
+    }
+
+    free(cases);
+    free(clusters);
+    switchcases = NULL;
+}
+
 static
 switch_statement()
 {
@@ -325,23 +568,7 @@ switch_statement()
     if (default_block == NULL) default_block = break_block;
 
     current_block = control_block;
-
-    while (switchcases) {
-        struct switchcase * switchcase;
-        struct block      * tmp;
-
-        switchcase = switchcases;
-        switchcases = switchcases->next;
-
-        put_insn(current_block, new_insn(I_CMP, copy_tree(reg_ax), switchcase->value), NULL);
-        succeed_block(current_block, CC_Z, switchcase->target);
-        succeed_block(current_block, CC_NZ, tmp = new_block());
-        current_block = tmp;
-
-        free(switchcase);
-    }
-
-    succeed_block(current_block, CC_ALWAYS, default_block);
+    lower_switch(reg_ax);
 
     free_tree(reg_ax);
     current_block = break_block;
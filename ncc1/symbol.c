@@ -26,27 +26,72 @@
 #include <stdlib.h>
 #include "ncc1.h"
 
+static struct pool symbol_pool = { sizeof(struct symbol), ARENA_PERMANENT };
+
+/* the string table doubles in size whenever the number of
+   strings reaches the number of buckets, to keep chains short. */
+
+static struct string ** string_buckets;
+static int              nr_string_buckets;
+static int              nr_strings;
+
+static
+grow_strings()
+{
+    struct string ** old_buckets = string_buckets;
+    int              nr_old_buckets = nr_string_buckets;
+    struct string  * string;
+    int              i, j;
+
+    nr_string_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_STRING_BUCKETS;
+    string_buckets = (struct string **) allocate(nr_string_buckets * sizeof(struct string *));
+    memset(string_buckets, 0, nr_string_buckets * sizeof(struct string *));
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (string = old_buckets[i]) {
+            old_buckets[i] = string->link;
+            j = string->hash & (nr_string_buckets - 1);
+            string->link = string_buckets[j];
+            string_buckets[j] = string;
+        }
+    }
+
+    if (old_buckets) free(old_buckets);
+}
+
 /* return the string table entry associated with a string 
    containing 'length' bytes at 'data', creating one if necessary. */
 
-static struct string * string_buckets[NR_STRING_BUCKETS];
-
 struct string *
 stringize(data, length)
     char * data;
     int    length;
+{
+    unsigned hash;
+    int      i;
+
+    for (i = 0, hash = STRING_HASH_INIT; i < length; i++) 
+        hash = STRING_HASH(hash, data[i]);
+
+    return hashed_string(data, length, hash);
+}
+
+/* the guts of stringize(), for callers which have already computed
+   the 'hash' of the string with STRING_HASH() (e.g., the lexer). */
+
+struct string *
+hashed_string(data, length, hash)
+    char *   data;
+    int      length;
+    unsigned hash;
 {
     struct string *  string;
     struct string ** stringp;
-    unsigned         hash;
     int              i;
 
-    for (i = 0, hash = 0; i < length; i++) {
-        hash <<= 4;
-        hash ^= (data[i] & 0xff);
-    }
+    if (nr_strings == nr_string_buckets) grow_strings();
 
-    i = hash % NR_STRING_BUCKETS;
+    i = hash & (nr_string_buckets - 1);
     for (stringp = &(string_buckets[i]); (string = *stringp); stringp = &((*stringp)->link)) {
         if (string->length != length) continue;
         if (string->hash != hash) continue;
@@ -59,15 +104,16 @@ stringize(data, length)
         return string; 
     }
 
-    string = (struct string *) allocate(sizeof(struct string));
+    string = (struct string *) arena_allocate(ARENA_PERMANENT, sizeof(struct string));
     string->link = string_buckets[i];
     string_buckets[i] = string;
+    nr_strings++;
     string->hash = hash;
     string->length = length;
     string->asm_label = 0;
     string->token = KK_IDENT;
 
-    string->data = allocate(length + 1);
+    string->data = arena_allocate(ARENA_PERMANENT, length + 1);
     memcpy(string->data, data, length);
     string->data[length] = 0;
 
@@ -81,10 +127,10 @@ literals()
     struct string * string;
     int             i;
 
-    for (i = 0; i < NR_STRING_BUCKETS; i++) 
+    for (i = 0; i < nr_string_buckets; i++) 
         for (string = string_buckets[i]; string; string = string->link)
             if (string->asm_label) {
-                segment(SEGMENT_TEXT);
+                section(SEGMENT_TEXT);
                 output("%L:\n", string->asm_label);
                 output_string(string, string->length + 1);
             }
@@ -123,14 +169,56 @@ string_symbol(string)
 }
 
 /* the symbol table borrows the hash from the symbol identifiers 
-   to use for its own purposes. since anonymous symbols are possible,
-   there's an extra bucket just for them - putting them in the main
-   table would serve no purpose, since we never find them by name. */
+   to use for its own purposes. anonymous symbols aren't hashed at all,
+   since we never find them by name.
+
+   like the string table, the symbol table doubles when the number of
+   (named) symbols reaches the number of buckets. rehashing preserves
+   the relative order of the symbols, so the buckets remain sorted. 
 
-static struct symbol * symbol_buckets[NR_SYMBOL_BUCKETS + 1];
+   independently of the buckets, every symbol in the table (named or
+   not) is on the doubly-linked list for its scope level, so the symbols 
+   in a scope can be visited without looking at anything else. */
 
-#define EXTRA_BUCKET        NR_SYMBOL_BUCKETS 
-#define SYMBOL_BUCKET(id)   ((id) ? ((id)->hash % NR_SYMBOL_BUCKETS) : EXTRA_BUCKET)
+static struct symbol ** symbol_buckets;
+static int              nr_symbol_buckets;
+static int              nr_symbols;
+static struct symbol *  scope_symbols[SCOPE_RETIRED + 1];
+
+#define SYMBOL_BUCKET(id)   (&symbol_buckets[(id)->hash & (nr_symbol_buckets - 1)])
+
+static
+grow_symbols()
+{
+    struct symbol ** old_buckets = symbol_buckets;
+    int              nr_old_buckets = nr_symbol_buckets;
+    struct symbol ** tails;
+    struct symbol  * symbol;
+    int              i, j;
+
+    nr_symbol_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_SYMBOL_BUCKETS;
+    symbol_buckets = (struct symbol **) allocate(nr_symbol_buckets * sizeof(struct symbol *));
+    tails = (struct symbol **) allocate(nr_symbol_buckets * sizeof(struct symbol *));
+    memset(symbol_buckets, 0, nr_symbol_buckets * sizeof(struct symbol *));
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (symbol = old_buckets[i]) {
+            old_buckets[i] = symbol->link;
+            symbol->link = NULL;
+            j = symbol->id->hash & (nr_symbol_buckets - 1);
+
+            if (symbol_buckets[j])
+                tails[j]->link = symbol;
+            else
+                symbol_buckets[j] = symbol;
+
+            tails[j] = symbol;
+        }
+    }
+
+    free(tails);
+    if (old_buckets) free(old_buckets);
+}
 
 /* allocate a new symbol. if 'type' is supplied, 
    the caller yields ownership. */
@@ -142,16 +230,18 @@ new_symbol(id, ss, type)
 {
     struct symbol * symbol;
 
-    symbol = (struct symbol *) allocate(sizeof(struct symbol));
+    symbol = (struct symbol *) pool_allocate(&symbol_pool);
 
     symbol->id = id;
     symbol->ss = ss;
-    symbol->type = type;
+    symbol->type = intern_type(type);
     symbol->scope = SCOPE_NONE;
     symbol->reg = R_NONE;
     symbol->align = 0;
     symbol->target = NULL;
     symbol->link = NULL;
+    symbol->scope_next = NULL;
+    symbol->scope_previous = NULL;
     symbol->i = 0;
     symbol->list = NULL;
 
@@ -166,13 +256,21 @@ put_symbol(symbol, scope)
     struct symbol ** bucketp;
 
     symbol->scope = scope;
-    bucketp = &symbol_buckets[SYMBOL_BUCKET(symbol->id)];
+    symbol->scope_previous = NULL;
+    symbol->scope_next = scope_symbols[scope];
+    if (symbol->scope_next) symbol->scope_next->scope_previous = symbol;
+    scope_symbols[scope] = symbol;
 
-    while (*bucketp && ((*bucketp)->scope > symbol->scope)) 
-        bucketp = &((*bucketp)->link);
+    if (symbol->id) {
+        if (nr_symbols++ == nr_symbol_buckets) grow_symbols();
+        bucketp = SYMBOL_BUCKET(symbol->id);
 
-    symbol->link = *bucketp;
-    *bucketp = symbol;
+        while (*bucketp && ((*bucketp)->scope > symbol->scope)) 
+            bucketp = &((*bucketp)->link);
+
+        symbol->link = *bucketp;
+        *bucketp = symbol;
+    }
 }
 
 /* remove the symbol from the symbol table. */
@@ -182,9 +280,19 @@ get_symbol(symbol)
 {
     struct symbol ** bucketp;
 
-    bucketp = &symbol_buckets[SYMBOL_BUCKET(symbol->id)];
-    while (*bucketp != symbol) bucketp = &((*bucketp)->link);
-    *bucketp = symbol->link;
+    if (symbol->scope_previous)
+        symbol->scope_previous->scope_next = symbol->scope_next;
+    else
+        scope_symbols[symbol->scope] = symbol->scope_next;
+
+    if (symbol->scope_next) symbol->scope_next->scope_previous = symbol->scope_previous;
+
+    if (symbol->id) {
+        nr_symbols--;
+        bucketp = SYMBOL_BUCKET(symbol->id);
+        while (*bucketp != symbol) bucketp = &((*bucketp)->link);
+        *bucketp = symbol->link;
+    }
 }
 
 /* put the symbol on the end of the list. */
@@ -255,10 +363,10 @@ find_symbol(id, ss, start, end)
     struct string * id;
 {
     struct symbol * symbol;
-    int             i;
 
-    i = SYMBOL_BUCKET(id);
-    for (symbol = symbol_buckets[i]; symbol; symbol = symbol->link) {
+    if (nr_symbol_buckets == 0) return NULL;
+
+    for (symbol = *SYMBOL_BUCKET(id); symbol; symbol = symbol->link) {
         if (symbol->scope < start) break;
         if (symbol->scope > end) continue;
         if (symbol->id != id) continue;
@@ -269,22 +377,6 @@ find_symbol(id, ss, start, end)
     return NULL;
 }
 
-/* find a symbol by (pseudo) register. return NULL if not found. this 
-   is very slow, because the symbol table isn't indexed by register. */
-
-struct symbol *
-find_symbol_by_reg(reg)
-{
-    struct symbol * symbol;
-    int             i;
-
-    for (i = 0; i <= EXTRA_BUCKET; i++) 
-        for (symbol = symbol_buckets[i]; symbol; symbol = symbol->link) 
-            if (symbol->reg == reg) return symbol;
-
-    return NULL;
-}
-
 /* someone's interested in the memory allocated to this symbol,
    so make sure it's allocated. */
 
@@ -298,6 +390,56 @@ store_symbol(symbol)
     }
 }
 
+/* pseudo registers are numbered consecutively throughout the translation
+   unit (a global keeps its register from one function to the next), so
+   each class of register has a table mapping pseudo register numbers to
+   their symbols, maintained by symbol_reg() and free_symbol(). */
+
+#define REG_CLASS(reg)      (((reg) & R_IS_FLOAT) ? 1 : 0)
+#define REG_SLOT(reg)       (R_IDX(reg) - NR_REGS)
+
+static struct symbol ** reg_symbols[2];
+static int              nr_reg_symbols[2];
+
+static
+index_reg(symbol)
+    struct symbol * symbol;
+{
+    struct symbol ** symbols;
+    int              class = REG_CLASS(symbol->reg);
+    int              slot = REG_SLOT(symbol->reg);
+    int              n;
+
+    if (slot >= nr_reg_symbols[class]) {
+        n = MAX(nr_reg_symbols[class] * 2, 1024);
+        while (n <= slot) n *= 2;
+        symbols = (struct symbol **) allocate(n * sizeof(struct symbol *));
+        memset(symbols, 0, n * sizeof(struct symbol *));
+
+        if (reg_symbols[class]) {
+            memcpy(symbols, reg_symbols[class], nr_reg_symbols[class] * sizeof(struct symbol *));
+            free(reg_symbols[class]);
+        }
+
+        reg_symbols[class] = symbols;
+        nr_reg_symbols[class] = n;
+    }
+
+    reg_symbols[class][slot] = symbol;
+}
+
+/* find a symbol by (pseudo) register. return NULL if not found. */
+
+struct symbol *
+find_symbol_by_reg(reg)
+{
+    int class = REG_CLASS(reg);
+    int slot = REG_SLOT(reg);
+
+    if ((slot < 0) || (slot >= nr_reg_symbols[class])) return NULL;
+    return reg_symbols[class][slot];
+}
+
 /* return the pseudo register associated with the symbol, allocating
    one of appropriate type, if necessary. */
 
@@ -312,6 +454,7 @@ symbol_reg(symbol)
         symbol->reg = next_fregister++;
     else error(ERROR_INTERNAL);
 
+    index_reg(symbol);
     return symbol->reg;
 }
 
@@ -334,20 +477,19 @@ temporary_symbol(type)
 }
 
 /* walk the symbol table between scopes 'start' and 'end', inclusive,
-   calling f() on each one. the EXTRA_BUCKET is included in the traversal. */
+   calling f() on each one. anonymous symbols are included in the walk.
+   f() may remove the symbol, and put it back at a scope outside the walk. */
 
 walk_symbols(start, end, f)
     int f();
 {
     struct symbol * symbol;
-    struct symbol * link;
-    int             i;
+    struct symbol * next;
+    int             scope;
 
-    for (i = 0; i <= EXTRA_BUCKET; i++) {
-        for (symbol = symbol_buckets[i]; symbol; symbol = link) {
-            link = symbol->link;
-            if (symbol->scope < start) break;
-            if (symbol->scope > end) continue;
+    for (scope = start; scope <= end; scope++) {
+        for (symbol = scope_symbols[scope]; symbol; symbol = next) {
+            next = symbol->scope_next;
             f(symbol);
         }
     }
@@ -374,7 +516,7 @@ exit1(symbol)
 
 exit_scope()
 {
-    walk_symbols(current_scope, SCOPE_MAX, exit1);
+    walk_symbols(current_scope, current_scope, exit1);
     --current_scope;
 }
 
@@ -384,8 +526,9 @@ exit_scope()
 free_symbol(symbol)
     struct symbol * symbol;
 {
+    if (symbol->reg != R_NONE) reg_symbols[REG_CLASS(symbol->reg)][REG_SLOT(symbol->reg)] = NULL;
     free_type(symbol->type);
-    free(symbol);
+    pool_free(&symbol_pool, symbol);
 }
 
 static
@@ -401,3 +544,51 @@ free_symbols()
     walk_symbols(SCOPE_FUNCTION, SCOPE_RETIRED, free_symbols1);
 }
 
+/* print statistics about the string, symbol and type tables to stderr. */
+
+chain_stats(title, nr_entries, nr_buckets, lengths)
+    char * title;
+    int    lengths[];
+{
+    int longest = 0;
+    int used = 0;
+    int i;
+
+    for (i = 0; i < nr_buckets; i++) {
+        if (lengths[i]) ++used;
+        longest = MAX(longest, lengths[i]);
+    }
+
+    fprintf(stderr, "%s: %d entries, %d buckets, load %d.%02d, "
+                    "%d buckets used, longest chain %d\n",
+                    title, nr_entries, nr_buckets, 
+                    nr_entries / nr_buckets, (nr_entries * 100 / nr_buckets) % 100,
+                    used, longest);
+}
+
+hash_stats()
+{
+    struct string * string;
+    struct symbol * symbol;
+    int           * lengths;
+    int             i;
+
+    lengths = (int *) allocate(MAX(nr_string_buckets, nr_symbol_buckets) * sizeof(int));
+
+    for (i = 0; i < nr_string_buckets; i++) 
+        for (lengths[i] = 0, string = string_buckets[i]; string; string = string->link)
+            ++lengths[i];
+
+    chain_stats("strings", nr_strings, nr_string_buckets, lengths);
+
+    if (nr_symbol_buckets) {
+        for (i = 0; i < nr_symbol_buckets; i++) 
+            for (lengths[i] = 0, symbol = symbol_buckets[i]; symbol; symbol = symbol->link)
+                ++lengths[i];
+
+        chain_stats("symbols", nr_symbols, nr_symbol_buckets, lengths);
+    }
+
+    free(lengths);
+    type_stats();
+}
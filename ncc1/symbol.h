@@ -132,6 +132,8 @@ struct symbol
     int             align;      /* S_TAG only */
     struct block *  target;     /* S_LABEL only */
     struct symbol * link;       /* table bucket link */
+    struct symbol * scope_next; /* list of symbols in the same scope */
+    struct symbol * scope_previous;
 
     /* 'i' is vaguely named because it's a general purpose holder.
     
@@ -26,6 +26,13 @@
 #include <string.h>
 #include "ncc1.h"
 
+/* trees and types (see type.c) are created and discarded at a furious
+   pace, so they're recycled through pools. they can outlive the function
+   in which they're created (e.g., in the types of implicit declarations),
+   so they live in the permanent arena. */
+
+static struct pool tree_pool = { sizeof(struct tree), ARENA_PERMANENT };
+
 /* constant expressions must evaluate to an int */
 
 constant_expression()
@@ -54,9 +61,9 @@ new_tree(op, type, ch0, ch1, ch2)
 {
     struct tree * tree;
 
-    tree = (struct tree *) allocate(sizeof(struct tree));
+    tree = (struct tree *) pool_allocate(&tree_pool);
     tree->op = op;
-    tree->type = type;
+    tree->type = intern_type(type);
     tree->list = NULL;
 
     if (E_IS_LEAF(op)) {
@@ -79,6 +86,7 @@ new_tree(op, type, ch0, ch1, ch2)
             tree->u.mi.i = R_NONE;
             tree->u.mi.s = 1;
             tree->u.mi.rip = 0;
+            tree->u.mi.tag = NULL;
             break;
         }
     } else {
@@ -104,7 +112,7 @@ free_tree(tree)
 
         free_tree(tree->list);
         free_type(tree->type);
-        free(tree);
+        pool_free(&tree_pool, tree);
     }
 }
 
@@ -436,7 +444,7 @@ check_operand_types(op, left, right)
     struct type * right;
 {
     if ((op != E_LOR) && (op != E_LAND) && (left->ts & right->ts & T_PTR))
-        check_types(left, right, 0);
+        check_types(left, right);
 
     switch (op)
     {   
@@ -852,6 +860,19 @@ cast_expression()
         {
             error(ERROR_BADCAST);
         }
+
+        /* note conversions to pointers which might let an object be 
+           accessed as a different type. (char * is exempt: char 
+           accesses are assumed to alias anything anyway [alias.c].) */
+
+        if (    (type->ts & T_PTR) 
+            &&  !(type->next->ts & T_IS_CHAR)
+            &&  ((tree->type->ts & T_PTR) ? !(tree->type->next->ts & T_IS_CHAR) 
+                                          : (tree->op != E_CON)) )
+        {
+            ++type_puns;
+        }
+
         return new_tree(E_CAST, type, tree);
     }
         
@@ -953,8 +974,7 @@ assignment_expression(left)
        assignment, which doesn't involve an implicit cast */
 
     if (!(left->type->ts & T_PTR)) {
-        right = new_tree(E_CAST, copy_type(left->type), right);
-        right->type->ts &= T_BASE; /* no bitfield here */
+        right = new_tree(E_CAST, field_storage(copy_type(left->type)), right);
     }
 
     left = new_tree(op, copy_type(left->type), left, right);
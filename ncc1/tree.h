@@ -63,7 +63,8 @@ struct tree
 
         /* E_MEM represents a value held in memory, at [b+i*s+glob+ofs] or 
            [rip glob+ofs].  E_IMM represents the address of that value. 'glob'
-           must be a symbol known to the assembler (S_EXTERN or S_STATIC). */
+           must be a symbol known to the assembler (S_EXTERN or S_STATIC). 
+           'tag' is the struct or union, if any, whose member is accessed. */
 
         struct                      /* E_IMM or E_MEM */
         {
@@ -72,6 +73,7 @@ struct tree
             int             b, i;       /* base and index registers */
             int             s;          /* 1, 2, 4 or 8: scale for index reg */
             int             rip;        /* rIP-relative (flag) */
+            struct symbol * tag;        /* for alias analysis [alias.c] */
         } mi;
 
         struct tree *   ch[NR_TREE_CH]; 
@@ -23,39 +23,139 @@
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
 #include <stdlib.h>
+#include <string.h>
 #include "ncc1.h"
 
-/* create a new type node and give it sane defaults */
+static struct pool type_pool = { sizeof(struct type), ARENA_PERMANENT };
+
+/* create a new (private) type node and give it sane defaults */
 
 struct type *
 new_type(ts)
 {
     struct type * type;
 
-    type = (struct type *) allocate(sizeof(struct type));
+    type = (struct type *) pool_allocate(&type_pool);
     type->ts = ts;
     type->nr_elements = 0;
     type->tag = NULL;
     type->next = NULL;
+    type->interned = 0;
+    type->size = 0;
+    type->align = 0;
+    return type;
+}
+
+/* interned type nodes are kept in a hash table, keyed by their contents.
+   since the 'next' of an interned node is itself interned, comparing the
+   pointer is as good as comparing the rest of the type. the table doubles
+   when the number of types reaches the number of buckets. */
+
+static struct type ** type_buckets;
+static int            nr_type_buckets;
+static int            nr_types;
+
+#define TYPE_HASH(ts, nr_elements, tag, next)                                   \
+    ((unsigned) (ts) * 31 + (unsigned) (nr_elements) * 17                       \
+     + (unsigned) (((long) (tag)) >> 3) * 13 + (unsigned) (((long) (next)) >> 3))
+
+#define TYPE_BUCKET(type)                                                       \
+    (TYPE_HASH((type)->ts, (type)->nr_elements, (type)->tag, (type)->next)      \
+     & (nr_type_buckets - 1))
+
+static
+grow_types()
+{
+    struct type ** old_buckets = type_buckets;
+    int            nr_old_buckets = nr_type_buckets;
+    struct type  * type;
+    int            i, j;
+
+    nr_type_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_TYPE_BUCKETS;
+    type_buckets = (struct type **) allocate(nr_type_buckets * sizeof(struct type *));
+    memset(type_buckets, 0, nr_type_buckets * sizeof(struct type *));
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (type = old_buckets[i]) {
+            old_buckets[i] = type->link;
+            j = TYPE_BUCKET(type);
+            type->link = type_buckets[j];
+            type_buckets[j] = type;
+        }
+    }
+
+    if (old_buckets) free(old_buckets);
+}
+
+/* return the interned equivalent of 'type', which is consumed. */
+
+struct type *
+intern_type(type)
+    struct type * type;
+{
+    struct type * interned;
+    int           i;
+
+    if ((type == NULL) || type->interned) return type;
+
+    type->next = intern_type(type->next);
+    if (nr_types == nr_type_buckets) grow_types();
+    i = TYPE_BUCKET(type);
+
+    for (interned = type_buckets[i]; interned; interned = interned->link) {
+        if (interned->ts != type->ts) continue;
+        if (interned->nr_elements != type->nr_elements) continue;
+        if (interned->tag != type->tag) continue;
+        if (interned->next != type->next) continue;
+
+        pool_free(&type_pool, type);
+        return interned;
+    }
+
+    type->interned = 1;
+    type->link = type_buckets[i];
+    type_buckets[i] = type;
+    nr_types++;
+
     return type;
 }
 
-/* free a type - the whole type, not just the node.
-   safe to call with NULL 'type'. */
+/* print statistics about the type table to stderr. called from hash_stats(). */
+
+type_stats()
+{
+    struct type * type;
+    int         * lengths;
+    int           i;
+
+    if (nr_type_buckets == 0) return 0;
+    lengths = (int *) allocate(nr_type_buckets * sizeof(int));
+
+    for (i = 0; i < nr_type_buckets; i++)
+        for (lengths[i] = 0, type = type_buckets[i]; type; type = type->link)
+            ++lengths[i];
+
+    chain_stats("types", nr_types, nr_type_buckets, lengths);
+    free(lengths);
+}
+
+/* free a type - the whole type, not just the node. interned
+   nodes are left alone. safe to call with NULL 'type'. */
 
 free_type(type)
     struct type * type;
 {
     struct type * tmp;
 
-    while (type) {
+    while (type && !type->interned) {
         tmp = type->next;
-        free(type);
+        pool_free(&type_pool, type);
         type = tmp;
     }
 }
 
-/* return a copy of the type */
+/* return a copy of the type. only the private nodes are actually
+   copied; the copy shares the interned nodes with the original. */
 
 struct type *
 copy_type(type)
@@ -64,7 +164,7 @@ copy_type(type)
     struct type *  copy = NULL;
     struct type ** typep = &copy;
 
-    while (type) {
+    while (type && !type->interned) {
         *typep = new_type(type->ts);
         (*typep)->nr_elements = type->nr_elements;
         (*typep)->tag = type->tag;
@@ -72,10 +172,12 @@ copy_type(type)
         typep = &((*typep)->next);
     }
 
+    *typep = type;
     return copy;
 }
 
-/* glue two types into one by appending 'type2' on the end of 'type1'. */
+/* glue two types into one by appending 'type2' on the end of 'type1',
+   which must consist entirely of private nodes. */
 
 struct type *
 splice_types(type1, type2)
@@ -91,23 +193,81 @@ splice_types(type1, type2)
     return type1;
 }
 
-/* check for compatibility between two types. and merge any 
-   additional information from 'type2' into 'type1'. */
+/* check for compatibility between two types. */
 
-check_types(type1, type2, mode)
+check_types(type1, type2)
     struct type * type1;
     struct type * type2;
 {
-    while (type1 && type2) {
+    while (type1 && type2 && (type1 != type2)) {
         if ((type1->ts & T_BASE) != (type2->ts & T_BASE)) break;
         if (type1->tag != type2->tag) break;
         if ((type1->nr_elements && type2->nr_elements) && (type1->nr_elements != type2->nr_elements)) break;
-        if ((mode == CHECK_TYPES_COMPOSE) && (type2->nr_elements)) type1->nr_elements = type2->nr_elements;
         type1 = type1->next;
         type2 = type2->next;
     }
 
-    if (type1 || type2) error(ERROR_INCOMPAT);
+    if (type1 != type2) error(ERROR_INCOMPAT);
+}
+
+/* return the composite of two compatible types, i.e., the type with
+   the array bounds of both. 'type1' and 'type2' are consumed. */
+
+struct type *
+compose_types(type1, type2)
+    struct type * type1;
+    struct type * type2;
+{
+    struct type *  composite = NULL;
+    struct type ** typep = &composite;
+    struct type *  tmp1;
+    struct type *  tmp2;
+
+    check_types(type1, type2);
+
+    for (tmp1 = type1, tmp2 = type2; tmp1; tmp1 = tmp1->next, tmp2 = tmp2->next) {
+        *typep = new_type(tmp1->ts);
+        (*typep)->tag = tmp1->tag;
+        (*typep)->nr_elements = tmp1->nr_elements ? tmp1->nr_elements : tmp2->nr_elements;
+        typep = &((*typep)->next);
+    }
+
+    free_type(type1);
+    free_type(type2);
+    return intern_type(composite);
+}
+
+/* return the array 'type', which is consumed, with its
+   (outermost) bound set to 'nr_elements'. */
+
+struct type *
+bound_type(type, nr_elements)
+    struct type * type;
+{
+    struct type * bound;
+
+    bound = new_type(T_ARRAY);
+    bound->nr_elements = nr_elements;
+    bound->next = copy_type(type->next);
+    free_type(type);
+
+    return intern_type(bound);
+}
+
+/* return the type of the storage unit of bit field 'type', which
+   is consumed. if 'type' isn't a bit field, it's returned as is. */
+
+struct type *
+field_storage(type)
+    struct type * type;
+{
+    struct type * storage;
+
+    if (!(type->ts & T_FIELD)) return type;
+
+    storage = new_type(type->ts & T_BASE);
+    free_type(type);
+    return intern_type(storage);
 }
 
 /* return the size or alignment of the type in bytes.
@@ -116,7 +276,11 @@ check_types(type1, type2, mode)
 size_of(type)
     struct type * type;
 {
-    long size = 1;
+    struct type * head = type;
+    long          size = 1;
+    int           cache = 1;
+
+    if (type && type->size) return type->size;
 
     while (type) {
         if (type->ts & (T_CHAR | T_UCHAR)) 
@@ -130,6 +294,8 @@ size_of(type)
         else if (type->ts & T_FUNC)
             error(ERROR_ILLFUNC);
         else if (type->ts & T_TAG) {
+            cache = 0;  /* the tag may be freed and its memory reused */
+
             if (type->tag->ss & S_DEFINED)
                 size *= type->tag->i;
             else
@@ -146,13 +312,18 @@ size_of(type)
         type = type->next;
     }
 
+    if (head && head->interned && cache) head->size = size;
     return size;
 }
 
 align_of(type)
     struct type * type;
 {
-    int align = 1;
+    struct type * head = type;
+    int           align = 1;
+    int           cache = 1;
+
+    if (type && type->align) return type->align;
 
     while (type) {
         if (type->ts & T_ARRAY)
@@ -168,6 +339,8 @@ align_of(type)
         else if (type->ts & T_FUNC)
             error(ERROR_ILLFUNC);
         else if (type->ts & T_TAG) {
+            cache = 0;
+
             if (type->tag->ss & S_DEFINED)
                 align = type->tag->align;
             else
@@ -178,6 +351,7 @@ align_of(type)
         type = type->next;
     } 
 
+    if (head && head->interned && cache) head->align = align;
     return align;
 }
 
@@ -214,9 +388,13 @@ struct type *
 argument_type(type)
     struct type * type;
 {
+    struct type * pointer;
+
     if (type->ts & T_ARRAY) {
-        type->ts &= ~T_ARRAY;
-        type->ts = T_PTR;
+        pointer = new_type(T_PTR);
+        pointer->next = copy_type(type->next);
+        free_type(type);
+        type = pointer;
     }
 
     if (type->ts & T_FUNC) type = splice_types(new_type(T_PTR), type);
@@ -22,7 +22,14 @@
  OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
 
-/* types are represented by lists of type nodes. */
+/* types are represented by lists of type nodes. 
+
+   a type node is either private to its owner, who may modify it, or 
+   interned (see intern_type() in type.c). interned nodes are unique: 
+   there's only one instance of each distinct type, so they're shared, 
+   and must never be modified. the list of an interned node consists 
+   entirely of interned nodes, but private nodes may be followed by 
+   interned ones. copy_type() and free_type() only touch private nodes. */
 
 struct type
 {
@@ -30,6 +37,13 @@ struct type
     struct type *   next;
     int             nr_elements;  /* T_ARRAY */
     struct symbol * tag;          /* T_TAG */
+
+    /* the remaining fields are only meaningful for interned nodes */
+
+    int             interned;     /* non-zero if interned */
+    int             size;         /* cached size_of() and align_of(), */
+    int             align;        /* or 0 if not known */
+    struct type *   link;         /* hash chain */
 };
 
 /* type nodes will have exactly one of the following bits set. they're defined
@@ -32,7 +32,7 @@ struct input * input_stack;
 
 /* open a new file and put it on top of the input stack. the next call to
    input_line() will return text from this file. ownership of 'path' is
-   yielded by the caller. */
+   yielded by the caller. the path "-" means the standard input. */
 
 input_open(path)
     struct vstring * path;
@@ -44,7 +44,11 @@ input_open(path)
     input->line_number = 0;
     input->stack_link = input_stack;
 
-    input->file = fopen(path->data, "r");
+    if (strcmp(path->data, "-") == 0)
+        input->file = stdin;
+    else
+        input->file = fopen(path->data, "r");
+
     if (!input->file) fail("can't open '%V' for reading", path);
 
     input_stack = input;
@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdarg.h>
 #include "ncpp.h"
 
@@ -122,7 +123,7 @@ fail(fmt)
     va_end(args);
     fputc('\n', stderr);
 
-    if (output_file) {
+    if (output_file && (output_file != stdout)) {
         fclose(output_file);
         unlink(output_path->data);
     }
@@ -295,7 +296,11 @@ main(argc, argv)
 
     if (!*argv) fail("no output path specified");
     output_path = vstring_new(*argv);
-    output_file = fopen(output_path->data, "w");
+    if (strcmp(output_path->data, "-") == 0)
+        output_file = stdout;
+    else
+        output_file = fopen(output_path->data, "w");
+
     if (!output_file) fail("could not open '%V' for writing", output_path);
     ++argv;
 
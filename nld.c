@@ -28,20 +28,37 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 
 #include "obj.h"
 #include "a.out.h"
+#include "ar.h"
 
 #define ALIGN(a,b)      (((a) % (b)) ? ((a) + ((b) - ((a) % (b)))) : (a))
 
-/* size of buffer for copying from object files to output */
+/* the output is built in memory, in an image which starts at
+   this many bytes and doubles as needed. it's written at the end. */
 
-#define BUFFER_SIZE 4096
+#define MIN_IMAGE   65536
 
-/* global symbol names are referenced from a master table
-   hashed into NR_BUCKETS */
+/* once the layout is done, the objects' segments are copied into the
+   image and relocated by a pool of threads: by default, one per online
+   CPU, up to MAX_THREADS. each thread takes the next object in turn. */
 
-#define NR_BUCKETS 64
+#define MAX_THREADS 16
+
+/* global symbol names are kept in hash tables, each of which starts
+   with MIN_BUCKETS buckets (a power of two) and doubles whenever the
+   number of entries reaches that number. there are two: 'globals' has
+   the symbols exported by the objects we've referenced, 'definitions'
+   has every defined global in every input, so import() can find the
+   object that defines a symbol without searching them all. */
+
+#define MIN_BUCKETS 1024
 
 struct global
 {
@@ -49,23 +66,59 @@ struct global
     unsigned            hash;
     int                 length;
     struct obj_symbol * symbol;
+    struct object     * object;         /* which defines 'symbol' */
     struct global     * link;
 };
 
+struct table
+{
+    char              * title;          /* for statistics */
+    struct global    ** buckets;
+    int                 nr_buckets;
+    int                 nr_entries;
+};
+
 /* all object sources are kept in a linked list, 
-   ordered as they appear on the command line. */
+   ordered as they appear on the command line. archive
+   members are added to the end as they are loaded. */
 
 #define OBJECT_REFERENCED   0x00000001      /* this object must be linked in the output */
+#define OBJECT_LOADED       0x00000002      /* its metadata has been read in */
+#define OBJECT_MEMBER       0x00000004      /* it's a member of an archive */
+
+/* an object's text and data are linked in pieces. piece 0 is the part
+   of its text segment before its first text section (all of it, if it
+   has no sections), piece 1 is the same for data, and piece n + 1 is
+   section n (see obj.h). section 0 is pieces 0 and 1 together. with -G,
+   only the pieces reachable from the entry point are linked. */
+
+#define PIECE_LIVE          0x00000001      /* this piece must be linked in the output */
+
+struct piece
+{
+    int                 segment;        /* OBJ_SYMBOL_SEG_TEXT or _DATA */
+    long                offset;         /* in the segment */
+    long                bytes;
+    int                 flags;
+    unsigned long       address;        /* where it's linked */
+    int                 first_reloc;    /* its relocations, in 'reloc_order' (-G) */
+};
 
 struct object
 {
-    char              * path;
-    FILE              * fp;
+    char              * path;           /* for messages */
+    char              * file;           /* the file that holds it */
+    char              * map;            /* which is mapped here */
+    long                map_bytes;
+    long                base;           /* and where it starts in that file */
     int                 flags;
     struct obj_header   header;
     struct obj_symbol * symbols;
     struct obj_reloc  * relocs;
     char              * names;
+    struct piece      * pieces;
+    int                 nr_pieces;
+    int               * reloc_order;    /* relocations, by piece (-G) */
     struct object     * next;
 };
 
@@ -77,10 +130,23 @@ char                   * out_path;
 char                   * entry;
 struct object          * first_object;
 struct object          * last_object;
-struct global          * buckets[NR_BUCKETS];
-char                     buffer[BUFFER_SIZE];
+struct table             globals = { "globals" };
+struct table             definitions = { "definitions" };
+char                   * image;
+long                     image_size;    /* bytes allocated */
+long                     image_bytes;   /* bytes used */
 int                      type = -1;
 int                      raw_flag;
+int                      H_flag;
+int                      G_flag;
+struct unit            * units;         /* stack of live sections to follow (-G) */
+int                      nr_units;
+int                      nr_threads;
+struct object         ** referenced;    /* the objects to link, in order */
+int                      nr_referenced;
+int                      next_referenced;   /* the next one for a thread */
+pthread_mutex_t          next_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_mutex_t          error_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* output an error message, clean up, and abort */
 
@@ -94,6 +160,7 @@ error(fmt)
 {
     va_list args;
 
+    pthread_mutex_lock(&error_lock);   /* never released: we exit */
     fprintf(stderr, "ld: ");
 
     va_start(args, fmt);
@@ -121,7 +188,7 @@ allocate(bytes)
     return p;
 }
 
-/* return the hash of a NUL-terminated string */
+/* return the (FNV-1a) hash of a NUL-terminated string */
 
 unsigned
 compute_hash(name)
@@ -130,30 +197,59 @@ compute_hash(name)
     unsigned hash;
     int      i;
 
-    for (i = 0, hash = 0; name[i]; i++) {
-        hash <<= 4;
+    for (i = 0, hash = 0x811C9DC5; name[i]; i++) {
         hash ^= (name[i] & 0xFF);
+        hash *= 16777619;
     }
 
     return hash;
 }
 
-/* look up a global symbol. returns NULL if not found. */
+/* double the size of a global table */
+
+grow_table(table)
+    struct table * table;
+{
+    struct global ** old_buckets = table->buckets;
+    int              nr_old_buckets = table->nr_buckets;
+    struct global  * global;
+    int              i, j;
+
+    table->nr_buckets = nr_old_buckets ? (nr_old_buckets * 2) : MIN_BUCKETS;
+    table->buckets = (struct global **) allocate(table->nr_buckets * sizeof(struct global *));
+    memset(table->buckets, 0, table->nr_buckets * sizeof(struct global *));
+
+    for (i = 0; i < nr_old_buckets; i++) {
+        while (global = old_buckets[i]) {
+            old_buckets[i] = global->link;
+            j = global->hash & (table->nr_buckets - 1);
+            global->link = table->buckets[j];
+            table->buckets[j] = global;
+        }
+    }
+
+    if (old_buckets) free(old_buckets);
+}
+
+/* look up a global symbol in a table. returns NULL if not found. */
 
 struct global *
-find_global(name)
-    char * name;
+lookup(table, name)
+    struct table * table;
+    char         * name;
 {
     struct global * global;
     unsigned        hash;
     int             i; 
     int             length;
 
+    if (table->nr_buckets == 0) return NULL;
+
     length = strlen(name);
     hash = compute_hash(name);
-    i = hash % NR_BUCKETS;
+    i = hash & (table->nr_buckets - 1);
 
-    for (global = buckets[i]; global; global = global->link) {
+    for (global = table->buckets[i]; global; global = global->link) {
         if (global->length != length) continue;
         if (global->hash != hash) continue;
         if (memcmp(global->name, name, length)) continue;
@@ -164,31 +260,80 @@ find_global(name)
     return global;
 }
 
-/* export a global symbol from an object. */
+/* add a global symbol to a table. the caller checks for duplicates. */
 
 struct global *
-export(name, symbol)
+insert(table, name, symbol, object)
+    struct table      * table;
     char              * name;
     struct obj_symbol * symbol;
+    struct object     * object;
 {
     struct global * global;
     unsigned        hash;
     int             i;
 
-    if (find_global(name)) error("multiple definitions for '%s'", name);
+    if (table->nr_entries++ == table->nr_buckets) grow_table(table);
     hash = compute_hash(name);
-    i = hash % NR_BUCKETS;
+    i = hash & (table->nr_buckets - 1);
     global = (struct global *) allocate(sizeof(struct global));
-    global->link = buckets[i];
-    buckets[i] = global;
+    global->link = table->buckets[i];
+    table->buckets[i] = global;
     global->name = name;
     global->hash = hash;
     global->length = strlen(name);
     global->symbol = symbol;
+    global->object = object;
 
     return global;
 }
 
+/* look up a global symbol exported by a referenced object */
+
+struct global *
+find_global(name)
+    char * name;
+{
+    return lookup(&globals, name);
+}
+
+/* export a global symbol from an object. */
+
+struct global *
+export(name, symbol, object)
+    char              * name;
+    struct obj_symbol * symbol;
+    struct object     * object;
+{
+    if (find_global(name)) error("multiple definitions for '%s'", name);
+    return insert(&globals, name, symbol, object);
+}
+
+/* print statistics about a global table to stderr */
+
+table_stats(table)
+    struct table * table;
+{
+    struct global * global;
+    int             longest = 0;
+    int             used = 0;
+    int             length;
+    int             i;
+
+    for (i = 0; i < table->nr_buckets; i++) {
+        for (length = 0, global = table->buckets[i]; global; global = global->link) ++length;
+        if (length) ++used;
+        if (length > longest) longest = length;
+    }
+
+    if (table->nr_buckets)
+        fprintf(stderr, "%s: %d entries, %d buckets, load %d.%02d, "
+                        "%d buckets used, longest chain %d\n",
+                        table->title, table->nr_entries, table->nr_buckets,
+                        table->nr_entries / table->nr_buckets,
+                        (table->nr_entries * 100 / table->nr_buckets) % 100, used, longest);
+}
+
 /* write global symbols out (debugging data) */
 
 debug_info()
@@ -197,8 +342,9 @@ debug_info()
     int             i;
     long            value;
 
-    for (i = 0; i < NR_BUCKETS; i++) {
-        for (global = buckets[i]; global; global = global->link) {
+    for (i = 0; i < globals.nr_buckets; i++) {
+        for (global = globals.buckets[i]; global; global = global->link) {
+            if (!live_symbol(global->object, global->symbol)) continue;
             value = global->symbol->value;
             output(current_address - base_address, global->name, global->length + 1);
             current_address += global->length + 1;
@@ -212,98 +358,278 @@ debug_info()
     }
 }
 
-/* error-free I/O with output file */
+/* make sure the output image has room for 'bytes' bytes. the
+   image is zero-filled, so any gaps in the output are zeroes. */
 
-output(position, buffer, length)
-    char * buffer;
+reserve(bytes)
+    long bytes;
 {
-    if (fseek(out_fp, (long) position, SEEK_SET))
-        error("can't seek output file '%s'", out_fp);
+    long size;
+
+    if (bytes > image_size) {
+        size = image_size ? image_size : MIN_IMAGE;
+        while (size < bytes) size *= 2;
+        image = realloc(image, size);
+        if (image == NULL) error("out of memory");
+        memset(image + image_size, 0, size - image_size);
+        image_size = size;
+    }
 
-    if (fwrite(buffer, sizeof(char), sizeof(char) * length, out_fp) != (sizeof(char) * length))
-        error("error writing output '%s'", out_path);
+    if (bytes > image_bytes) image_bytes = bytes;
 }
 
-input(position, buffer, length)
+/* write to the output image */
+
+output(position, buffer, length)
     char * buffer;
 {
-    if (fseek(out_fp, (long) position, SEEK_SET))
-        error("can't seek output file '%s'", out_fp);
-
-    if (fread(buffer, sizeof(char), sizeof(char) * length, out_fp) != (sizeof(char) * length))
-        error("error reading output '%s'", out_path, length);
+    reserve((long) position + length);
+    memcpy(image + position, buffer, length);
 }
 
-/* copy segment from object to output file */
-
-#define MIN(a,b)        (((a) < (b)) ? (a) : (b))
+/* copy segment from object straight into the output image,
+   where reserve() has already made room for it */
 
 copy_segment(object, from, to, length)
     struct object * object;
+    long            to;
 {
-    int size;
+    read_object(object, from, image + to, length);
+}
 
-    while (length) {
-        size = MIN(length, BUFFER_SIZE);
-        read_object(object, from, buffer, size);
-        output(to, buffer, size);
-        length -= size;
-        from += size;
-        to += size;
-    }
+/* write the output image to the output file */
+
+flush_output()
+{
+    if (fwrite(image, sizeof(char), image_bytes, out_fp) != image_bytes)
+        error("error writing output '%s'", out_path);
+
+    if (fflush(out_fp)) error("error writing output '%s'", out_path);
 }
 
-/* error-free input from the object file */
+/* error-free input from the object file. 'position' is relative
+   to the start of the object, which may be inside an archive. */
 
 read_object(object, position, buffer, length)
     struct object * object;
     char          * buffer;
 {
-    if (fseek(object->fp, (long) position, SEEK_SET))
-        error("can't seek input file '%s'", object->path);
+    if ((position < 0) || (length < 0) || ((object->base + position + length) > object->map_bytes))
+        error("'%s' is truncated or corrupt", object->path);
 
-    if (fread(buffer, sizeof(char), sizeof(char) * length, object->fp) != (sizeof(char) * length))
-        error("error reading object '%s'", object->path);
+    memcpy(buffer, object->map + object->base + position, length);
 }
 
-/* at some point it may make more sense to simply keep 
-   all the files open, but for now we open and close them
-   to keep the number of file handles to a minimum. */
+/* map an input file into memory. it stays mapped for the whole link,
+   shared by all the objects in it, so each file is opened only once. */
 
-open_object(object)
-    struct object * object;
+char *
+map_file(path, bytes)
+    char * path;
+    long * bytes;
 {
-    object->fp = fopen(object->path, "r");
-    if (object->fp == NULL) error("'%s': can't open", object->path);
-}
+    struct stat   st;
+    char        * map;
+    int           fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) error("'%s': can't open", path);
+    if (fstat(fd, &st) == -1) error("'%s': can't stat", path);
+    *bytes = st.st_size;
+    map = NULL;
+
+    if (*bytes) {
+        map = mmap(NULL, (size_t) *bytes, PROT_READ, MAP_PRIVATE, fd, (off_t) 0);
+        if (map == MAP_FAILED) error("'%s': can't map", path);
+    }
 
-close_object(object)
-    struct object * object;
-{
-    fclose(object->fp);
-    object->fp = NULL;
+    close(fd);
+    return map;
 }
 
-/* create a new object, and read in its metadata */
+/* create a new object, but don't read it yet. it's found in 'file' (which
+   is mapped at 'map') at offset 'base': for an archive member, the offset
+   of its header. */
 
 struct object *
-new_object(path)
+new_object(path, file, map, map_bytes, base, flags)
     char * path;
+    char * file;
+    char * map;
+    long   map_bytes;
+    long   base;
 {
     struct object * object;
-    FILE          * fp;
-    int             size;
 
     object = (struct object *) allocate(sizeof(struct object));
     object->path = path;
-    object->flags = 0;
+    object->file = file;
+    object->map = map;
+    object->map_bytes = map_bytes;
+    object->base = base;
+    object->flags = flags;
     object->symbols = NULL;
     object->relocs = NULL;
     object->names = NULL;
+    object->pieces = NULL;
+    object->nr_pieces = 0;
+    object->reloc_order = NULL;
     object->next = NULL;
-    open_object(object);
+    return object;
+}
+
+/* convert an ASCII field of an archive member header to a number */
+
+long
+ar_field(field, length, radix)
+    char * field;
+{
+    char buf[16];
+
+    memcpy(buf, field, length);
+    buf[length] = 0;
+    return strtol(buf, NULL, radix);
+}
+
+/* the object is an archive member, and 'base' is the offset of its
+   header. read the header to find the member's name, so messages can
+   refer to it as "archive(member)", then point 'base' at its data. */
+
+locate_member(object)
+    struct object * object;
+{
+    struct ar_hdr   hdr;
+    char          * name;
+    long            header;
+    long            position;
+    long            size;
+    int             length;
+
+    header = object->base;
+    read_object(object, 0, &hdr, sizeof(hdr));
+    if (memcmp(hdr.ar_fmag, ARFMAG, sizeof(hdr.ar_fmag)))
+        error("'%s': bad archive member at offset %ld", object->file, header);
+
+    length = 0;
+
+    if (!memcmp(hdr.ar_name, AR_EFMT1, strlen(AR_EFMT1))) {
+        length = ar_field(hdr.ar_name + strlen(AR_EFMT1), sizeof(hdr.ar_name) - strlen(AR_EFMT1), 10);
+        name = allocate(length + 1);
+        read_object(object, sizeof(hdr), name, length);
+        name[length] = 0;
+    } else if ((hdr.ar_name[0] == '/') && (hdr.ar_name[1] >= '0') && (hdr.ar_name[1] <= '9')) {
+        /* GNU-style: the name is in the "//" member, which
+           precedes all the members that refer to it */
+
+        position = ar_field(hdr.ar_name + 1, sizeof(hdr.ar_name) - 1, 10);
+        object->base = SARMAG;
+
+        for (;;) {
+            read_object(object, 0, &hdr, sizeof(hdr));
+            size = ar_field(hdr.ar_size, sizeof(hdr.ar_size), 10);
+            if (!memcmp(hdr.ar_name, AR_STRTAB " ", strlen(AR_STRTAB) + 1)) break;
+            if (object->base >= header) error("'%s': no long name table", object->file);
+            object->base += sizeof(hdr) + ALIGN(size, 2);
+        }
+
+        if (position >= size) error("'%s': bad long name at offset %ld", object->file, header);
+        name = allocate(size - position + 1);
+        read_object(object, sizeof(hdr) + position, name, size - position);
+        name[size - position] = 0;
+        name[strcspn(name, "/\n")] = 0;
+    } else {
+        name = allocate(sizeof(hdr.ar_name) + 1);
+        memcpy(name, hdr.ar_name, sizeof(hdr.ar_name));
+        name[sizeof(hdr.ar_name)] = 0;
+        name[strcspn(name, " /")] = 0;
+    }
+
+    object->path = allocate(strlen(object->file) + strlen(name) + 3);
+    sprintf(object->path, "%s(%s)", object->file, name);
+    free(name);
+    object->base = header + sizeof(hdr) + length;
+}
+
+/* return the piece of 'object' that is in 'section' of 'segment' */
+
+struct piece *
+find_piece(object, section, segment)
+    struct object * object;
+{
+    if (section) return &object->pieces[section + 1];
+    return &object->pieces[(segment == OBJ_SYMBOL_SEG_TEXT) ? 0 : 1];
+}
+
+/* build the object's pieces from its section table */
+
+load_pieces(object)
+    struct object * object;
+{
+    struct obj_section   section;
+    struct piece       * piece;
+    struct piece       * rest;
+    struct obj_reloc   * reloc;
+    long                 size;
+    int                  i;
+
+    if (object->header.nr_sections > OBJ_MAX_SECTIONS)
+        error("too many sections in '%s'", object->path);
+
+    object->nr_pieces = object->header.nr_sections + 2;
+    object->pieces = (struct piece *) allocate(sizeof(struct piece) * object->nr_pieces);
+
+    for (i = 0, piece = object->pieces; i < object->nr_pieces; ++i, ++piece) {
+        piece->flags = 0;
+        piece->address = 0;
+        piece->first_reloc = 0;
+
+        if (i < 2) {
+            piece->segment = i ? OBJ_SYMBOL_SEG_DATA : OBJ_SYMBOL_SEG_TEXT;
+            piece->offset = 0;
+            piece->bytes = i ? object->header.data_bytes : object->header.text_bytes;
+            continue;
+        }
+
+        read_object(object, OBJ_SECTION_OFFSET(object->header, i - 1), &section, sizeof(section));
+        piece->segment = section.flags;
+        piece->offset = section.offset;
+        piece->bytes = section.bytes;
+
+        switch (piece->segment)
+        {
+        case OBJ_SYMBOL_SEG_TEXT:   size = object->header.text_bytes; break;
+        case OBJ_SYMBOL_SEG_DATA:   size = object->header.data_bytes; break;
+        default:                    size = -1;
+        }
+
+        if ((piece->offset + piece->bytes) > size)
+            error("bad section %d in '%s'", i - 1, object->path);
+
+        /* what's before the first section of the segment is cut short by it */
+
+        rest = find_piece(object, 0, piece->segment);
+        if (rest->bytes > piece->offset) rest->bytes = piece->offset;
+    }
+
+    for (i = 0, reloc = object->relocs; i < object->header.nr_relocs; ++i, ++reloc)
+        if (reloc->section > object->header.nr_sections)
+            error("bad section for relocation in '%s'", object->path);
+}
+
+/* read in an object's metadata, add its definitions
+   to the index, and put it on the list of objects. */
+
+load_object(object)
+    struct object * object;
+{
+    struct obj_symbol * symbol;
+    char              * name;
+    int                 size;
+    int                 i;
+
+    if (object->flags & OBJECT_MEMBER) locate_member(object);
     read_object(object, 0, &object->header, sizeof(object->header));
-    if (object->header.magic != OBJ_MAGIC) error("'%s' is not an object file", path);
+    if (object->header.magic != OBJ_MAGIC) error("'%s' is not an object file", object->path);
 
     if (object->header.nr_symbols) {
         size = sizeof(struct obj_symbol) * object->header.nr_symbols;
@@ -322,6 +648,17 @@ new_object(path)
         read_object(object, OBJ_NAMES_OFFSET(object->header), object->names, object->header.name_bytes);
     }
 
+    load_pieces(object);
+
+    for (i = 0, symbol = object->symbols; i < object->header.nr_symbols; ++i, ++symbol) {
+        if (OBJ_SYMBOL_GET_SECTION(*symbol) > object->header.nr_sections)
+            error("bad section for symbol in '%s'", object->path);
+
+        if (!(symbol->flags & OBJ_SYMBOL_DEFINED) || !(symbol->flags & OBJ_SYMBOL_GLOBAL)) continue;
+        name = object->names + symbol->index;
+        if (!lookup(&definitions, name)) insert(&definitions, name, symbol, object);
+    }
+
     if (last_object == NULL) {
         first_object = object;
         last_object = object;
@@ -330,33 +667,114 @@ new_object(path)
         last_object = object;
     }
 
-    close_object(object);
+    object->flags |= OBJECT_LOADED;
+}
+
+/* qsort() comparison of ranlib entries, by member offset */
+
+compare_ranlibs(a, b)
+    struct ranlib * a;
+    struct ranlib * b;
+{
+    if (a->ran_off < b->ran_off) return -1;
+    if (a->ran_off > b->ran_off) return 1;
+    return 0;
+}
+
+/* read the symbol directory of an archive, and make an unloaded object
+   for each member named in it. the members' definitions go into the
+   index now; the members themselves are loaded only when imported. */
+
+read_archive(path, map, map_bytes)
+    char * path;
+    char * map;
+    long   map_bytes;
+{
+    struct object * archive;
+    struct object * object;
+    struct ar_hdr   hdr;
+    struct ranlib * ranlibs;
+    char          * strings;
+    char          * name;
+    int             ranlib_bytes;
+    int             string_bytes;
+    int             nr_ranlibs;
+    int             i;
+
+    archive = new_object(path, path, map, map_bytes, 0L, 0);
+    read_object(archive, SARMAG, &hdr, sizeof(hdr));
+
+    if (memcmp(hdr.ar_name, RANLIBMAG, strlen(RANLIBMAG))
+      || ((hdr.ar_name[strlen(RANLIBMAG)] != ' ') && (hdr.ar_name[strlen(RANLIBMAG)] != '/')))
+        error("'%s': archive has no symbol directory (run nranlib)", path);
+
+    archive->base = SARMAG + sizeof(hdr);
+    read_object(archive, 0, &ranlib_bytes, sizeof(ranlib_bytes));
+    read_object(archive, sizeof(ranlib_bytes) + ranlib_bytes, &string_bytes, sizeof(string_bytes));
+
+    if ((ranlib_bytes < 0) || (ranlib_bytes % sizeof(struct ranlib)) || (string_bytes < 0)
+      || ((sizeof(ranlib_bytes) + ranlib_bytes + sizeof(string_bytes) + string_bytes)
+          > ar_field(hdr.ar_size, sizeof(hdr.ar_size), 10)))
+        error("'%s': corrupt symbol directory", path);
+
+    nr_ranlibs = ranlib_bytes / sizeof(struct ranlib);
+    ranlibs = (struct ranlib *) allocate(ranlib_bytes + 1);
+    strings = allocate(string_bytes + 1);
+    read_object(archive, sizeof(ranlib_bytes), ranlibs, ranlib_bytes);
+    read_object(archive, sizeof(ranlib_bytes) + ranlib_bytes + sizeof(string_bytes), strings, string_bytes);
+    strings[string_bytes] = 0;
+    free(archive);
+
+    /* sort by offset, so each member's entries are together and it gets
+       one object. the first member to define a symbol then wins. */
+
+    qsort(ranlibs, nr_ranlibs, sizeof(struct ranlib), compare_ranlibs);
+
+    for (i = 0, object = NULL; i < nr_ranlibs; ++i) {
+        if ((ranlibs[i].ran_strx < 0) || (ranlibs[i].ran_strx >= string_bytes) || (ranlibs[i].ran_off < SARMAG))
+            error("'%s': corrupt symbol directory", path);
+
+        if (!object || (object->base != ranlibs[i].ran_off))
+            object = new_object(path, path, map, map_bytes, (long) ranlibs[i].ran_off, OBJECT_MEMBER);
+
+        name = strings + ranlibs[i].ran_strx;
+        if (!lookup(&definitions, name)) insert(&definitions, name, NULL, object);
+    }
+
+    free(ranlibs);
+}
+
+/* read an input file named on the command line: an object or an archive */
+
+read_input(path)
+    char * path;
+{
+    char * map;
+    long   map_bytes;
+
+    map = map_file(path, &map_bytes);
+
+    if ((map_bytes >= SARMAG) && !memcmp(map, ARMAG, SARMAG))
+        read_archive(path, map, map_bytes);
+    else
+        load_object(new_object(path, path, map, map_bytes, 0L, 0));
 }
 
 /* find the object that exports 'name' and reference it.
-   returns non-zero on success, or zero if not found. */
+   returns non-zero on success, or zero if not found. the
+   first object (in command-line order) to define it wins.
+   archive members are loaded now, when they're first needed. */
 
 import(name)
     char          * name;
 {
-    struct object     * object;
-    struct obj_symbol * symbol;
-    int                 i;
-    
-    for (object = first_object; object; object = object->next) {
-        if (object->flags & OBJECT_REFERENCED) continue;
-        symbol = object->symbols;
-
-        for (i = 0; i < object->header.nr_symbols; ++i, ++symbol) {
-            if (!(symbol->flags & OBJ_SYMBOL_DEFINED) || !(symbol->flags & OBJ_SYMBOL_GLOBAL)) continue;
-            if (!strcmp(object->names + symbol->index, name)) {
-                reference(object);
-                return 1;
-            }
-        }
-    }
+    struct global * definition;
 
-    return 0;
+    definition = lookup(&definitions, name);
+    if ((definition == NULL) || (definition->object->flags & OBJECT_REFERENCED)) return 0;
+    if (!(definition->object->flags & OBJECT_LOADED)) load_object(definition->object);
+    reference(definition->object);
+    return 1;
 }
 
 /* the object file has a symbol we need in the output, so mark
@@ -376,7 +794,7 @@ reference(object)
         name = object->names + symbol->index;
 
         if ((symbol->flags & OBJ_SYMBOL_DEFINED) && (symbol->flags & OBJ_SYMBOL_GLOBAL))
-            export(name, symbol);
+            export(name, symbol, object);
     }
 
     for (i = 0, symbol = object->symbols; i < object->header.nr_symbols; ++i, ++symbol) {
@@ -387,33 +805,220 @@ reference(object)
     }
 }
 
-/* bump the symbols/relocations in an object by 'offset' bytes.
-   'segment' is one of OBJ_SYMBOL_SEG_TEXT or OBJ_SYMBOL_SEG_DATA.
-   'flags' is one of OBJ_RELOC_TEXT or OBJ_RELOC_DATA. */
+/* with -G, a section is linked only if it can be reached from the entry
+   point, through the relocations in sections already known to be live.
+   'units' is a stack of live sections whose relocations haven't been
+   followed yet. with no sections, this works at the level of objects. */
+
+struct unit
+{
+    struct object     * object;
+    int                 section;
+};
+
+/* mark a section of an object live, and push it to be followed */
+
+mark(object, section)
+    struct object * object;
+{
+    static int      max_units;
+    struct piece  * piece;
+
+    piece = find_piece(object, section, OBJ_SYMBOL_SEG_TEXT);
+    if (piece->flags & PIECE_LIVE) return 0;
+    piece->flags |= PIECE_LIVE;
+    if (!section) find_piece(object, section, OBJ_SYMBOL_SEG_DATA)->flags |= PIECE_LIVE;
+
+    if (nr_units == max_units) {
+        max_units = max_units ? (max_units * 2) : 256;
+        units = (struct unit *) realloc(units, sizeof(struct unit) * max_units);
+        if (units == NULL) error("out of memory");
+    }
+
+    units[nr_units].object = object;
+    units[nr_units].section = section;
+    nr_units++;
+    return 1;
+}
+
+/* mark live the section that holds 'symbol', which is either
+   defined in 'object', or else by the object that exports it */
+
+mark_symbol(object, symbol)
+    struct object     * object;
+    struct obj_symbol * symbol;
+{
+    struct global * global;
+
+    if (!(symbol->flags & OBJ_SYMBOL_DEFINED)) {
+        global = find_global(object->names + symbol->index);
+        object = global->object;
+        symbol = global->symbol;
+    }
+
+    if ((OBJ_SYMBOL_GET_SEG(*symbol) == OBJ_SYMBOL_SEG_TEXT) || (OBJ_SYMBOL_GET_SEG(*symbol) == OBJ_SYMBOL_SEG_DATA))
+        mark(object, OBJ_SYMBOL_GET_SECTION(*symbol));
+}
+
+/* sort an object's relocations by piece into 'reloc_order', so
+   follow() can find those in a section without looking at them all */
+
+sort_relocs(object)
+    struct object * object;
+{
+    struct obj_reloc * reloc;
+    struct piece     * piece;
+    int              * next;
+    int                i;
+    int                n;
+
+    object->reloc_order = (int *) allocate(sizeof(int) * (object->header.nr_relocs + 1));
+    next = (int *) allocate(sizeof(int) * object->nr_pieces);
+    for (i = 0; i < object->nr_pieces; ++i) next[i] = 0;
+
+    for (i = 0, reloc = object->relocs; i < object->header.nr_relocs; ++i, ++reloc) {
+        piece = find_piece(object, reloc->section, (reloc->flags & OBJ_RELOC_TEXT) ? OBJ_SYMBOL_SEG_TEXT
+                                                                                   : OBJ_SYMBOL_SEG_DATA);
+        next[piece - object->pieces]++;
+    }
+
+    for (i = 0, n = 0; i < object->nr_pieces; ++i) {
+        object->pieces[i].first_reloc = n;
+        n += next[i];
+        next[i] = object->pieces[i].first_reloc;
+    }
+
+    for (i = 0, reloc = object->relocs; i < object->header.nr_relocs; ++i, ++reloc) {
+        piece = find_piece(object, reloc->section, (reloc->flags & OBJ_RELOC_TEXT) ? OBJ_SYMBOL_SEG_TEXT
+                                                                                   : OBJ_SYMBOL_SEG_DATA);
+        object->reloc_order[next[piece - object->pieces]++] = i;
+    }
+
+    free(next);
+}
+
+/* mark live everything referred to by the relocations in a section */
+
+follow(object, section)
+    struct object * object;
+{
+    struct obj_reloc * reloc;
+    int                i;
+    int                last;
+    int                p;
+
+    if (object->reloc_order == NULL) sort_relocs(object);
+
+    for (p = section ? (section + 1) : 0; p <= (section ? (section + 1) : 1); ++p) {
+        last = (p + 1 < object->nr_pieces) ? object->pieces[p + 1].first_reloc : object->header.nr_relocs;
+
+        for (i = object->pieces[p].first_reloc; i < last; ++i) {
+            reloc = &object->relocs[object->reloc_order[i]];
+            mark_symbol(object, &object->symbols[reloc->index]);
+        }
+    }
+}
+
+/* -G: find the live sections, starting from the entry point */
+
+collect()
+{
+    struct global * global;
+
+    if (!entry) error("no entry point (-e) specified");
+    global = find_global(entry);
+    if (!global) error("can't find global entry point '%s'", entry);
+    mark_symbol(global->object, global->symbol);
+
+    while (nr_units) {
+        nr_units--;
+        follow(units[nr_units].object, units[nr_units].section);
+    }
+}
+
+/* without -G, all of an object is live */
+
+keep(object)
+    struct object * object;
+{
+    int i;
+
+    for (i = 0; i < object->nr_pieces; ++i)
+        object->pieces[i].flags |= PIECE_LIVE;
+}
+
+/* is a symbol linked in the output? */
+
+live_symbol(object, symbol)
+    struct object     * object;
+    struct obj_symbol * symbol;
+{
+    if ((OBJ_SYMBOL_GET_SEG(*symbol) != OBJ_SYMBOL_SEG_TEXT) && (OBJ_SYMBOL_GET_SEG(*symbol) != OBJ_SYMBOL_SEG_DATA))
+        return 1;
+
+    return find_piece(object, OBJ_SYMBOL_GET_SECTION(*symbol), OBJ_SYMBOL_GET_SEG(*symbol))->flags & PIECE_LIVE;
+}
+
+/* print statistics about what -G left out */
+
+gc_stats()
+{
+    struct object * object;
+    long            total_bytes = 0;
+    long            live_bytes = 0;
+    int             total = 0;
+    int             live = 0;
+    int             i;
+
+    for (object = first_object; object; object = object->next) {
+        if (!(object->flags & OBJECT_REFERENCED)) continue;
+
+        for (i = 0; i < object->nr_pieces; ++i) {
+            if (!object->pieces[i].bytes) continue;
+            total++;
+            total_bytes += object->pieces[i].bytes;
+
+            if (object->pieces[i].flags & PIECE_LIVE) {
+                live++;
+                live_bytes += object->pieces[i].bytes;
+            }
+        }
+    }
+
+    fprintf(stderr, "gc: kept %d of %d pieces, %ld of %ld bytes\n", live, total, live_bytes, total_bytes);
+}
+
+/* move the symbols/relocations in 'segment' of an object to match the
+   addresses given to its pieces. 'segment' is one of OBJ_SYMBOL_SEG_TEXT
+   or OBJ_SYMBOL_SEG_DATA, and 'flags' the matching OBJ_RELOC_TEXT or
+   OBJ_RELOC_DATA. relocation targets become offsets in the image. */
 
-offset_symbols(object, segment, offset)
+offset_symbols(object, segment)
     struct object * object;
-    long            offset;
 {
     struct obj_symbol * symbol;
+    struct piece      * piece;
     int                 i;
 
     for (i = 0, symbol = object->symbols; i < object->header.nr_symbols; ++i, ++symbol) {
         if (!(symbol->flags & OBJ_SYMBOL_DEFINED)) continue;
         if (OBJ_SYMBOL_GET_SEG(*symbol) != segment) continue;
-        symbol->value += offset;
+        piece = find_piece(object, OBJ_SYMBOL_GET_SECTION(*symbol), segment);
+        symbol->value += piece->address - piece->offset;
     }
 }
 
-offset_relocs(object, flags, offset)
+offset_relocs(object, segment, flags)
     struct object * object;
 {
     struct obj_reloc * reloc;
+    struct piece     * piece;
     int                i;
 
     for (i = 0, reloc = object->relocs; i < object->header.nr_relocs; ++i, ++reloc) {
         if (!(reloc->flags & flags)) continue;
-        reloc->target += offset;
+        piece = find_piece(object, reloc->section, segment);
+        reloc->target += piece->address - piece->offset - base_address;
     }
 }
 
@@ -427,28 +1032,53 @@ pad(b, align)
     }
 }
 
+/* give an address to each live piece of 'segment' of the object, and make
+   room for it in the image. a piece is placed at the same offset, modulo
+   OBJ_ALIGN, as it had in the object, padding with 'b' as needed, so any
+   alignment within it is preserved. pieces are taken in the order they
+   appear in the segment, so when they're all live, the result is simply
+   the whole segment at an OBJ_ALIGN boundary. */
+
+place_pieces(object, segment, b)
+    struct object * object;
+{
+    struct piece * piece;
+    int            i;
+
+    for (i = 0, piece = object->pieces; i < object->nr_pieces; ++i, ++piece) {
+        if ((piece->segment != segment) || !(piece->flags & PIECE_LIVE)) continue;
+
+        while ((current_address - piece->offset) % OBJ_ALIGN) {
+            output(current_address - base_address, &b, 1);
+            current_address++;
+        }
+
+        piece->address = current_address;
+        current_address += piece->bytes;
+        reserve((long) (current_address - base_address));
+    }
+}
+
+/* the text_, data_ and bss_phase()s lay out the output: they assign
+   each object's pieces their addresses, adjusting its symbols and
+   relocations to match, and make room for them in the image. */
+
 text_phase(object)
     struct object * object;
 {
-    open_object(object);
-    copy_segment(object, OBJ_TEXT_OFFSET(object->header), current_address - base_address, object->header.text_bytes);
-    close_object(object);
-    offset_symbols(object, OBJ_SYMBOL_SEG_TEXT, current_address);
-    offset_relocs(object, OBJ_RELOC_TEXT, current_address - base_address);
-    current_address += object->header.text_bytes;
-    pad(0x90, 8); /* NOP */
+    place_pieces(object, OBJ_SYMBOL_SEG_TEXT, 0x90); /* NOP */
+    offset_symbols(object, OBJ_SYMBOL_SEG_TEXT);
+    offset_relocs(object, OBJ_SYMBOL_SEG_TEXT, OBJ_RELOC_TEXT);
+    pad(0x90, 8);
 }
 
 
 data_phase(object)
     struct object * object;
 {
-    open_object(object);
-    copy_segment(object, OBJ_DATA_OFFSET(object->header), current_address - base_address, object->header.data_bytes);
-    close_object(object);
-    offset_symbols(object, OBJ_SYMBOL_SEG_DATA, current_address);
-    offset_relocs(object, OBJ_RELOC_DATA, current_address - base_address);
-    current_address += object->header.data_bytes;
+    place_pieces(object, OBJ_SYMBOL_SEG_DATA, 0);
+    offset_symbols(object, OBJ_SYMBOL_SEG_DATA);
+    offset_relocs(object, OBJ_SYMBOL_SEG_DATA, OBJ_RELOC_DATA);
     pad(0, 8);
 }
 
@@ -471,17 +1101,39 @@ bss_phase(object)
 }
 
 
-reloc_phase(object)
+/* copy the object's segments into the image, and relocate them. this is
+   run by several threads at once, on different objects, so it must not
+   change anything shared: the layout is done, so the image won't grow,
+   the segments of different objects don't overlap, and the symbols and
+   globals are only read. */
+
+link_phase(object)
     struct object * object;
 {
     struct obj_reloc  * reloc;
     struct obj_symbol * symbol;
     struct global     * global;
+    struct piece      * piece;
+    int                 from;
     int                 i;
     long                value;
     int                 size;
 
+    for (i = 0, piece = object->pieces; i < object->nr_pieces; ++i, ++piece) {
+        if (!(piece->flags & PIECE_LIVE)) continue;
+
+        if (piece->segment == OBJ_SYMBOL_SEG_TEXT)
+            from = OBJ_TEXT_OFFSET(object->header) + piece->offset;
+        else
+            from = OBJ_DATA_OFFSET(object->header) + piece->offset;
+
+        copy_segment(object, from, (long) (piece->address - base_address), (int) piece->bytes);
+    }
+
     for (i = 0, reloc = object->relocs; i < object->header.nr_relocs; ++i, ++reloc) {
+        piece = find_piece(object, reloc->section, (reloc->flags & OBJ_RELOC_TEXT) ? OBJ_SYMBOL_SEG_TEXT
+                                                                                   : OBJ_SYMBOL_SEG_DATA);
+        if (!(piece->flags & PIECE_LIVE)) continue;
         symbol = & object->symbols[reloc->index];
 
         if (!(symbol->flags & OBJ_SYMBOL_DEFINED)) {
@@ -497,14 +1149,17 @@ reloc_phase(object)
         case OBJ_RELOC_SIZE_64: size = 8; break;
         }
 
-        input(reloc->target, &value, size);
+        if ((reloc->target + size) > image_bytes)
+            error("bad relocation in '%s'", object->path);
+
+        memcpy(&value, image + reloc->target, size);
 
         if (reloc->flags & OBJ_RELOC_REL) 
             value += symbol->value - (reloc->target + base_address);
         else 
             value += symbol->value;
 
-        output(reloc->target, &value, size);
+        memcpy(image + reloc->target, &value, size);
     }
 }
 
@@ -519,13 +1174,65 @@ walk_objects(f)
         if ((object->flags & OBJECT_REFERENCED)) f(object);
 }
 
+/* a link thread: run link_phase() on objects until there are none left */
+
+void *
+link_thread(arg)
+    void * arg;
+{
+    struct object * object;
+
+    for (;;) {
+        pthread_mutex_lock(&next_lock);
+        object = (next_referenced < nr_referenced) ? referenced[next_referenced++] : NULL;
+        pthread_mutex_unlock(&next_lock);
+        if (object == NULL) return NULL;
+        link_phase(object);
+    }
+}
+
+/* add an object to the 'referenced' array */
+
+add_referenced(object)
+    struct object * object;
+{
+    referenced[nr_referenced++] = object;
+}
+
+/* run link_phase() on all referenced objects, with 'nr_threads' threads.
+   the calling thread is one of them. */
+
+link_objects()
+{
+    pthread_t       threads[MAX_THREADS];
+    struct object * object;
+    int             i;
+
+    for (object = first_object, i = 0; object; object = object->next) ++i;
+    referenced = (struct object **) allocate(sizeof(struct object *) * i);
+    walk_objects(add_referenced);
+
+    if (nr_threads > nr_referenced) nr_threads = nr_referenced;
+
+    for (i = 1; i < nr_threads; ++i)
+        if (pthread_create(&threads[i], NULL, link_thread, NULL)) {
+            nr_threads = i;     /* make do with what we have */
+            break;
+        }
+
+    link_thread(NULL);
+
+    for (i = 1; i < nr_threads; ++i)
+        pthread_join(threads[i], NULL);
+}
+
 main(argc, argv)
     char *argv[];
 {
     struct global * global;
     int             opt;
 
-    while ((opt = getopt(argc, argv, "b:e:o:r")) != -1) {
+    while ((opt = getopt(argc, argv, "b:e:j:o:rGH")) != -1) {
         switch (opt)
         {
         case 'b':
@@ -536,6 +1243,12 @@ main(argc, argv)
             entry = optarg;
             break;
 
+        case 'j':
+            nr_threads = atoi(optarg);
+            if ((nr_threads < 1) || (nr_threads > MAX_THREADS))
+                error("number of threads (-j) must be 1 to %d", MAX_THREADS);
+            break;
+
         case 'o':
             out_path = optarg;
             break;
@@ -544,21 +1257,41 @@ main(argc, argv)
             raw_flag++;
             break;
 
+        case 'G':
+            G_flag++;
+            break;
+
+        case 'H':
+            H_flag++;
+            break;
+
         default:
             exit(1);
         }
     }
 
+    if (!nr_threads) {
+        nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+        if (nr_threads < 1) nr_threads = 1;
+        if (nr_threads > MAX_THREADS) nr_threads = MAX_THREADS;
+    }
+
     if (!out_path) error("no output file (-o) specified");
-    out_fp = fopen(out_path, "w+");
+    out_fp = fopen(out_path, "w");
     if (out_fp == NULL) error("can't open output '%s'", out_path);
 
     argv = &argv[optind];
     if (!*argv) error("no object file(s) specified");
-    while (*argv) new_object(*argv++);
+    while (*argv) read_input(*argv++);
 
+    if (!first_object) error("no object file(s) specified");
     reference(first_object);
 
+    if (G_flag)
+        collect();
+    else
+        walk_objects(keep);
+
     exec.a_magic = A_MAGIC;
 
     current_address = base_address;
@@ -572,7 +1305,7 @@ main(argc, argv)
     exec.a_data = current_address - base_address - exec.a_text;
 
     walk_objects(bss_phase); 
-    walk_objects(reloc_phase);
+    link_objects();
 
     /* write a.out header */
 
@@ -585,7 +1318,13 @@ main(argc, argv)
         output(0, &exec, sizeof(exec));
     }
 
+    flush_output();
     fclose(out_fp);
     chmod(out_path, 0755);
+    if (H_flag) {
+        table_stats(&globals);
+        table_stats(&definitions);
+        if (G_flag) gc_stats();
+    }
     exit(0);
 }
@@ -223,6 +223,7 @@ main(argc, argv)
             printf("  # symbols: %d\n", hdr.nr_symbols);
             printf("   # relocs: %d\n", hdr.nr_relocs);
             printf("  name size: %d\n", hdr.name_bytes);
+            printf(" # sections: %d\n", hdr.nr_sections);
             if (s_flag) obj_symbols();
             if (r_flag) obj_relocs();
         } else if (magic == A_MAGIC) {
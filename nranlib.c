@@ -0,0 +1,302 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org).
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "obj.h"
+#include "ar.h"
+
+/* nranlib builds the symbol directory which nld needs to link against
+   an archive, and makes it the first member. the archive is read into
+   memory whole, and the new archive is written to a temporary file
+   which is then renamed over the old one. */
+
+#define ALIGN(a,b)      (((a) % (b)) ? ((a) + ((b) - ((a) % (b)))) : (a))
+
+struct member
+{
+    long    header;         /* offset of member header in 'archive' */
+    long    size;           /* bytes of data, excluding the header */
+    int     nr_ranlibs;     /* number of directory entries */
+};
+
+char          * path;
+char          * tmp_path;
+FILE          * out_fp;
+char          * archive;
+long            archive_bytes;
+struct member * members;
+int             nr_members;
+struct ranlib * ranlibs;
+int             nr_ranlibs;
+char          * strings;
+int             string_bytes;
+
+error(msg)
+    char * msg;
+{
+    fprintf(stderr, "ranlib: ");
+    if (path) fprintf(stderr, "'%s': ", path);
+    fprintf(stderr, "%s\n", msg);
+
+    if (out_fp) {
+        fclose(out_fp);
+        unlink(tmp_path);
+    }
+
+    exit(1);
+}
+
+/* allocate or bust */
+
+char *
+allocate(bytes)
+    long bytes;
+{
+    char * p;
+
+    p = malloc(bytes ? bytes : 1);
+    if (p == NULL) error("out of memory");
+    return p;
+}
+
+/* convert an ASCII field of a member header to a number */
+
+long
+field(s, length, radix)
+    char * s;
+{
+    char buf[16];
+
+    memcpy(buf, s, length);
+    buf[length] = 0;
+    return strtol(buf, NULL, radix);
+}
+
+/* read the whole archive into memory */
+
+slurp()
+{
+    FILE * fp;
+
+    if (!(fp = fopen(path, "r"))) error("can't open");
+    if (fseek(fp, 0L, SEEK_END) || ((archive_bytes = ftell(fp)) < 0)) error("seek error");
+    rewind(fp);
+    archive = allocate(archive_bytes);
+    if (fread(archive, sizeof(char), archive_bytes, fp) != archive_bytes) error("read error");
+    fclose(fp);
+
+    if ((archive_bytes < SARMAG) || memcmp(archive, ARMAG, SARMAG)) error("not an archive");
+}
+
+/* add a directory entry for 'name', defined by the current member */
+
+add_ranlib(name, length)
+    char * name;
+{
+    static int ranlib_size;
+    static int string_size;
+
+    if (nr_ranlibs == ranlib_size) {
+        ranlib_size = ranlib_size ? (ranlib_size * 2) : 256;
+        ranlibs = (struct ranlib *) realloc(ranlibs, ranlib_size * sizeof(struct ranlib));
+        if (ranlibs == NULL) error("out of memory");
+    }
+
+    while ((string_bytes + length + 1) > string_size) {
+        string_size = string_size ? (string_size * 2) : 4096;
+        strings = realloc(strings, string_size);
+        if (strings == NULL) error("out of memory");
+    }
+
+    ranlibs[nr_ranlibs].ran_strx = string_bytes;
+    ranlibs[nr_ranlibs].ran_off = 0;    /* fixed up later */
+    ++nr_ranlibs;
+    ++members[nr_members].nr_ranlibs;
+
+    memcpy(strings + string_bytes, name, length);
+    string_bytes += length;
+    strings[string_bytes++] = 0;
+}
+
+/* the current member has 'bytes' bytes of data at 'data'.
+   if it's an object, add its defined globals to the directory. */
+
+scan_object(data, bytes)
+    char * data;
+    long   bytes;
+{
+    struct obj_header   header;
+    struct obj_symbol   symbol;
+    char              * name;
+    int                 i;
+
+    if (bytes < sizeof(header)) return 0;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != OBJ_MAGIC) return 0;
+
+    if ((OBJ_NAMES_OFFSET(header) + header.name_bytes) > bytes)
+        error("truncated object in archive");
+
+    for (i = 0; i < header.nr_symbols; ++i) {
+        memcpy(&symbol, data + OBJ_SYMBOL_OFFSET(header, i), sizeof(symbol));
+        if (!(symbol.flags & OBJ_SYMBOL_DEFINED) || !(symbol.flags & OBJ_SYMBOL_GLOBAL)) continue;
+        if (symbol.index >= header.name_bytes) error("bad symbol in archive member");
+        name = data + OBJ_NAMES_OFFSET(header) + symbol.index;
+        add_ranlib(name, strnlen(name, header.name_bytes - symbol.index));
+    }
+}
+
+/* walk the members of the archive, recording all but the old
+   directory (or a GNU symbol table), and scan each for symbols. */
+
+scan()
+{
+    struct ar_hdr   hdr;
+    long            position;
+    long            size;
+    int             skip;
+    static int      member_size;
+
+    for (position = SARMAG; position < archive_bytes; position += sizeof(hdr) + ALIGN(size, 2)) {
+        if ((position + sizeof(hdr)) > archive_bytes) error("truncated archive");
+        memcpy(&hdr, archive + position, sizeof(hdr));
+        if (memcmp(hdr.ar_fmag, ARFMAG, sizeof(hdr.ar_fmag))) error("bad member header");
+        size = field(hdr.ar_size, sizeof(hdr.ar_size), 10);
+        if ((size < 0) || ((position + sizeof(hdr) + size) > archive_bytes)) error("truncated archive");
+
+        if (!memcmp(hdr.ar_name, RANLIBMAG, strlen(RANLIBMAG))) continue;
+        if (!memcmp(hdr.ar_name, "/ ", 2)) continue;
+
+        if (nr_members == member_size) {
+            member_size = member_size ? (member_size * 2) : 256;
+            members = (struct member *) realloc(members, member_size * sizeof(struct member));
+            if (members == NULL) error("out of memory");
+        }
+
+        members[nr_members].header = position;
+        members[nr_members].size = size;
+        members[nr_members].nr_ranlibs = 0;
+
+        skip = 0;
+        if (!memcmp(hdr.ar_name, AR_EFMT1, strlen(AR_EFMT1)))
+            skip = field(hdr.ar_name + strlen(AR_EFMT1), sizeof(hdr.ar_name) - strlen(AR_EFMT1), 10);
+
+        if ((skip < 0) || (skip > size)) error("bad member name");
+        scan_object(archive + position + sizeof(hdr) + skip, size - skip);
+        ++nr_members;
+    }
+}
+
+/* write 'bytes' bytes from 'buffer' to the output */
+
+output(buffer, bytes)
+    char * buffer;
+    long   bytes;
+{
+    if (fwrite(buffer, sizeof(char), bytes, out_fp) != bytes) error("write error");
+}
+
+/* write the new archive: the directory first, then the
+   members, whose offsets are moved to make room for it. */
+
+rewrite()
+{
+    struct ar_hdr   hdr;
+    char            buf[sizeof(hdr) + 1];
+    long            directory_bytes;
+    long            position;
+    int             ranlib_bytes;
+    int             i, j, k;
+
+    directory_bytes = sizeof(ranlib_bytes) + (nr_ranlibs * sizeof(struct ranlib))
+                    + sizeof(string_bytes) + string_bytes;
+
+    position = SARMAG + sizeof(hdr) + ALIGN(directory_bytes, 2);
+
+    for (i = 0, k = 0; i < nr_members; ++i) {
+        for (j = 0; j < members[i].nr_ranlibs; ++j, ++k)
+            ranlibs[k].ran_off = position;
+
+        position += sizeof(hdr) + ALIGN(members[i].size, 2);
+    }
+
+    tmp_path = allocate(strlen(path) + 5);
+    sprintf(tmp_path, "%s.tmp", path);
+    if (!(out_fp = fopen(tmp_path, "w"))) error("can't create temporary file");
+
+    sprintf(buf, "%-16s%-12d%-6d%-6d%-8o%-10ld%2s", RANLIBMAG, 0, 0, 0, 0644, directory_bytes, ARFMAG);
+    output(ARMAG, (long) SARMAG);
+    output(buf, (long) sizeof(hdr));
+
+    ranlib_bytes = nr_ranlibs * sizeof(struct ranlib);
+    output(&ranlib_bytes, (long) sizeof(ranlib_bytes));
+    output(ranlibs, (long) ranlib_bytes);
+    output(&string_bytes, (long) sizeof(string_bytes));
+    output(strings, (long) string_bytes);
+    if (directory_bytes % 2) output("\n", 1L);
+
+    for (i = 0; i < nr_members; ++i) {
+        output(archive + members[i].header, sizeof(hdr) + members[i].size);
+        if (members[i].size % 2) output("\n", 1L);
+    }
+
+    if (fclose(out_fp)) {
+        out_fp = NULL;
+        unlink(tmp_path);
+        error("write error");
+    }
+
+    out_fp = NULL;
+    if (rename(tmp_path, path)) {
+        unlink(tmp_path);
+        error("can't replace archive");
+    }
+}
+
+main(argc, argv)
+    char * argv[];
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: nranlib archive ...\n");
+        exit(1);
+    }
+
+    for (++argv; *argv; ++argv) {
+        path = *argv;
+        nr_members = 0;
+        nr_ranlibs = 0;
+        string_bytes = 0;
+
+        slurp();
+        scan();
+        rewrite();
+        free(archive);
+    }
+
+    exit(0);
+}
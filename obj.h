@@ -24,7 +24,10 @@
 
 /* definitions for relocatable object modules (.o files) */
 
-#define OBJ_MAGIC   0x252A2131
+/* the magic number is changed whenever the format is: an object in
+   the older format, before sections, is rejected rather than misread. */
+
+#define OBJ_MAGIC   0x252A2132
 
 struct obj_header
 {
@@ -34,7 +37,8 @@ struct obj_header
     unsigned nr_symbols;
     unsigned nr_relocs;
     unsigned name_bytes;
-    unsigned reserved[2];
+    unsigned nr_sections;
+    unsigned reserved;
 };
 
 #define OBJ_SYMBOL_GLOBAL       0x80000000    
@@ -50,6 +54,8 @@ struct obj_header
 #define OBJ_SYMBOL_GET_ALIGN(sym)       ((sym).flags & 0x02)
 #define OBJ_SYMBOL_SET_ALIGN(sym,log2)  ((sym).flags = ((sym).flags & ~(0x02)) | ((log2) & 0x02))
 #define OBJ_SYMBOL_VALID_ALIGN(log2)    ((log2) <= 3)
+#define OBJ_SYMBOL_GET_SECTION(sym)     (((sym).flags >> 8) & OBJ_MAX_SECTIONS)
+#define OBJ_SYMBOL_SET_SECTION(sym,n)   ((sym).flags = ((sym).flags & ~(OBJ_MAX_SECTIONS << 8)) | (((n) & OBJ_MAX_SECTIONS) << 8))
 
 struct obj_symbol
 {
@@ -74,6 +80,25 @@ struct obj_reloc
     int      flags;
     unsigned index;             /* into symbol section of referenced symbol */
     unsigned target;            /* offset to fixup in target segment */
+    unsigned section;           /* which contains 'target' */
+};
+
+/* the text and data segments can be divided into sections (one per
+   function or datum, say) so the linker can leave out the ones that
+   aren't used. sections are numbered from 1, in the order they appear
+   in the table, and each covers the bytes of its segment from 'offset'
+   up to the next section in the same segment. section 0 covers what
+   comes before the first section in each segment: all of it, in an
+   object that has no sections. a defined text or data symbol, and a
+   relocation, each record the section they are in. */
+
+#define OBJ_MAX_SECTIONS        0x003FFFFF
+
+struct obj_section
+{
+    int      flags;             /* OBJ_SYMBOL_SEG_TEXT or OBJ_SYMBOL_SEG_DATA */
+    unsigned offset;            /* in the segment */
+    unsigned bytes;
     unsigned reserved;
 };
 
@@ -91,4 +116,6 @@ struct obj_reloc
 #define OBJ_RELOC_OFFSET(hdr,n)     (OBJ_RELOCS_OFFSET(hdr) + ((n) * sizeof(struct obj_reloc)))
 #define OBJ_NAMES_OFFSET(hdr)       (OBJ_RELOCS_OFFSET(hdr) + ((hdr).nr_relocs * sizeof(struct obj_reloc)))
 #define OBJ_NAME_OFFSET(hdr,n)      (OBJ_NAMES_OFFSET(hdr) + (n))
+#define OBJ_SECTIONS_OFFSET(hdr)    (OBJ_NAMES_OFFSET(hdr) + OBJ_ROUNDUP((hdr).name_bytes))
+#define OBJ_SECTION_OFFSET(hdr,n)   (OBJ_SECTIONS_OFFSET(hdr) + (((n) - 1) * sizeof(struct obj_section)))
 
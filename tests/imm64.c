@@ -0,0 +1,26 @@
+/* constant propagation must not turn a store of a 64-bit constant into a
+   store of an immediate, which only a MOV to a register can take. */
+
+long g;
+long arr[4];
+
+store(i)
+    long i;
+{
+    long big;
+
+    big = 0x123456789AL;
+    g = big;
+    arr[i] = big;
+    arr[i + 1] = -big;
+}
+
+main()
+{
+    store(1L);
+    say("a", g);
+    say("b", arr[1]);
+    say("c", arr[2]);
+    flush();
+    return 0;
+}
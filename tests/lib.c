@@ -0,0 +1,67 @@
+/* the little runtime the test programs are linked with: output
+   is buffered and must be flushed before returning from main(). */
+
+static char buf[4096];
+static int  next;
+
+flush()
+{
+    write(1, buf, next);
+    next = 0;
+}
+
+putch(c)
+{
+    buf[next++] = c;
+    if (next == sizeof(buf)) flush();
+}
+
+/* never called: linked with -G, it's left out, and what follows it
+   moves down to fill the gap. */
+
+static char tallies[256];
+
+tally(s)
+    char * s;
+{
+    while (*s) tallies[*s++]++;
+}
+
+puts(s)
+    char * s;
+{
+    while (*s) putch(*s++);
+}
+
+putn(n)
+    long n;
+{
+    char          digits[24];
+    int           i = 0;
+    unsigned long u;
+
+    if (n < 0) {
+        putch('-');
+        u = -n;
+    } else
+        u = n;
+
+    do {
+        digits[i++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+
+    while (i) putch(digits[--i]);
+}
+
+/* print a tag and a value on a line, e.g., "x 42" */
+
+say(s, n)
+    char * s;
+    long   n;
+{
+    puts(s);
+    putch(' ');
+    putn(n);
+    putch('\n');
+}
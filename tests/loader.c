@@ -0,0 +1,75 @@
+/* Copyright (c) 2018 Charles E. Youse (charles@gnuless.org). 
+   All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ * Redistributions of source code must retain the above copyright notice, this
+   list of conditions and the following disclaimer.
+
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+ FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE. */
+
+/* run a bsd/64 a.out on the build host, so the test programs can be
+   executed without a bsd/64 system. the executable must be linked at
+   LOADER_BASE (nld -b); its text and data are read there and control
+   passes to the entry point. the programs talk to the host kernel
+   directly through the system call stubs in start.s. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "../a.out.h"
+
+#define LOADER_BASE     0x10000000
+#define LOADER_SIZE     (64 << 20)      /* text, data, bss and heap */
+
+main(argc, argv)
+    char * argv[];
+{
+    struct exec   exec;
+    char        * base = (char *) LOADER_BASE;
+    FILE        * fp;
+
+    if (argc != 2) {
+        fprintf(stderr, "usage: loader a.out\n");
+        exit(1);
+    }
+
+    fp = fopen(argv[1], "r");
+    if (fp == NULL) {
+        fprintf(stderr, "loader: can't open '%s'\n", argv[1]);
+        exit(1);
+    }
+
+    if ((fread(&exec, sizeof(exec), 1, fp) != 1) || (exec.a_magic != A_MAGIC)) {
+        fprintf(stderr, "loader: '%s' is not an executable\n", argv[1]);
+        exit(1);
+    }
+
+    if (mmap(base, LOADER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) != base)
+    {
+        fprintf(stderr, "loader: can't map memory\n");
+        exit(1);
+    }
+
+    rewind(fp);
+    fread(base, 1, exec.a_text + exec.a_data, fp);
+    fclose(fp);
+
+    ((void (*)()) (unsigned long) exec.a_entry)();
+    exit(1);    /* not reached: the program exits itself */
+}
@@ -0,0 +1,195 @@
+/* loops, for the hoisting of invariants and the strength reduction of
+   induction variables: counters of every size and sign, stepping up and
+   down, conditionally, or out early, indexing arrays of scalars and of
+   structs (whose addresses are hoisted out of the loop). */
+
+struct q
+{
+    long  a;
+    int   b;
+    char  c;
+};
+
+struct q    qa[20];
+long        ga[64];
+int         gi[64];
+short       gs[64];
+char        gc[256];
+
+init()
+{
+    int i;
+
+    for (i = 0; i < 64; ++i) {
+        ga[i] = i * 3 - 40;
+        gi[i] = 100 - i * 7;
+        gs[i] = i * i;
+    }
+
+    for (i = 0; i < 256; ++i) gc[i] = i;
+}
+
+/* the increment only happens on some trips */
+
+long
+conditional(n)
+{
+    long s = 0;
+    int  i = 0;
+    int  k;
+
+    for (k = 0; k < n; ++k) {
+        s += ga[i] * k;
+        if (k % 3 == 0) ++i;
+    }
+
+    return s * 1000 + i;
+}
+
+long
+breaks(n)
+{
+    long s = 0;
+    int  i;
+
+    for (i = 0; i < n; ++i) {
+        if (gi[i] < 0) break;
+        if (i & 1) continue;
+        s += gi[i] + ga[i];
+    }
+
+    return s * 100 + i;
+}
+
+long
+negative(n)
+{
+    long s = 0;
+    int  i;
+
+    for (i = n; i > 0; i -= 3)
+        s = s * 3 + ga[i] - gs[i];
+
+    return s;
+}
+
+long
+chars()
+{
+    long          s = 0;
+    char          c;
+    unsigned char u;
+
+    for (c = 10; c < 100; c += 7) s += gc[c] * c;
+    for (u = 250; u != 4; ++u) s = s * 2 + gc[u];
+
+    return s;
+}
+
+long
+shorts()
+{
+    long  s = 0;
+    short h;
+
+    for (h = 63; h >= 0; --h) s += gs[h] * h + ga[h];
+
+    return s;
+}
+
+long
+unsigneds()
+{
+    long     s = 0;
+    unsigned u;
+
+    for (u = 0; u < 60; u += 4) s += gi[u] * u;
+    for (u = 5; u + 1 != 0; --u) s = s * 5 + ga[u * 2];
+
+    return s;
+}
+
+long
+two()
+{
+    long s = 0;
+    int  i, j;
+
+    for (i = 0, j = 63; i < j; ++i, j -= 2)
+        s += ga[i] * gi[j] - gs[j - i];
+
+    return s * 100 + i * 10 + j;
+}
+
+long
+structs(n)
+{
+    long s = 0;
+    int  i;
+
+    for (i = 0; i < n; ++i) {
+        qa[i].a = i * 11;
+        qa[i].b = i - 5;
+        qa[i].c = i * 3;
+    }
+
+    for (i = n - 1; i >= 0; i -= 2)
+        s = s * 7 + qa[i].a + qa[i].b + qa[i].c;
+
+    return s;
+}
+
+long
+locals()
+{
+    long a[16];
+    long s = 0;
+    int  i, k;
+
+    for (i = 0; i < 16; ++i) a[i] = i * i;
+
+    for (k = 1; k < 4; ++k)
+        for (i = 15; i >= k; --i)
+            a[i] += a[i - k] + ga[i * k];
+
+    for (i = 0; i < 16; ++i) s = s * 3 + a[i];
+
+    return s;
+}
+
+/* the loop writes memory through a pointer, so only the addresses,
+   not the loads, can be hoisted */
+
+long
+writes(p)
+    long * p;
+{
+    long s = 0;
+    int  i;
+
+    for (i = 0; i < 10; ++i) {
+        *p += ga[i];
+        s += ga[5] + *p;
+    }
+
+    return s;
+}
+
+main()
+{
+    init();
+
+    say("a", conditional(40));
+    say("b", breaks(64));
+    say("c", negative(50));
+    say("d", chars());
+    say("e", shorts());
+    say("f", unsigneds());
+    say("g", two());
+    say("h", structs(20));
+    say("i", locals());
+    say("j", writes(&ga[5]));
+    say("k", ga[5]);
+    flush();
+    return 0;
+}
@@ -0,0 +1,129 @@
+/* calls nested in the argument lists of other calls. with -mregparm,
+   the arguments already loaded into registers for the outer call must
+   survive the inner ones, however many arguments and of whatever type. */
+
+#ifdef __GNUC__
+typedef double dbl;
+#else
+typedef long float dbl;
+#endif
+
+short           s0 = -30566;
+char            c0 = -7;
+unsigned char   uc = 200;
+long            g = 5;
+
+long add(a, b) long a, b; { return a + b; }
+long sub(a, b) long a, b; { return a - b; }
+long sub3(a, b, c) long a, b, c; { return a - b - c; }
+short neg(s) short s; { return -s; }
+char twice(c) char c; { return c + c; }
+long sel(p, i) long *p; long i; { return p[i]; }
+long peek(p) long *p; { return *p; }
+long fact(n) long n; { return (n <= 1) ? 1 : n * fact(n - 1); }
+long unused(a, b, c) long a, b, c; { return c; }
+long swap(a, b) long a, b; { return sub(b, a); }
+
+long
+six(a, b, c, d, e, f)
+    long a, b, c, d, e, f;
+{
+    return a + 2 * b + 3 * c + 4 * d + 5 * e + 6 * f;
+}
+
+long
+eight(a, b, c, d, e, f, g, h)
+    long a, b, c, d, e, f, g, h;
+{
+    return a - b + c - d + e - f + g - h;
+}
+
+long
+many(a, b, c, d, e, f, g, h, i)
+    long a, b, c, d, e, f, g, h, i;
+{
+    return a + b * 2 + c * 3 + d * 4 + e * 5 + f * 6 + g * 7 + h * 8 + i * 9;
+}
+
+long
+deep(a, b, c)
+    long a, b, c;
+{
+    return sub(sub(c, b), sub(a, sub(b, c))) + many(a, b, c, a, b, c, a, b, sub(c, a));
+}
+
+long
+addr(a, b)
+    long a, b;
+{
+    long * p;
+
+    p = &b;
+    *p += a;
+    return peek(&a) * 100 + b;
+}
+
+long
+chars(a, b, c)
+    char           a;
+    short          b;
+    unsigned char  c;
+{
+    return a * 10000 + b * 10 + c;
+}
+
+long
+fl(a, x, b)
+    long  a;
+    float x;
+    long  b;
+{
+    return a + (long) (x * 4) + b;
+}
+
+long
+mixed(a, x, b, y, c, z, d, w, e, v, f)
+    long a, b, c, d, e, f;
+    dbl  x, y, z, w, v;
+{
+    return a + b * 10 + c * 100 + d * 1000 + e * 10000 + f * 100000
+             + (long) (x + y * 10 + z * 100 + w * 1000 + v * 10000);
+}
+
+main()
+{
+    long  arr[4];
+    long  i;
+    short s;
+
+    arr[0] = 1; arr[1] = 2; arr[2] = 3; arr[3] = 4;
+    s = s0;
+
+    say("a", (long) s0);
+    say("b", (long) s);
+    say("c", (long) neg(s0));
+    say("d", (long) neg(neg(s)));
+    say("e", add((long) s, add((long) c0, (long) twice(c0))));
+    say("f", sub3(add(g, 1L), sub3(10L, (long) s0, add(2L, 3L)), (long) uc));
+    say("g", six(1L, add(1L, 1L), 3L, sub3(9L, 3L, 2L), add(g, 0L), six(0L, 0L, 0L, 0L, 0L, 1L)));
+    say("h", eight(1L, 2L, add(3L, 4L), 4L, 5L, six(1L, 1L, 1L, 1L, 1L, 1L), 7L, (long) s0));
+
+    for (i = 0; i < 4; ++i)
+        say("i", sel(arr, add(i, 0L)) + sel(arr, 3L - i) * 10);
+
+    say("j", add((long) ((s0 < 0) ? neg(s0) : s0), (long) ((c0 > 0) ? 1 : twice(c0))));
+    say("k", (long) (short) add((long) s0, add((long) s0, 0L)));
+    say("l", addr(3L, 4L));
+    say("m", chars(-5, -300, 250));
+    say("n", fl(1L, (float) 2.5, 3L));
+    say("o", many(1L, 2L, 3L, 4L, 5L, 6L, 7L, 8L, 9L));
+    say("p", mixed(1L, (dbl) 1, 2L, (dbl) 2, 3L, (dbl) 3, 4L, (dbl) 4, 5L, (dbl) 5, 6L));
+    say("q", fact(10L));
+    say("r", unused(1L, 2L, 3L));
+    say("s", swap(7L, 2L));
+    say("t", deep(3L, 5L, 11L));
+    say("u", deep(sub(g, 1L), deep(1L, 2L, 3L), fact(4L)));
+
+    flush();
+    return 0;
+}
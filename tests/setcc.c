@@ -0,0 +1,76 @@
+/* reduced from a generated program that came out differently from run to
+   run at -O: SETcc only writes the low byte of its register, so the rest
+   of the register, cleared beforehand, must not be given to another value. */
+
+long g0 = -8;
+long g1 = -21;
+long g2 = -29;
+long g3 = -1;
+int h0 = 23;
+int h1 = 38;
+char c0 = -28;
+short s0 = 1530;
+unsigned u0 = 1133;
+long arr[8];
+long f0(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    a = ((-21 > g1) << ((y >> (b & 7)) & 7));
+    return (((-2 >> (h1 & 7)) % (((c0 ^ -23) & 7) + 1)) << (h1 & 7));
+}
+long f1(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    a = (z & (g3 & -12));
+    i0 = 1;
+    return (((18 | -11) ? (arr[z & 7] + -11) : 8) + -1);
+}
+long f3(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    i0 = 1;
+    return arr[s0 & 7];
+}
+long f4(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    i0 = 3;
+    do {
+    } while (--i0 > 0);
+    return (((h1 | s) >= (u0 / ((a & 7) + 1))) ^ (g0 - (arr[y & 7] - arr[h0 & 7])));
+}
+main() {
+    long a, b;
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    a = 1; b = 2; x = 0; y = 0; z = 0; c = 0; s = 0; u = 0; i0 = 0;
+    switch (((-22 | 6) * (y << (0 & 7))) & 15) {
+        i0 = 0;
+    case 4:
+        switch ((-23 - (h1 || -9)) & 15) {
+        case 3:
+            z = -13;
+        default:
+            h0 = (((u + 3) * i0) >> ((arr[a & 7] - (s0 ? g0 : -2)) & 7));
+        }
+        i0 = 0;
+        i0 = 0;
+        while (i0 < 4) {
+            i0++;
+        }
+        switch (-28 & 15) {
+        case 5:
+            c = (((-(20)) && s0) % (((6 << ((2 % ((-8 & 7) + 1)) & 7)) & 7) + 1));
+            y = f1((long) g2, (long) f3((long) 6, (long) (g0 - b)));
+        default:
+            s = ((z % (((h1 >> (5 & 7)) & 7) + 1)) ^ g3);
+        }
+    default:
+        h0 = u;
+    }
+    say("o", (long) (c0 == ((i0 & h1) + (b & g3))));
+    say("v", (long) (z << ((h1 + arr[y & 7]) & 7)));
+    z = (((11 < -27) > (g2 >> (u & 7))) >> (((c || -25) / (((a | c0) & 7) + 1)) & 7));
+    say("g", (long) g0 + g1 + g2 + g3 + h0 + h1 + c0 + s0 + u0 + arr[0] + arr[3] + arr[7]);
+    flush();
+    return 0;
+}
@@ -0,0 +1,32 @@
+; startup for the test programs, run by the loader on the build host.
+; _main is called with no arguments and its return value becomes the
+; exit status. _write is the one system call the programs need; the
+; arguments arrive on the stack, per the usual calling convention.
+; (nas doesn't know SYSCALL, so it's assembled by hand.)
+
+.text
+.global cstart
+.global _main
+.global _write
+
+cstart:
+    call _main
+    mov rdi, rax
+    mov eax, 60             ; exit
+    .byte 0x0F, 0x05
+
+_write:
+    push rdi
+    push rsi
+    push r11
+    push rcx
+    mov rdi, qword [rsp, 40]
+    mov rsi, qword [rsp, 48]
+    mov rdx, qword [rsp, 56]
+    mov eax, 1              ; write
+    .byte 0x0F, 0x05
+    pop rcx
+    pop r11
+    pop rsi
+    pop rdi
+    ret
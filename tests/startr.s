@@ -0,0 +1,21 @@
+; the same as start.s, for programs compiled with -mregparm: the
+; arguments to _write are already in RDI, RSI and RDX, which along
+; with RCX (clobbered by SYSCALL) needn't be preserved.
+
+.text
+.global cstart
+.global _main
+.global _write
+
+cstart:
+    call _main
+    mov rdi, rax
+    mov eax, 60             ; exit
+    .byte 0x0F, 0x05
+
+_write:
+    push r11
+    mov eax, 1              ; write
+    .byte 0x0F, 0x05
+    pop r11
+    ret
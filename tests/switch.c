@@ -0,0 +1,75 @@
+/* switches dense enough to be dispatched through jump tables, of
+   various types, with values on both sides of the tables' bounds. */
+
+dense(i)
+{
+    switch (i)
+    {
+    case 1:     return 10;
+    case 2:     return 20;
+    case 3:     return 30;
+    case 5:     return 50;
+    case 6:     return 60;
+    case 7:
+    case 8:     return 78;
+    default:    return -1;
+    }
+}
+
+negative(c)
+    char c;
+{
+    switch (c)
+    {
+    case -3:    return 3;
+    case -2:    return 2;
+    case -1:    return 1;
+    case 0:     return 0;
+    case 1:     return -1;
+    case 2:     return -2;
+    }
+
+    return 99;
+}
+
+long
+two(u)
+    unsigned long u;
+{
+    long r = 0;
+
+    switch (u)
+    {
+    case 100:   r += 1;
+    case 101:   r += 2;
+    case 102:   r += 4;
+    case 103:   r += 8;
+    case 104:   r += 16; break;
+    case 1000:  r = 1000; break;
+    case 1001:  r = 1001; break;
+    case 1002:  r = 1002; break;
+    case 1003:  r = 1003; break;
+    case 1004:  r = 1004; break;
+    default:    r = -1;
+    }
+
+    return r;
+}
+
+main()
+{
+    long i;
+    long sum;
+
+    for (i = -1; i < 11; ++i) say("a", (long) dense((int) i));
+    for (i = -5; i < 5; ++i) say("b", (long) negative((char) i));
+
+    sum = 0;
+    for (i = 98; i < 106; ++i) sum = sum * 3 + two(i);
+    say("c", sum);
+    for (i = 998; i < 1006; ++i) say("d", two(i));
+    say("e", two((unsigned long) -1));
+
+    flush();
+    return 0;
+}
@@ -0,0 +1,88 @@
+/* pointers to different types may still point to the same object: the
+   caller can pass the same address as both, without a cast, and in the
+   callee neither the loads nor the stores through them can be moved or
+   removed on the strength of the types alone. */
+
+struct sockaddr
+{
+    unsigned short  family;
+    char            data[14];
+};
+
+struct sockaddr_in
+{
+    unsigned short  family;
+    unsigned short  port;
+    int             addr;
+    char            zero[8];
+};
+
+long g;     /* big enough for both */
+
+f(p, q)
+    int  * p;
+    long * q;
+{
+    int x;
+
+    *q = 7L;
+    x = *p;
+    *q = 1L;
+    return x;
+}
+
+family(a, b)
+    struct sockaddr    * a;
+    struct sockaddr_in * b;
+{
+    int r;
+
+    b->family = 3;
+    r = a->family;
+    b->family = 4;
+    return r;
+}
+
+/* nor do the types protect a global, or a local whose address is taken,
+   from a store through a pointer: the pointer may have been converted. */
+
+long gl;
+int * ip;
+
+global(p)
+    int * p;
+{
+    gl = 1L;
+    *p = 2;
+    return gl;
+}
+
+keep(p)
+    int * p;
+{
+    ip = p;
+}
+
+local()
+{
+    long x;
+
+    keep(&x);
+    x = 5L;
+    *ip = 7;
+    return x;
+}
+
+main()
+{
+    struct sockaddr sa;
+
+    say("a", (long) f(&g, &g));
+    say("b", (long) family(&sa, &sa));
+    say("c", (long) sa.family);
+    say("d", g);
+    say("e", (long) global(&gl));
+    say("f", (long) local());
+    flush();
+    return 0;
+}
@@ -0,0 +1,74 @@
+/* reduced from a generated program: with -O -mregparm, a variable that
+   merely passes through a block may be given a register there, and the
+   register must then be saved and restored by the function like any other. */
+
+long g0 = -37;
+long g1 = -43;
+long g2 = 3;
+long g3 = 22;
+int h0 = 48;
+int h1 = -8;
+short s0 = 2184;
+long arr[8];
+long f0(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    i0 = ((4 <= (x | z)) ^ ((g0 ^ -14) >> ((c & g2) & 7)));
+    x = s;
+    i0 = 4;
+    i0 = 0;
+    return (c || (21 ^ s));
+}
+long f1(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    i0 = 4;
+    do {
+    } while (--i0 > 0);
+    return b;
+}
+long f2(a, b) long a; long b; {
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    i0 = 0; x = a; y = b; z = 3; c = a; s = b; u = a + b;
+    u = f0((long) (((long) (s) & 255) % (((3 ? h1 : g3) & 7) + 1)), (long) f1((long) (c ^ i0), (long) (4 / ((a & 7) + 1))));
+    i0 = ((y / (((25 >> (19 & 7)) & 7) + 1)) - 1);
+    u = (f1((long) b, (long) 15) & (g3 ^ 8));
+    y = ((-5 + (g0 >> (s & 7))) == ((6 * s) <= (x && b)));
+    if (((-25 & -27) & (-(-18)))) {
+    } else {
+    }
+    i0 = 3;
+    do {
+        if (((long) ((u ^ 26)) & 255)) {
+        } else {
+            a = (-9 >> ((c | (h1 * -23)) & 7));
+        }
+        x = (7 ^ ((y & z) ^ (arr[h0 & 7] * a)));
+    } while (--i0 > 0);
+    return -13;
+}
+main() {
+    long a, b;
+    long x, y; int z; char c; short s; unsigned u; long i0;
+    a = 8; b = -2; x = 0; y = 0; z = 0; c = 0; s = 0; u = 0; i0 = 0;
+    i0 = 4;
+    do {
+    } while (--i0 > 0);
+    s = arr[c & 7];
+    i0 = 0;
+    while (i0 < 6) {
+        i0++;
+        z = f1((long) ((g1 >> (-23 & 7)) != (c & g2)), (long) (((long) (a) & 255) - (s0 ^ a)));
+    }
+    i0 = 0;
+    while (i0 < 1) {
+        i0++;
+        switch (((-(g0)) & c) & 15) {
+        default:
+            a = (s ^ (f2((long) -25, (long) -19) && (g2 * y)));
+        }
+    }
+    say("o", (long) (s | ((h1 * a) + h1)));
+    flush();
+    return 0;
+}